@@ -2525,6 +2525,12 @@ public:
   /// Removes a declaration from this context.
   void removeDecl(Decl *D);
 
+  /// Moves the declarations from \p First to the end of this context so that
+  /// they directly follow \p Prev, or come first if \p Prev is null. \p Prev
+  /// must come before \p First. Only the order of decls() changes; the
+  /// lookup tables are left alone.
+  void moveTrailingDeclsAfter(Decl *First, Decl *Prev);
+
   /// Checks whether a declaration is in this context.
   bool containsDecl(Decl *D) const;
 
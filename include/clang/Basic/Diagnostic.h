@@ -943,7 +943,10 @@ public:
   inline DiagnosticBuilder Report(SourceLocation Loc, unsigned DiagID);
   inline DiagnosticBuilder Report(unsigned DiagID);
 
-  void Report(const StoredDiagnostic &storedDiag);
+  /// Emit a stored diagnostic again. Errors are counted, and set
+  /// hasErrorOccurred(), only with \p countErrors: a replayed error has
+  /// usually been counted once already.
+  void Report(const StoredDiagnostic &storedDiag, bool countErrors = false);
 
   /// Determine whethere there is already a diagnostic in flight.
   bool isDiagnosticInFlight() const {
@@ -11,7 +11,9 @@
 
 #include "clang/Basic/LLVM.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Support/CodeGen.h"
 #include <memory>
+#include <optional>
 
 namespace llvm {
   class BitcodeModule;
@@ -19,6 +21,7 @@ namespace llvm {
   template <typename T> class IntrusiveRefCntPtr;
   class Module;
   class MemoryBufferRef;
+  class TargetOptions;
   namespace vfs {
   class FileSystem;
   } // namespace vfs
@@ -49,6 +52,20 @@ namespace clang {
                          std::unique_ptr<raw_pwrite_stream> OS,
                          BackendConsumer *BC = nullptr);
 
+  /// Fill in the llvm::TargetOptions for the given clang options, the way
+  /// EmitBackendOutput does. Returns false after reporting an error.
+  bool initTargetOptions(DiagnosticsEngine &Diags,
+                         llvm::TargetOptions &Options,
+                         const CodeGenOptions &CodeGenOpts,
+                         const TargetOptions &TargetOpts,
+                         const LangOptions &LangOpts,
+                         const HeaderSearchOptions &HSOpts);
+
+  /// The code model requested by -mcmodel, or std::nullopt for the target
+  /// default.
+  std::optional<llvm::CodeModel::Model>
+  getCodeModel(const CodeGenOptions &CodeGenOpts);
+
   void EmbedBitcode(llvm::Module *M, const CodeGenOptions &CGOpts,
                     llvm::MemoryBufferRef Buf);
 
@@ -1,18 +1,34 @@
-#include "llvm/IR/LegacyPassManager.h"
+#ifndef LLVM_CLANG_CODEGENERATION_CODEGENERATION_H
+#define LLVM_CLANG_CODEGENERATION_CODEGENERATION_H
+
+#include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CodeGen.h"
 #include "llvm/Target/TargetMachine.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 
-#include "clang/AST/ModuleDecl.h"
-#include "clang/Frontend/CompilerInstance.h"
-#include "clang/Frontend/FrontendAction.h"
-
+#include <functional>
 #include <memory>
+#include <optional>
+
+namespace llvm {
+class TargetLibraryInfoImpl;
+} // namespace llvm
 
 namespace clang {
 
+class CodeGenOptions;
+
+namespace syn {
+class FunType;
+class NominalType;
+class QualType;
+class Type;
+} // namespace syn
+
 namespace codegen {
 
 // class CodeGenAction;
@@ -27,65 +43,190 @@ namespace codegen {
 //   EmitObject    ///< Generate IR and then emit native object files
 // };
 
-// class CodeGenPassManager final {
-//   llvm::PassBuilder pb;
-//   llvm::LoopAnalysisManager lam;
-//   llvm::FunctionAnalysisManager fam;
-//   llvm::CGSCCAnalysisManager cgam;
-//   llvm::ModuleAnalysisManager mam;
-//   llvm::ModulePassManager mpm;
-//   llvm::legacy::PassManager lpm;
-//   llvm::legacy::FunctionPassManager lfpm;
-//   llvm::FunctionPassManager fpm;
-//   llvm::Module *llvmModule = nullptr;
-
-// public:
-//   CodeGenPassManager(const CodeGenPassManager &) = delete;
-//   void operator=(const CodeGenPassManager &) = delete;
-//   CodeGenPassManager(CodeGenPassManager &&) = delete;
-//   void operator=(CodeGenPassManager &&) = delete;
-
-// public:
-//   explicit CodeGenPassManager(llvm::Module *llvmModule);
-
-// public:
-//   llvm::PassBuilder &GetPassBuilder() { return pb; }
-//   llvm::LoopAnalysisManager &GetLoopAnalysisManager() { return lam; }
-//   llvm::FunctionAnalysisManager &GetFunctionAnalysisManager() { return fam; }
-//   llvm::CGSCCAnalysisManager &GetCGSCCAnalysisManager() { return cgam; }
-//   llvm::ModuleAnalysisManager &GetModuleAnalysisManager() { return mam; }
-//   llvm::ModulePassManager &GetPassManager() { return mpm; }
-//   llvm::legacy::PassManager &GetLegacyPassManager() { return lpm; }
-//   llvm::legacy::FunctionPassManager &GetLegacyFunctionPassManager() {
-//     return lfpm;
-//   }
-//   llvm::FunctionPassManager &GetFunctionPassManager() { return fpm; }
-//   llvm::Module *GetLLVMModule() { return llvmModule; }
-// };
-
-// struct CodeGenTypeCache final {
-
-//   llvm::Type *VoidTy;
-//   llvm::IntegerType *Int8Ty;  /// i8
-//   llvm::IntegerType *Int16Ty; /// i16
-//   llvm::IntegerType *Int32Ty; /// i32
-//   llvm::IntegerType *Int64Ty; /// i64
-//   llvm::IntegerType *IntTy;   /// int
-
-//   llvm::PointerType *Int8PtrTy;  /// i16*
-//   llvm::PointerType *Int16PtrTy; /// i16*
-//   llvm::PointerType *Int32PtrTy; /// i32*
-//   llvm::PointerType *Int64PtrTy; /// i64*
-//   llvm::PointerType *IntPtrTy;   ///  int*
-
-//   llvm::IntegerType *CharTy; /// char
-
-//   // LLVM Address types
-//   llvm::IntegerType *RelativeAddressTy;
-//   llvm::PointerType *RelativeAddressPtrTy;
-
-//   explicit CodeGenTypeCache(llvm::LLVMContext &llvmContext);
-// };
+/// CodeGenOptPreset - The optimization pipelines a Stone module can be built
+/// with.
+enum class CodeGenOptPreset : unsigned { O0 = 0, O1, O2, O3, Os, Oz };
+
+/// CodeGenPassManager - Builds and runs the new pass manager pipelines for
+/// Stone modules. The analysis managers are registered once and the pipeline
+/// for each preset is built on first use, so compiling many modules in one
+/// process pays for the pass infrastructure only once. The legacy pass
+/// manager is only created by native emission, never here.
+///
+/// The pipeline tuning, target library info and module verification follow
+/// the CodeGenOptions exactly as clang's BackendUtil applies them.
+class CodeGenPassManager final {
+  /// The library functions the target provides, for TargetLibraryAnalysis.
+  std::unique_ptr<llvm::TargetLibraryInfoImpl> targetLibraryInfo;
+
+  llvm::PassBuilder pb;
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  /// The module pipeline per preset, built lazily.
+  std::optional<llvm::ModulePassManager>
+      modulePipelines[unsigned(CodeGenOptPreset::Oz) + 1];
+
+  /// Run the IR verifier ahead of every module pipeline (-disable-llvm-
+  /// verifier clears it).
+  bool verifyModule;
+
+  /// Only verify; run no optimization passes (-disable-llvm-passes).
+  bool disableLLVMPasses;
+
+  unsigned numModulesOptimized = 0;
+
+public:
+  CodeGenPassManager(const CodeGenPassManager &) = delete;
+  void operator=(const CodeGenPassManager &) = delete;
+  CodeGenPassManager(CodeGenPassManager &&) = delete;
+  void operator=(CodeGenPassManager &&) = delete;
+
+public:
+  CodeGenPassManager(llvm::TargetMachine &targetMachine,
+                     const CodeGenOptions &codeGenOpts);
+  ~CodeGenPassManager();
+
+public:
+  /// GetPipelineTuningOptions - The loop unrolling, vectorization and
+  /// function merging switches of \p codeGenOpts.
+  static llvm::PipelineTuningOptions
+  GetPipelineTuningOptions(const CodeGenOptions &codeGenOpts);
+
+public:
+  /// GetOptPreset - The preset for -O and -Os/-Oz in \p codeGenOpts.
+  static CodeGenOptPreset GetOptPreset(const CodeGenOptions &codeGenOpts);
+
+  /// GetOptimizationLevel - The LLVM optimization level of \p preset.
+  static llvm::OptimizationLevel GetOptimizationLevel(CodeGenOptPreset preset);
+
+public:
+  /// GetModulePipeline - The module pipeline for \p preset.
+  llvm::ModulePassManager &GetModulePipeline(CodeGenOptPreset preset);
+
+  /// RunModulePipeline - Optimize \p llvmModule with the pipeline for
+  /// \p preset and drop the analyses cached for it.
+  void RunModulePipeline(llvm::Module &llvmModule, CodeGenOptPreset preset);
+
+  /// ClearAnalyses - Drop every cached analysis result. Must be called
+  /// before the IR the results were computed for is destroyed.
+  void ClearAnalyses();
+
+public:
+  llvm::PassBuilder &GetPassBuilder() { return pb; }
+  llvm::LoopAnalysisManager &GetLoopAnalysisManager() { return lam; }
+  llvm::FunctionAnalysisManager &GetFunctionAnalysisManager() { return fam; }
+  llvm::CGSCCAnalysisManager &GetCGSCCAnalysisManager() { return cgam; }
+  llvm::ModuleAnalysisManager &GetModuleAnalysisManager() { return mam; }
+
+  void PrintStats() const;
+};
+
+/// TargetMachineFactory - Creates a fresh target machine. Parallel code
+/// generation calls it once per thread, so it must not touch shared state.
+using TargetMachineFactory =
+    std::function<std::unique_ptr<llvm::TargetMachine>()>;
+
+/// GetNumSplitModules - The number of pieces -codegen-jobs splits every
+/// module into. A module with fewer function definitions still gets that
+/// many pieces, some of them empty, so the build always knows which files
+/// to expect.
+unsigned GetNumSplitModules(const CodeGenOptions &codeGenOpts);
+
+/// EmitSplitModule - Partition \p llvmModule into one piece per stream in
+/// \p outputs, keeping clusters of functions and globals that reference each
+/// other's local symbols together, and run target code generation on the
+/// pieces in parallel, each with a target machine from
+/// \p createTargetMachine. A single output is plain serial code generation
+/// on \p targetMachine. \p llvmModule must not be used afterwards.
+///
+/// \returns false, without writing anything, if the target cannot emit
+/// \p fileType.
+bool EmitSplitModule(llvm::Module &llvmModule,
+                     llvm::ArrayRef<llvm::raw_pwrite_stream *> outputs,
+                     llvm::TargetMachine &targetMachine,
+                     const TargetMachineFactory &createTargetMachine,
+                     llvm::CodeGenFileType fileType);
+
+/// CodeGenTypeCache - The LLVM types IR generation asks for all the time.
+/// Pointers are opaque, so a single PtrTy stands in for every pointer type.
+struct CodeGenTypeCache final {
+
+  llvm::Type *VoidTy;
+  llvm::IntegerType *Int1Ty;   /// i1
+  llvm::IntegerType *Int8Ty;   /// i8
+  llvm::IntegerType *Int16Ty;  /// i16
+  llvm::IntegerType *Int32Ty;  /// i32
+  llvm::IntegerType *Int64Ty;  /// i64
+  llvm::IntegerType *Int128Ty; /// i128
+  llvm::IntegerType *IntTy;    /// int, pointer-sized
+
+  llvm::Type *HalfTy;   /// half
+  llvm::Type *FloatTy;  /// float
+  llvm::Type *DoubleTy; /// double
+
+  llvm::PointerType *PtrTy; /// ptr
+
+  llvm::IntegerType *CharTy; /// char, a unicode scalar
+
+  // LLVM Address types
+  llvm::IntegerType *RelativeAddressTy;
+  llvm::PointerType *RelativeAddressPtrTy;
+
+  CodeGenTypeCache(llvm::LLVMContext &llvmContext,
+                   const llvm::DataLayout &dataLayout);
+};
+
+/// CodeGenTypes - Lowers syn types to LLVM types. Every lowering is
+/// memoized by the canonical syn::Type, so sugar shares the entry of the
+/// type it stands for and no type is laid out twice in one module.
+class CodeGenTypes final {
+  llvm::LLVMContext &llvmContext;
+  CodeGenTypeCache typeCache;
+
+  /// The lowering of every canonical type converted so far.
+  llvm::DenseMap<const syn::Type *, llvm::Type *> convertedTypes;
+
+  unsigned numConversions = 0;
+  unsigned numLookups = 0;
+
+public:
+  CodeGenTypes(const CodeGenTypes &) = delete;
+  void operator=(const CodeGenTypes &) = delete;
+
+public:
+  CodeGenTypes(llvm::LLVMContext &llvmContext,
+               const llvm::DataLayout &dataLayout);
+
+public:
+  /// ConvertType - The LLVM type of a value of \p ty.
+  llvm::Type *ConvertType(syn::QualType ty);
+
+  /// ConvertTypeForMem - The LLVM type of \p ty as it is stored in memory.
+  /// A 'bool' value is an i1, but it takes up an i8.
+  llvm::Type *ConvertTypeForMem(syn::QualType ty);
+
+  /// ConvertFunType - The LLVM function type of \p funType.
+  llvm::FunctionType *ConvertFunType(const syn::FunType *funType);
+
+  /// CompleteNominalType - Give the named struct of \p nominalType its
+  /// members. Until then it stays opaque, which is also what lets a
+  /// nominal type refer to itself through a pointer while its members are
+  /// being lowered.
+  void CompleteNominalType(const syn::NominalType *nominalType,
+                           llvm::ArrayRef<syn::QualType> memberTypes);
+
+  const CodeGenTypeCache &GetTypeCache() const { return typeCache; }
+  llvm::LLVMContext &GetLLVMContext() { return llvmContext; }
+
+  void PrintStats() const;
+
+private:
+  llvm::Type *ConvertCanType(const syn::Type *canType);
+  llvm::StructType *CreateNominalStruct(const syn::NominalType *nominalType);
+};
 
 // class CodeGenModule final {
 
@@ -162,4 +303,6 @@ namespace codegen {
 // };
 
 } // namespace codegen
-} // namespace clang
\ No newline at end of file
+} // namespace clang
+
+#endif
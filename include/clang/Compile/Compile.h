@@ -15,9 +15,21 @@
 #define LLVM_CLANG_COMPILE_COMPILE_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include <functional>
 #include <memory>
 
+namespace llvm {
+class LLVMContext;
+class Module;
+class TargetMachine;
+} // namespace llvm
+
 namespace clang {
+namespace codegen {
+class CodeGenPassManager;
+using TargetMachineFactory =
+    std::function<std::unique_ptr<llvm::TargetMachine>()>;
+} // namespace codegen
 
 class CompilerInstance;
 class FrontendAction;
@@ -36,6 +48,32 @@ std::unique_ptr<FrontendAction> CreateFrontendAction(CompilerInstance &CI);
 /// \return - True on success.
 bool Compile(CompilerInstance &instance);
 
+/// Compile every input of \p instance as one source file of a single module.
+/// The files are parsed concurrently, each on its own Preprocessor and
+/// Parser, with their fun bodies captured but not parsed. Their declarations
+/// are then merged in input order into the AST of \p instance, the bodies
+/// are parsed and checked against the merged module, so that a file can
+/// call what another one declares, and the configured action runs over the
+/// result.
+///
+/// \return - True on success.
+bool CompileModule(CompilerInstance &instance);
+
+/// LoadBatchInputs - Replace the inputs of \p instance with those listed in
+/// its -batch-inputs file, and their output files with the ones given there.
+/// Every input is then compiled by the one instance. Under staged code
+/// generation the batch shares the process, the target, one TargetMachine
+/// for the analyses and for emitting every unsplit module, and one
+/// CodeGenPassManager with its analysis registrations and pipelines.
+///
+/// The Preprocessor is not shared. FrontendAction::BeginSourceFile creates
+/// one per input, and with it the identifier table and builtins, because a
+/// Preprocessor cannot enter a second main file and Sema leaves its own
+/// state on the identifiers.
+///
+/// \return - True on success.
+bool LoadBatchInputs(CompilerInstance &instance);
+
 /// Compile - Execute the given actions described by the
 ///
 /// \return - 1 on success.
@@ -52,17 +90,67 @@ bool ExecuteAction();
 /// Maybe pass FrontendInputFile
 bool ExecuteCodeAnalysis();
 
-bool SetupCodeGeneration();
-
-bool ExecuteCodeGeneration();
+//===----------------------------------------------------------------------===//
+// Staged code generation
+//
+// Each stage below takes the artifact of the previous one and returns its own,
+// and is timed on its own under -ftime-report and -ftime-trace.
+//===----------------------------------------------------------------------===//
 
-bool ExecuteIRGeneration();
+/// CanStageCodeGeneration - Whether the stages below handle every code
+/// generation option of \p instance. Sanitizers, profiling, coverage, LTO,
+/// bitcode linking and embedding, split DWARF and pass plugins are only set
+/// up by clang's BackendUtil, so those compiles keep clang's emit actions.
+bool CanStageCodeGeneration(const CompilerInstance &instance);
 
-bool ExecuteIROptimization();
+/// ExecuteBackendAction - Run clang's emit action for the program action
+/// over every input, writing one output per entry of a batch.
+///
+/// \return - True on success.
+bool ExecuteBackendAction(CompilerInstance &instance);
 
-bool ExecuteNativeGeneration();
+/// SetupCodeGeneration - Resolve the target every later stage lowers for.
+///
+/// \return - A factory for its target machine, or an empty one after
+/// reporting an error.
+codegen::TargetMachineFactory SetupCodeGeneration(CompilerInstance &instance);
+
+/// ExecuteIRGeneration - Parse \p input and lower it to an LLVM module in
+/// \p llvmContext. All optimization is left to ExecuteIROptimization.
+/// Whatever analyses \p passManager still caches are dropped on every path,
+/// since they may refer to IR of an earlier input.
+///
+/// \return - The module, or null if parsing or IR generation failed.
+std::unique_ptr<llvm::Module>
+ExecuteIRGeneration(CompilerInstance &instance,
+                    codegen::CodeGenPassManager &passManager,
+                    const FrontendInputFile &input,
+                    llvm::LLVMContext &llvmContext);
+
+/// ExecuteIROptimization - Run the module optimization pipeline for the
+/// requested optimization level over \p llvmModule.
+///
+/// \return - True on success.
+bool ExecuteIROptimization(CompilerInstance &instance,
+                           codegen::CodeGenPassManager &passManager,
+                           llvm::Module &llvmModule);
+
+/// ExecuteNativeGeneration - Write \p llvmModule as the output the program
+/// action asks for: an object file, assembly, bitcode or textual IR. Objects
+/// and assembly are generated on \p targetMachine, or under -codegen-jobs in
+/// parallel pieces on target machines from \p createTargetMachine.
+///
+/// \return - True on success.
+bool ExecuteNativeGeneration(
+    CompilerInstance &instance, llvm::TargetMachine &targetMachine,
+    const codegen::TargetMachineFactory &createTargetMachine,
+    const FrontendInputFile &input, llvm::Module &llvmModule);
 
-bool ExecuteCompileLLVM();
+/// ExecuteCompileLLVM - Run the code generation stages over every input of
+/// \p instance.
+///
+/// \return - True on success.
+bool ExecuteCompileLLVM(CompilerInstance &instance);
 
 } // end namespace clang
 
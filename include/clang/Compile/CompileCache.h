@@ -0,0 +1,117 @@
+#ifndef LLVM_CLANG_COMPILE_COMPILECACHE_H
+#define LLVM_CLANG_COMPILE_COMPILECACHE_H
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/LLVM.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang {
+
+class CompilerInvocation;
+class FrontendInputFile;
+
+/// CompileCache - The on-disk cache of compiled outputs behind
+/// -compile-cache-path.
+///
+/// An entry is keyed by a hash of the input's bytes and name, of the working
+/// directory that relative paths resolve against, of the compiler version
+/// and of the effective compiler invocation, less the options that only name
+/// inputs and outputs. It holds the output file together with the
+/// diagnostics that the compile reported, so that a hit replays both without
+/// running the frontend or the backend.
+///
+/// Entries are single files, written to a temporary name and renamed into
+/// place, so concurrent compiles may share a cache. A hit refreshes the
+/// access time of its entry, and Prune evicts the least recently used
+/// entries once the cache outgrows its size limit.
+class CompileCache final {
+  std::string cachePath;
+  uint64_t maxSizeInBytes;
+
+  /// The hash of the invocation, computed once for every input.
+  std::string invocationHash;
+
+  unsigned numHits = 0;
+  unsigned numMisses = 0;
+  unsigned numStores = 0;
+  uint64_t numBytesReplayed = 0;
+
+  CompileCache(const CompileCache &) = delete;
+  void operator=(const CompileCache &) = delete;
+
+  std::string GetEntryPath(llvm::StringRef key) const;
+
+public:
+  /// CachedDiagnostic - A diagnostic of a cached compile. Its location is
+  /// kept as a file name, line and column, since the SourceLocation it had
+  /// means nothing to the compile that replays it. Ranges and fix-its are
+  /// not kept.
+  struct CachedDiagnostic final {
+    DiagnosticsEngine::Level level = DiagnosticsEngine::Ignored;
+    unsigned id = 0;
+    std::string fileName;
+    unsigned line = 0;
+    unsigned column = 0;
+    std::string message;
+  };
+
+  /// Entry - A cached output and the diagnostics that produced it.
+  struct Entry final {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    std::vector<CachedDiagnostic> diagnostics;
+    llvm::StringRef output;
+  };
+
+  /// DiagnosticRecorder - Records, in the encoded form that Store takes, the
+  /// diagnostics reported to \p diags while it is alive, and still passes
+  /// them on to the client that was there before.
+  class DiagnosticRecorder final {
+    DiagnosticsEngine &diags;
+    DiagnosticConsumer *prevClient;
+    std::unique_ptr<DiagnosticConsumer> ownedPrevClient;
+    std::string encoded;
+
+  public:
+    explicit DiagnosticRecorder(DiagnosticsEngine &diags);
+    ~DiagnosticRecorder();
+
+    llvm::StringRef GetDiagnostics() const { return encoded; }
+  };
+
+public:
+  CompileCache(llvm::StringRef cachePath, uint64_t maxSizeInBytes,
+               const CompilerInvocation &invocation);
+
+public:
+  /// ComputeKey - The key of \p input, whose contents are \p contents.
+  std::string ComputeKey(const FrontendInputFile &input,
+                         llvm::StringRef contents) const;
+
+  /// Lookup - The entry of \p key, if there is one.
+  std::optional<Entry> Lookup(llvm::StringRef key);
+
+  /// Store - Record \p output and \p diagnostics, as encoded by a
+  /// DiagnosticRecorder, under \p key. A failure to write is ignored; the
+  /// next compile is just a miss.
+  void Store(llvm::StringRef key, llvm::StringRef output,
+             llvm::StringRef diagnostics);
+
+  /// Prune - Evict the least recently used entries until the cache fits its
+  /// size limit. As with any llvm::pruneCache cache, entries unused for a
+  /// week go as well.
+  void Prune();
+
+  void PrintStats() const;
+};
+
+} // end namespace clang
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef LLVM_CLANG_COMPILE_DEPENDENCYSCANNER_H
+#define LLVM_CLANG_COMPILE_DEPENDENCYSCANNER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang {
+
+class CompilerInstance;
+
+/// FileImports - The modules that one input imports.
+struct FileImports final {
+  std::string inputFile;
+  /// The file that compiling the input produces, which is what depends on
+  /// the imported interfaces.
+  std::string outputFile;
+  std::vector<std::string> importedModules;
+  /// Why the input could not be read, or "" if it was.
+  std::string readError;
+  /// Whether every import decl in the preamble was well formed.
+  bool isWellFormed = true;
+};
+
+/// DependencyFormat - The output formats of -scan-imports.
+enum class DependencyFormat {
+  /// One Makefile rule per input.
+  Make,
+  /// A ninja dyndep file.
+  Ninja,
+  /// A JSON object with one entry per input.
+  JSON,
+};
+
+std::optional<DependencyFormat> ParseDependencyFormat(llvm::StringRef name);
+
+/// ScanFileImports - Fill in the imports of each of \p files, scanning the
+/// files in parallel on \p numThreads threads (0 is one per core).
+void ScanFileImports(llvm::MutableArrayRef<FileImports> files,
+                     unsigned numThreads = 0);
+
+/// WriteDependencies - Write the dependencies of \p files to \p os in
+/// \p format. The interface of module "a.b" is "a.b.stni" in
+/// \p interfaceDir.
+void WriteDependencies(llvm::raw_ostream &os, DependencyFormat format,
+                       llvm::ArrayRef<FileImports> files,
+                       llvm::StringRef interfaceDir);
+
+/// ScanDependencies - Run -scan-imports over the inputs of \p instance.
+///
+/// \return - True on success.
+bool ScanDependencies(CompilerInstance &instance);
+
+} // end namespace clang
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef LLVM_CLANG_COMPILE_IMPORTSCANNER_H
+#define LLVM_CLANG_COMPILE_IMPORTSCANNER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang {
+
+/// ScannedImport - One 'import' decl found by ScanImports.
+struct ScannedImport final {
+  /// The dotted module name, pointing into the scanned source.
+  llvm::StringRef moduleName;
+  /// The offset of the 'import' keyword.
+  unsigned offset = 0;
+  /// Whether the decl was 'export import'.
+  bool isExported = false;
+};
+
+/// ScanImports - Append the imports in the preamble of the Stone source
+/// \p source to \p imports.
+///
+/// The preamble is the run of 'module' and '[export] import' decls at the
+/// top of a file. The scan reads identifiers, '.' and ';' and skips
+/// whitespace and comments, and nothing else. It stops at the first token
+/// that does not continue the preamble, so its cost follows the preamble
+/// rather than the file, and the rest of the file is never lexed.
+///
+/// \return - False if an import decl in the preamble is malformed. The
+/// imports before it are still appended.
+bool ScanImports(llvm::StringRef source,
+                 llvm::SmallVectorImpl<ScannedImport> &imports);
+
+} // end namespace clang
+
+#endif
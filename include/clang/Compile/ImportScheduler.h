@@ -0,0 +1,114 @@
+#ifndef LLVM_CLANG_COMPILE_IMPORTSCHEDULER_H
+#define LLVM_CLANG_COMPILE_IMPORTSCHEDULER_H
+
+#include "clang/Syntax/ModuleInterface.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+
+/// ImportScheduler - Loads the interfaces of the modules that a file
+/// imports, and of the modules that those import, in parallel.
+///
+/// Import discovers the import graph below a module first. The source of
+/// every module in it is pre-scanned with ScanImports, one level of the
+/// graph at a time and the files of a level in parallel. Each module is
+/// then loaded on the thread pool as soon as the modules that it imports
+/// are loaded, so independent modules load concurrently. Every module is
+/// loaded once, however many importers reach it.
+///
+/// Import and Wait are called from one thread. Wait blocks on the module
+/// that it is given and nothing else, so a consumer can start on its first
+/// import while the others are still loading.
+class ImportScheduler final {
+public:
+  /// ModuleSourceLocator - The path of the source of module \p name, or ""
+  /// if it has none, such as a prebuilt module. The imports of a module
+  /// without source are not followed. It is called on the thread pool.
+  using ModuleSourceLocator = std::function<std::string(llvm::StringRef name)>;
+
+  /// ModuleLoader - Load, or build and load, the interface of module
+  /// \p name. It is called on the thread pool, after the modules that
+  /// \p name imports have been loaded.
+  using ModuleLoader =
+      std::function<llvm::Expected<std::unique_ptr<syn::ModuleInterfaceReader>>(
+          llvm::StringRef name)>;
+
+private:
+  struct ModuleNode final {
+    std::string name;
+    std::vector<ModuleNode *> imports;
+    std::vector<ModuleNode *> importers;
+
+    /// The imports that have not been loaded yet, and whether this module
+    /// has been, guarded by ImportScheduler::mutex.
+    unsigned numPendingImports = 0;
+    bool isLoaded = false;
+
+    /// Written by the load before it completes ready.
+    std::unique_ptr<syn::ModuleInterfaceReader> reader;
+    std::string error;
+
+    std::promise<void> loaded;
+    std::shared_future<void> ready = loaded.get_future().share();
+  };
+
+  ModuleSourceLocator locateSource;
+  ModuleLoader loadModule;
+  llvm::ThreadPool pool;
+
+  std::mutex mutex;
+  llvm::StringMap<std::unique_ptr<ModuleNode>> nodes;
+
+  unsigned numModulesScanned = 0;
+  unsigned numModulesLoaded = 0;
+  unsigned numImportsDeduped = 0;
+
+  ImportScheduler(const ImportScheduler &) = delete;
+  void operator=(const ImportScheduler &) = delete;
+
+  /// Add the modules below \p root that are not known yet, and return the
+  /// new ones.
+  std::vector<ModuleNode *> Discover(ModuleNode *root);
+
+  /// Drop the imports of the new \p nodes that close a cycle, failing the
+  /// importer. Takes \c mutex.
+  void BreakCycles(llvm::ArrayRef<ModuleNode *> newNodes);
+
+  void ScheduleLoad(ModuleNode *node);
+  void Load(ModuleNode *node);
+
+public:
+  /// \p numThreads of 0 is one thread per core.
+  ImportScheduler(ModuleSourceLocator locateSource, ModuleLoader loadModule,
+                  unsigned numThreads = 0);
+  ~ImportScheduler();
+
+public:
+  /// Import - Start loading module \p name and everything below it,
+  /// without waiting for any of it.
+  void Import(llvm::StringRef name);
+
+  /// Wait - Block until module \p name is loaded. It must have been
+  /// imported, directly or by a module below an Import.
+  ///
+  /// \return - Its interface, or null with the reason in \p error.
+  const syn::ModuleInterfaceReader *Wait(llvm::StringRef name,
+                                         std::string *error = nullptr);
+
+  void PrintStats() const;
+};
+
+} // end namespace clang
+
+#endif
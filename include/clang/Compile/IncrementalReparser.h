@@ -0,0 +1,146 @@
+#ifndef LLVM_CLANG_COMPILE_INCREMENTALREPARSER_H
+#define LLVM_CLANG_COMPILE_INCREMENTALREPARSER_H
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/FileEntry.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Compile/Parser.h"
+#include "clang/Compile/ParserOptions.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+
+class Decl;
+class Scope;
+class Sema;
+
+/// TextEdit - Replace \p removedLength bytes at \p offset of a document with
+/// \p newText.
+struct TextEdit final {
+  unsigned offset = 0;
+  unsigned removedLength = 0;
+  llvm::StringRef newText;
+};
+
+/// IncrementalReparser - Keeps the AST of one Stone file current across
+/// edits, for the language server.
+///
+/// The first Parse records the byte span of every top-level decl. An edit
+/// then only dirties the decls whose spans it touches. Reparse re-lexes and
+/// re-parses the region they covered in the new text, replaces the dirty
+/// decls in the translation unit at the same position, and keeps every
+/// other decl by identity, shifting the spans after the edit. The cost of
+/// a keystroke is the cost of the decls around it, not of the file.
+///
+/// The edited text goes into one of a few buffers, each a FileID whose
+/// contents are overridden in turn, so editing does not use up
+/// SourceLocation space. A reused decl keeps the locations of the buffer
+/// that it was parsed from; the decls still in a buffer are reparsed along
+/// with the edit that overwrites it.
+///
+/// The diagnostics of each decl are kept with it. After every parse the
+/// diagnostics of the whole document are reported again, in source order,
+/// and the DiagnosticsEngine counts the errors of the current text only.
+class IncrementalReparser final {
+  Sema &sema;
+  ParserOptions parserOpts;
+
+  /// The translation-unit scope that every region is parsed into, so that
+  /// Sema is set up for the translation unit once. Sema::TUScope points at
+  /// it while the reparser lives.
+  std::unique_ptr<Scope> tuScope;
+
+  /// The number of buffers that edits cycle through.
+  static constexpr unsigned NumGenerations = 4;
+
+  /// The generation of the decls parsed from the main file, which is never
+  /// overwritten.
+  static constexpr unsigned MainFileGeneration = NumGenerations;
+
+  /// Generation - A buffer for the edited text. Its FileID has room for
+  /// capacity bytes; text that does not fit gets a larger FileID.
+  struct Generation final {
+    OptionalFileEntryRef file;
+    FileID fileID;
+    unsigned capacity = 0;
+  };
+  Generation generations[NumGenerations];
+
+  /// ParsedSpan - A top-level decl, the buffer it was parsed from, and the
+  /// diagnostics it reported. A span without a decl holds diagnostics of
+  /// text after the last decl of a region.
+  struct ParsedSpan final {
+    TopLevelDeclSpan span;
+    unsigned generation = MainFileGeneration;
+    std::vector<StoredDiagnostic> diagnostics;
+  };
+
+  /// The current text of the document, the buffer that holds it, and its
+  /// generation.
+  std::string text;
+  FileID fileID;
+  unsigned generation = MainFileGeneration;
+
+  /// The spans of the current top-level decls in order, as offsets into
+  /// text.
+  std::vector<ParsedSpan> spans;
+
+  unsigned numReparses = 0;
+  unsigned numDeclsReparsed = 0;
+  unsigned numDeclsReused = 0;
+  unsigned numFileIDs = 0;
+  uint64_t numBytesParsed = 0;
+
+  IncrementalReparser(const IncrementalReparser &) = delete;
+  void operator=(const IncrementalReparser &) = delete;
+
+  /// Parse [\p beginOffset, \p endOffset) of fileID, appending the decls,
+  /// their spans and their diagnostics to \p newSpans. The new decls are
+  /// placed after the last decl already in \p newSpans.
+  void ParseRegion(unsigned beginOffset, unsigned endOffset,
+                   std::vector<ParsedSpan> &newSpans);
+
+  /// Take \p decl out of the translation unit, its scope and Sema's
+  /// identifier chains, so that its replacement is not a redefinition.
+  void RemoveDecl(Decl *decl);
+
+  /// Put text in the buffer of generation \p gen and make it current.
+  void WriteGeneration(unsigned gen);
+
+  /// Report the diagnostics of every span, in order.
+  void ReportDiagnostics();
+
+public:
+  IncrementalReparser(Sema &sema, const ParserOptions &opts);
+  ~IncrementalReparser();
+
+public:
+  /// Parse - Parse the whole main file.
+  void Parse();
+
+  /// Reparse - Apply \p edit to the document and reparse the top-level
+  /// decls that it touches. The decls that were parsed are appended to
+  /// \p newDecls.
+  void Reparse(const TextEdit &edit, llvm::SmallVectorImpl<Decl *> &newDecls);
+
+  llvm::StringRef GetText() const { return text; }
+  FileID GetFileID() const { return fileID; }
+
+  /// GetTopLevelDeclSpans - Append the span of every current top-level decl
+  /// to \p result, in order.
+  void GetTopLevelDeclSpans(
+      llvm::SmallVectorImpl<TopLevelDeclSpan> &result) const;
+
+  void PrintStats() const;
+};
+
+} // end namespace clang
+
+#endif
@@ -1,23 +1,182 @@
-#ifndef LLVM_CLANG_PARSE_LEXER_H
-#define LLVM_CLANG_PARSE_LEXER_H
+#ifndef LLVM_CLANG_COMPILE_LEXER_H
+#define LLVM_CLANG_COMPILE_LEXER_H
 
 #include "clang/Basic/DiagnosticLex.h"
+#include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/LLVM.h"
 #include "clang/Basic/LangOptions.h"
-
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TokenKinds.h"
+#include "clang/Compile/TokenBuffer.h"
+#include "clang/Lex/Token.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace clang {
+namespace lex {
 
+/// Lexer - The Stone tokenizer. It reads a file straight out of the buffer
+/// that the SourceManager holds for it (memory mapped for any file of real
+/// size) and produces the tokens that the Parser consumes. There are no
+/// macros, directives or trigraphs, so unlike the C Preprocessor there is no
+/// expansion stack to walk for every token: one pass over the characters and
+/// a keyword table lookup per word.
 class Lexer final {
   const FileID bufferID;
   SourceManager &sm;
+  IdentifierTable &identifiers;
+  DiagnosticsEngine &diags;
+
+  /// The file being lexed. The buffer is null terminated, so the scanning
+  /// loops only look for the end when they see a '\0'.
+  const char *bufferStart = nullptr;
+  const char *bufferEnd = nullptr;
+  const char *bufferPtr = nullptr;
+
+  /// Where lexing stops with tok::eof; bufferEnd unless SetLexRange moved it.
+  const char *lexEnd = nullptr;
+
+  /// The location of bufferStart; a token is located by its offset.
+  SourceLocation fileLoc;
+
+  /// Where the code-completion token goes, when completion is enabled.
+  SourceLocation codeCompletionLoc;
+
+  /// Tokens handed back by the parser or lexed ahead by LookAhead. They are
+  /// returned, from pendingPos on, before lexing resumes in the buffer.
+  llvm::SmallVector<Token, 8> pendingTokens;
+  unsigned pendingPos = 0;
+
+  /// The IdentifierInfo of each keyword, looked up the first time that the
+  /// keyword is seen, so that a keyword token never hashes its spelling.
+  llvm::SmallVector<IdentifierInfo *, 64> keywordIdentifiers;
+
+  /// Set once the file is pre-tokenized; Lex then forms tokens from here.
+  std::unique_ptr<TokenBuffer> tokenBuffer;
+
+  /// The index in tokenBuffer of the next token that Lex returns.
+  unsigned tokenIndex = 0;
+
+  /// The deferred diagnostics of tokenBuffer reported so far.
+  unsigned numReportedDiags = 0;
+
+  /// Fills tokenBuffer ahead of the parser when lexing on a worker thread.
+  std::thread lexThread;
+
+  /// Written by whichever thread lexes the buffer. PrintStats waits for a
+  /// worker thread to finish before it reads them.
+  unsigned numTokens = 0;
+  unsigned numKeywords = 0;
+  unsigned numIdentifiers = 0;
+
+  Lexer(const Lexer &) = delete;
+  void operator=(const Lexer &) = delete;
 
 public:
-  Lexer(const FileID bufferID, SourceManager &sm);
+  Lexer(const FileID bufferID, SourceManager &sm,
+        IdentifierTable &identifiers, DiagnosticsEngine &diags);
+  ~Lexer();
+
+public:
+  /// Lex - Return the next token of the file, or tok::eof once the end has
+  /// been reached.
+  void Lex(Token &result);
+
+  /// LookAhead - Return the token \p n tokens past the next one without
+  /// consuming anything. LookAhead(0) is the token that Lex returns next.
+  /// The token is returned by value: a later LookAhead or Lex may reuse the
+  /// storage it was formed in.
+  Token LookAhead(unsigned n);
+
+  /// EnterToken - Make \p tok the next token that Lex returns.
+  void EnterToken(const Token &tok);
+
+  /// EnterTokenStream - Make \p toks the next tokens that Lex returns, in
+  /// order, before anything that was pending.
+  void EnterTokenStream(llvm::ArrayRef<Token> toks);
+
+  /// PreTokenize - Lex the rest of the file into a TokenBuffer, on a worker
+  /// thread that runs ahead of the parser when \p onThread is set, and form
+  /// every later token from that buffer. Must be called before the first
+  /// token is lexed.
+  void PreTokenize(bool onThread);
+
+  bool IsPreTokenized() const { return tokenBuffer != nullptr; }
+
+  /// SetLexRange - Lex only the bytes [\p beginOffset, \p endOffset) of the
+  /// file, both of which must fall between tokens, and return tok::eof at
+  /// \p endOffset. Must be called before the first token is lexed and not
+  /// together with PreTokenize.
+  void SetLexRange(unsigned beginOffset, unsigned endOffset);
+
+  /// Seek - Make the first token at or after \p offset the next one that Lex
+  /// returns, dropping any pending tokens. \p offset must fall between
+  /// tokens; offsets past the end seek to the end.
+  void Seek(unsigned offset);
+
+  /// ComputeTopLevelTokenOffsets - Append to \p offsets, in order, the
+  /// offset of every token of one of \p kinds that is outside all braces.
+  /// The file is scanned separately from the start, with brace depth
+  /// counted from there, so the tokens that Lex returns are unaffected.
+  void ComputeTopLevelTokenOffsets(llvm::ArrayRef<tok::TokenKind> kinds,
+                                   std::vector<unsigned> &offsets);
+
+  /// Emit a tok::code_completion token in place of the '\0' that the
+  /// SourceManager put at \p loc.
+  void SetCodeCompletionLoc(SourceLocation loc) { codeCompletionLoc = loc; }
+
+  FileID GetBufferID() const { return bufferID; }
+  SourceManager &GetSourceManager() const { return sm; }
+
+  /// GetKeywordKind - Return the keyword token kind of \p spelling, or
+  /// tok::identifier when it is not a Stone keyword.
+  static tok::TokenKind GetKeywordKind(llvm::StringRef spelling);
+
+  void PrintStats() const;
+
+private:
+  void LexFromBuffer(Token &result);
+
+  /// Lex every token of the file into tokenBuffer, publishing as it goes.
+  void LexIntoTokenBuffer();
+
+  /// Form \p result from the token at \p index of tokenBuffer, waiting for
+  /// the worker thread when it has not got that far yet.
+  void FormBufferedToken(Token &result, unsigned index);
+
+  /// The IdentifierInfo of lexerKeywords[\p keyword], looked up once.
+  IdentifierInfo *GetKeywordIdentifierInfo(int keyword);
+
+  /// Report a lexer diagnostic now, or defer it to the parser's thread when
+  /// lexing into a token buffer.
+  void Report(const char *loc, unsigned diagID, int arg = -1);
+
+  void LexIdentifierOrKeyword(Token &result, const char *curPtr);
+  void LexNumericConstant(Token &result, const char *curPtr);
+  void LexCharOrStringLiteral(Token &result, const char *curPtr,
+                              char quote);
+
+  /// Skip a '//' or '/*' comment that starts at \p curPtr and return the
+  /// character after it.
+  const char *SkipLineComment(const char *curPtr);
+  const char *SkipBlockComment(Token &result, const char *curPtr);
+
+  /// Finish \p result as a \p kind token that spans [bufferPtr, tokEnd), and
+  /// continue lexing at \p tokEnd.
+  void FormToken(Token &result, const char *tokEnd, tok::TokenKind kind);
+
+  SourceLocation GetSourceLocation(const char *loc) const {
+    return fileLoc.getLocWithOffset(loc - bufferStart);
+  }
 };
 
+} // namespace lex
 } // end namespace clang
 
 #endif
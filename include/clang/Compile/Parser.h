@@ -8,6 +8,8 @@
 #include "clang/Basic/OperatorPrecedence.h"
 #include "clang/Basic/Specifiers.h"
 #include "clang/Basic/TokenKinds.h"
+#include "clang/Compile/Lexer.h"
+#include "clang/Compile/ParserOptions.h"
 #include "clang/Lex/CodeCompletionHandler.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Parse/IdentifierInfoCache.h"
@@ -17,6 +19,8 @@
 #include "clang/Sema/DeclSpec.h"
 #include "clang/Sema/Sema.h"
 
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/PrettyStackTrace.h"
@@ -25,6 +29,7 @@
 #include <memory>
 #include <optional>
 #include <stack>
+#include <vector>
 
 namespace clang {
 
@@ -42,8 +47,64 @@ class ParsingDeclarator;
 class ParsingFieldDeclarator;
 class ColonProtectionRAIIObject;
 
-class ParserOptions final {
-  bool skipFunctionBodies = false;
+/// LateParsedFunBody - The tokens of a 'fun' body, captured by brace balance
+/// while parsing the declaration and parsed only once the body is needed.
+struct LateParsedFunBody final {
+  Decl *funDecl = nullptr;
+  CachedTokens toks;
+
+  explicit LateParsedFunBody(Decl *funDecl) : funDecl(funDecl) {}
+};
+
+/// TopLevelDeclSpan - The bytes that a top-level decl was parsed from: its
+/// first token up to the first token after it, so that the spans of
+/// consecutive decls tile the file.
+struct TopLevelDeclSpan final {
+  Decl *decl = nullptr;
+  unsigned beginOffset = 0;
+  unsigned endOffset = 0;
+};
+
+/// ScopePool - A freelist of Scope objects. A scope that the parser exits is
+/// reset and handed out again on the next EnterScope, so the memory spent on
+/// scopes is bounded by the deepest scope nesting rather than by the number
+/// of scopes entered over the whole compile.
+class ScopePool final {
+  DiagnosticsEngine &diags;
+
+  /// Every scope created by this pool. The pool owns them.
+  llvm::SmallVector<std::unique_ptr<Scope>, 16> scopes;
+
+  /// Scopes that have been exited and are ready to be reused.
+  llvm::SmallVector<Scope *, 16> freeScopes;
+
+  unsigned numCreated = 0;
+  unsigned numReused = 0;
+  unsigned numLive = 0;
+  unsigned maxLive = 0;
+
+  ScopePool(const ScopePool &) = delete;
+  void operator=(const ScopePool &) = delete;
+
+public:
+  explicit ScopePool(DiagnosticsEngine &diags);
+  ~ScopePool();
+
+public:
+  /// Acquire - Return a scope for \p parent with \p scopeFlags, reusing an
+  /// exited scope when one is available.
+  Scope *Acquire(Scope *parent, unsigned scopeFlags);
+
+  /// Release - Hand \p scope back to the pool once the parser exits it.
+  void Release(Scope *scope);
+
+public:
+  unsigned GetNumCreated() const { return numCreated; }
+  unsigned GetNumReused() const { return numReused; }
+  unsigned GetNumLive() const { return numLive; }
+  unsigned GetMaxLive() const { return maxLive; }
+
+  void PrintStats() const;
 };
 
 class Parser final : public CodeCompletionHandler {
@@ -52,7 +113,12 @@ class Parser final : public CodeCompletionHandler {
   friend class ParenBraceBracketBalancer;
   friend class BalancedDelimiterTracker;
 
-  Preprocessor &lexer;
+  /// pp - Still provides the identifier table, target and code-completion
+  /// state that Sema shares; it no longer produces the tokens.
+  Preprocessor &pp;
+
+  /// lexer - The Stone tokenizer for the main file.
+  lex::Lexer lexer;
 
   /// Actions - These are the callbacks we invoke as we parse various constructs
   /// in the file.
@@ -79,10 +145,39 @@ class Parser final : public CodeCompletionHandler {
   unsigned short BraceCount = 0;
   unsigned short MisplacedModuleBeginCount = 0;
 
-  /// ScopeCache - Cache scopes to reduce malloc traffic.
-  // enum { ScopeCacheSize = 16 };
-  // unsigned NumCachedScopes;
-  // Scope *ScopeCache[ScopeCacheSize];
+  /// scopePool - Recycles exited scopes to keep scope memory flat.
+  ScopePool scopePool;
+
+  /// ownsTUScope - Whether the translation-unit scope came from scopePool,
+  /// in which case Sema::TUScope is cleared when the parser goes away.
+  bool ownsTUScope = true;
+
+  ParserOptions parserOpts;
+
+  /// lateParsedFunBodies - The 'fun' bodies whose parsing has been delayed,
+  /// in the order they were seen.
+  llvm::MapVector<Decl *, std::unique_ptr<LateParsedFunBody>>
+      lateParsedFunBodies;
+
+  unsigned numDelayedFunBodies = 0;
+  unsigned numLateParsedFunBodies = 0;
+
+  /// topLevelDeclSpans - The span of every top-level decl parsed so far,
+  /// kept when ParserOptions::recordTopLevelDeclSpans is set.
+  llvm::SmallVector<TopLevelDeclSpan, 0> topLevelDeclSpans;
+
+  /// resyncOffsets - The offsets of the top-level decl specifiers outside
+  /// all braces, where SkipMalformedDecl resumes. Built on the first
+  /// malformed decl.
+  std::vector<unsigned> resyncOffsets;
+  bool builtResyncOffsets = false;
+
+  unsigned numMalformedDeclsSkipped = 0;
+
+  unsigned numExprOperators = 0;
+  /// maxExprStackDepth - The deepest operator stack that ParseBinaryExpr
+  /// has needed, which a recursive descent would have spent in calls.
+  unsigned maxExprStackDepth = 0;
 
   /// Whether the '>' token acts as an operator or not. This will be
   /// true except when we are parsing an expression within a C++
@@ -188,7 +283,18 @@ class Parser final : public CodeCompletionHandler {
   AngleBracketTracker AngleBrackets;
 
 public:
-  Parser(Sema &sema, bool skipFunctionBodies);
+  Parser(Sema &sema, const ParserOptions &opts);
+
+  /// Parse only the bytes [\p beginOffset, \p endOffset) of \p fileID, which
+  /// must fall between top-level decls.
+  ///
+  /// With \p tuScope, which must be Sema::TUScope, the decls go into a
+  /// translation unit that Sema has already been set up for: the parser
+  /// neither reruns ActOnTranslationUnitScope nor Sema::Initialize, and the
+  /// caller keeps the scope alive.
+  Parser(Sema &sema, const ParserOptions &opts, FileID fileID,
+         unsigned beginOffset, unsigned endOffset,
+         Scope *tuScope = nullptr);
   ~Parser() override;
 
 public:
@@ -243,27 +349,55 @@ public:
   bool SkipUntil(ArrayRef<tok::TokenKind> Toks,
                  SkipUntilFlags Flags = static_cast<SkipUntilFlags>(0));
 
-  /// SkipMalformedDecl - Read tokens until we get to some likely good stopping
-  /// point for skipping past a simple-declaration.
+  /// SkipMalformedDecl - Skip to the next top-level decl specifier that is
+  /// outside all braces, or to the end of the file.
   void SkipMalformedDecl();
 
+  /// GetResyncOffsets - The resyncOffsets, built on first use.
+  llvm::ArrayRef<unsigned> GetResyncOffsets();
+
+  /// SkipNominalTypeDecl - Step over the rest of an enum, struct or class
+  /// decl, through its '{...}' body. Sema does not build these yet, but a
+  /// valid one must not be taken for a malformed decl.
+  void SkipNominalTypeDecl();
+
+  /// IsAtResyncPoint - Whether Tok is one of the resyncOffsets.
+  bool IsAtResyncPoint();
+
 public:
-  Preprocessor &GetLexer() { return lexer; }
-  const LangOptions &GetLangOpts() const { return lexer.getLangOpts(); }
-  const TargetInfo &GetTargetInfo() const { return lexer.getTargetInfo(); }
+  Preprocessor &GetPreprocessor() { return pp; }
+  lex::Lexer &GetLexer() { return lexer; }
+  const LangOptions &GetLangOpts() const { return pp.getLangOpts(); }
+  const TargetInfo &GetTargetInfo() const { return pp.getTargetInfo(); }
   Sema &GetSema() const { return sema; }
   AttributeFactory &GetAttrFactory() { return attrFactory; }
   Token &GetTok() { return Tok; }
+  const ParserOptions &GetParserOptions() const { return parserOpts; }
+  llvm::ArrayRef<TopLevelDeclSpan> GetTopLevelDeclSpans() const {
+    return topLevelDeclSpans;
+  }
 
   IdentifierInfoCache &GetIdentifierInfoCache() { return identifierInfoCache; }
   IdentifierInfo *GetIdentifierInfo(StringRef name) {
-    return &GetLexer().getIdentifierTable().get(name);
+    return &GetPreprocessor().getIdentifierTable().get(name);
   }
 
+public:
+  /// PrintStats - Print parser statistics (scope pool usage) for -print-stats.
+  void PrintStats() const;
+
 public:
   void EndParsing() { CutOffParsing(); }
   bool IsEOF() { return Tok.getKind() == tok::eof; }
-  bool IsParsing() { return !IsEOF() && !diags.hasErrorOccurred(); }
+  /// IsParsing - Whether to go on. With recoverMalformedDecls set, only a
+  /// fatal error stops the parse.
+  bool IsParsing() {
+    if (IsEOF()) {
+      return false;
+    }
+    return parserOpts.recoverMalformedDecls ? !diags.hasFatalErrorOccurred()
+                                            : !diags.hasErrorOccurred();
+  }
 
 public:
   ParserStatus CollectDeclSpec(ParsingDeclSpec &spec);
@@ -274,8 +408,27 @@ public:
   ParserStatus CollectNominalTypeSpec(ParsingDeclSpec &spec);
 
 public:
+  /// Callback invoked for every successfully parsed top-level decl. Returning
+  /// false stops parsing.
+  using TopLevelDeclConsumer = llvm::function_ref<bool(ParserResult<Decl> &)>;
+
   bool IsTopLevelDeclSpec();
+
+  /// ParseTopLevelDecls - Parse the top-level decls of the file, handing each
+  /// one to \p consumer as soon as it has been parsed so that nothing but the
+  /// current decl has to stay resident in the parser.
+  ///
+  /// \returns false if \p consumer asked to stop parsing.
+  bool ParseTopLevelDecls(TopLevelDeclConsumer consumer);
+
+  /// ParseTopLevelDecls - Parse all the top-level decls of the file into
+  /// \p results.
   void ParseTopLevelDecls(llvm::SmallVector<ParserResult<Decl>> &results);
+
+  /// ParseNextTopLevelDecl - Parse the next top-level decl into \p result.
+  ///
+  /// \returns false if there are no more top-level decls to parse.
+  bool ParseNextTopLevelDecl(ParserResult<Decl> &result);
   ParserResult<Decl> ParseTopLevelDecl(ParsingDeclSpec &spec);
 
   ParserResult<Decl> ParseDecl(DeclaratorContext declaratorContext,
@@ -292,6 +445,67 @@ public:
 
   ParserResult<Decl> ParseFunDecl(ParsingDeclarator &declarator);
 
+  /// ParseFunBody - Parse the '{ ... }' body of \p funDecl at the current
+  /// token.
+  ParserResult<Stmt> ParseFunBody(Decl *funDecl);
+
+  /// ParseStmt - Parse one statement of a fun body: a block, 'if', 'while',
+  /// 'do', 'return', 'break', 'continue', ';' or an expression followed by
+  /// ';'.
+  ParserResult<Stmt> ParseStmt();
+
+  /// ParseCompoundStmt - Parse a '{ ... }' block in a scope of its own.
+  ParserResult<Stmt> ParseCompoundStmt();
+
+  /// ParseCompoundStmtBody - Parse a '{ ... }' block in the current scope.
+  ParserResult<Stmt> ParseCompoundStmtBody();
+
+  ParserResult<Stmt> ParseIfStmt();
+  ParserResult<Stmt> ParseWhileStmt();
+  ParserResult<Stmt> ParseDoStmt();
+  ParserResult<Stmt> ParseReturnStmt();
+  ParserResult<Stmt> ParseExprStmt();
+
+  /// ParseSubStmt - Parse the body of an 'if', 'else', 'while' or 'do',
+  /// which is a scope of its own even when it is not a block.
+  ParserResult<Stmt> ParseSubStmt();
+
+  /// ParseParenCondExpr - Parse the '( expr )' after \p stmtName into
+  /// \p cond.
+  ///
+  /// \returns true on error.
+  bool ParseParenCondExpr(Expr *&cond, SourceLocation &lParenLoc,
+                          SourceLocation &rParenLoc, StringRef stmtName);
+
+  /// ExpectAndConsumeStmtSemi - Consume the ';' that ends a statement, or
+  /// report \p diagID with \p stmtName and skip to the end of it.
+  void ExpectAndConsumeStmtSemi(unsigned diagID, StringRef stmtName = "");
+
+  /// SkipToEndOfStmt - Skip past the ';' that ends the current statement,
+  /// stopping before the '}' of the enclosing block.
+  void SkipToEndOfStmt();
+
+  /// ConsumeAndStoreFunBody - Capture the tokens of the brace-balanced body
+  /// at the current token into \p toks without parsing them.
+  ///
+  /// \returns false if the body is not terminated before the end of file.
+  bool ConsumeAndStoreFunBody(CachedTokens &toks);
+
+  /// HasLateParsedFunBody - Whether the body of \p funDecl is still delayed.
+  bool HasLateParsedFunBody(const Decl *funDecl) const;
+
+  /// GetLateParsedFunBody - The captured body of \p funDecl, or null if it
+  /// has none or it has been parsed already.
+  const LateParsedFunBody *GetLateParsedFunBody(const Decl *funDecl) const;
+
+  /// ParseLateParsedFunBody - Parse the delayed body of \p funDecl now.
+  ///
+  /// \returns false if \p funDecl has no delayed body.
+  bool ParseLateParsedFunBody(Decl *funDecl);
+
+  /// ParseLateParsedFunBodies - Parse every body that is still delayed.
+  void ParseLateParsedFunBodies();
+
   void ParseFunctionDeclarator(Declarator &D, ParsedAttributes &firstArgAttrs,
                                BalancedDelimiterTracker &Tracker,
                                bool isAmbiguous, bool requiresArg = false);
@@ -349,15 +563,30 @@ public:
   ParserResult<QualType> ParseBasicType(ParsingDeclSpec &spec);
 
 public:
-  //  /// TypeCastState - State whether an expression is or may be a type cast.
-  // enum class TypeCastState {
-  //   None = 0,
-  //   Maybe,
-  //   Is
-  // };
+  /// TypeCastState - State whether an expression is or may be a type cast.
+  enum class TypeCastState { None = 0, Maybe, Is };
+
+  /// ParseExpr - Parse an expression, assignments included.
+  ParserResult<Expr>
+  ParseExpr(TypeCastState typeCastState = TypeCastState::None);
+
+  /// ParseBinaryExpr - Parse an expression whose binary operators bind at
+  /// least as tightly as \p minLevel.
+  ///
+  /// This is an operator-precedence parser driven by a table indexed by
+  /// token kind. Pending binary operators, prefix operators and open
+  /// parens go on an explicit stack rather than the call stack, so the
+  /// depth of an expression costs no recursion; only the operands of a
+  /// call, a subscript or the middle of a '?:' are parsed recursively.
+  ParserResult<Expr> ParseBinaryExpr(prec::Level minLevel);
 
-  //  ParserResult<Expr> ParseExpr(TypeCastState typeCastState =
-  //  TypeCastState::None);
+  /// ParsePrimaryExpr - Parse an identifier, a literal, 'this' or
+  /// 'nullptr'. Parens are handled by ParseBinaryExpr.
+  ParserResult<Expr> ParsePrimaryExpr(bool isAddressOfOperand = false);
+
+  /// ParsePostfixExprSuffix - Parse the calls, subscripts, member accesses
+  /// and postfix '++'/'--' that follow \p lhs.
+  ParserResult<Expr> ParsePostfixExprSuffix(Expr *lhs);
 
 public:
   //===--------------------------------------------------------------------===//
@@ -442,9 +671,11 @@ public:
   /// ExitScope - Pop a scope off the scope stack.
   void ExitScope();
 
-  /// CreateScope -- Create a new scope
+  /// CreateScope -- Create a new scope, reusing an exited one if possible.
   Scope *CreateScope(unsigned scopeFlags);
 
+  ScopePool &GetScopePool() { return scopePool; }
+
   /// GetCurScope
   Scope *GetCurScope() const { return sema.getCurScope(); }
 
@@ -583,9 +814,9 @@ private:
   /// token the current token.
   void UnconsumeToken(Token &Consumed) {
     Token Next = Tok;
-    lexer.EnterToken(Consumed, /*IsReinject*/ true);
+    lexer.EnterToken(Consumed);
     lexer.Lex(Tok);
-    lexer.EnterToken(Next, /*IsReinject*/ true);
+    lexer.EnterToken(Next);
   }
 
   SourceLocation ConsumeAnnotationToken() {
@@ -657,7 +888,8 @@ private:
 
   /// PeekNextToken - This peeks ahead one token and returns it without
   /// consuming it.
-  const Token &PeekNextToken() { return lexer.LookAhead(0); }
+  Token PeekNextToken() { return lexer.LookAhead(0); }
+
   /// Consume the current code-completion token.
   ///
   /// This routine can be called to consume the code-completion token and
@@ -673,8 +905,8 @@ private:
   /// Abruptly cut off parsing; mainly used when we have reached the
   /// code-completion point.
   void CutOffParsing() {
-    if (lexer.isCodeCompletionEnabled())
-      lexer.setCodeCompletionReached();
+    if (pp.isCodeCompletionEnabled())
+      pp.setCodeCompletionReached();
     // Cut off parsing by acting as if we reached the end-of-file.
     Tok.setKind(tok::eof);
   }
@@ -688,6 +920,9 @@ private:
            Kind == tok::annot_repl_input_end;
   }
 
+  /// Re-inject the cached tokens of \p lateParsed and parse the body.
+  void ParseLateParsedFunBody(LateParsedFunBody &lateParsed);
+
   /// Checks if the \p Level is valid for use in a fold expression.
   bool isFoldOperator(prec::Level Level) const;
 
@@ -0,0 +1,30 @@
+#ifndef LLVM_CLANG_COMPILE_PARSEROPTIONS_H
+#define LLVM_CLANG_COMPILE_PARSEROPTIONS_H
+
+namespace clang {
+
+class ParserOptions final {
+public:
+  /// Only parse a 'fun' body when it is explicitly requested. Bodies that
+  /// nobody asks for are never parsed (IDE indexing, interface-only builds).
+  bool skipFunctionBodies = false;
+
+  /// Lex the whole main file into a lex::TokenBuffer before parsing, so that
+  /// lookahead and backtracking are index arithmetic.
+  bool preTokenize = false;
+
+  /// With preTokenize, fill the token buffer on a worker thread that runs
+  /// ahead of the parser instead of before it.
+  bool preTokenizeOnThread = false;
+
+  /// After a malformed top-level decl, skip to the next top-level decl and
+  /// keep parsing rather than stopping at the first error.
+  bool recoverMalformedDecls = false;
+
+  /// Record the byte span of every top-level decl, for incremental reparse.
+  bool recordTopLevelDeclSpans = false;
+};
+
+} // end namespace clang
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef LLVM_CLANG_COMPILE_STOREDDIAGNOSTICCOLLECTOR_H
+#define LLVM_CLANG_COMPILE_STOREDDIAGNOSTICCOLLECTOR_H
+
+#include "clang/Basic/Diagnostic.h"
+
+#include <vector>
+
+namespace clang {
+
+/// StoredDiagnosticCollector - A DiagnosticConsumer that records every
+/// diagnostic instead of printing it, so that it can be replayed later
+/// through DiagnosticsEngine::Report.
+class StoredDiagnosticCollector final : public DiagnosticConsumer {
+  std::vector<StoredDiagnostic> &stored;
+
+public:
+  explicit StoredDiagnosticCollector(std::vector<StoredDiagnostic> &stored)
+      : stored(stored) {}
+
+  void HandleDiagnostic(DiagnosticsEngine::Level level,
+                        const Diagnostic &info) override {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+    stored.emplace_back(level, info);
+  }
+};
+
+} // end namespace clang
+
+#endif
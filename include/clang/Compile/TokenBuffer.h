@@ -0,0 +1,163 @@
+#ifndef LLVM_CLANG_COMPILE_TOKENBUFFER_H
+#define LLVM_CLANG_COMPILE_TOKENBUFFER_H
+
+#include "clang/Basic/LLVM.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/TokenKinds.h"
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace clang {
+
+namespace lex {
+
+/// TokenBuffer - Every token of one file, stored as parallel arrays of kind,
+/// flags, offset and length: nine bytes a token, against the 24 of a Token.
+/// The lex::Lexer rebuilds a Token from its index on demand, so looking ahead
+/// or going back is index arithmetic rather than a walk through a token
+/// cache. Identifiers are not stored; the lexer looks them up as it forms
+/// each token.
+///
+/// The arrays live in fixed-size chunks that never move once allocated. One
+/// thread can therefore append tokens while another reads the tokens that
+/// have already been published.
+class TokenBuffer final {
+public:
+  static constexpr unsigned ChunkSize = 4096;
+
+  /// A diagnostic found by the lexer. It is reported from the parser's
+  /// thread once the parser reaches the token it was found at, which keeps
+  /// diagnostics in the order that lexing on demand would give.
+  struct DeferredDiag final {
+    unsigned tokenIndex;
+    SourceLocation loc;
+    unsigned diagID;
+    /// The %0 argument, or -1 when the diagnostic takes none.
+    int arg;
+  };
+
+private:
+  /// The length stored for a token too long for 16 bits; the real length
+  /// is in longLengths.
+  static constexpr uint16_t LongLength = UINT16_MAX;
+
+  struct Chunk final {
+    tok::TokenKind kinds[ChunkSize];
+    /// Only the low Token flags, which are all that the lexer sets.
+    uint8_t flags[ChunkSize];
+    uint16_t lengths[ChunkSize];
+    uint32_t offsets[ChunkSize];
+  };
+
+  /// Sized for the most tokens that the file can hold, so that adding a
+  /// chunk never reallocates the table under a reader.
+  std::vector<std::unique_ptr<Chunk>> chunks;
+
+  /// The tokens appended so far, and how many of them readers may see.
+  unsigned numTokens = 0;
+  std::atomic<unsigned> numPublished{0};
+  std::atomic<bool> finished{false};
+
+  std::mutex mutex;
+  std::condition_variable publishedCond;
+
+  /// Guarded by mutex; numDeferredDiags lets readers skip the lock.
+  std::vector<DeferredDiag> deferredDiags;
+  std::atomic<unsigned> numDeferredDiags{0};
+
+  /// The index and length of every token of LongLength bytes or more, in
+  /// index order. Guarded by mutex.
+  std::vector<std::pair<unsigned, uint32_t>> longLengths;
+
+  Chunk &GetChunk(unsigned index) const {
+    return *chunks[index / ChunkSize];
+  }
+
+  uint32_t GetLongLength(unsigned index);
+
+  TokenBuffer(const TokenBuffer &) = delete;
+  void operator=(const TokenBuffer &) = delete;
+
+public:
+  /// Create an empty buffer for a file of \p bufferSize bytes.
+  explicit TokenBuffer(size_t bufferSize);
+  ~TokenBuffer();
+
+public:
+  //===--------------------------------------------------------------------===//
+  // Writer
+  //===--------------------------------------------------------------------===//
+
+  void Append(tok::TokenKind kind, unsigned short flags, uint32_t offset,
+              uint32_t length);
+  void AddDeferredDiag(const DeferredDiag &diag);
+
+  /// Publish - Make every token appended so far visible to readers.
+  void Publish();
+
+  /// Finish - Publish the last tokens; nothing is appended after this.
+  void Finish();
+
+  unsigned GetNumTokens() const { return numTokens; }
+
+public:
+  //===--------------------------------------------------------------------===//
+  // Reader
+  //===--------------------------------------------------------------------===//
+
+  /// WaitFor - Block until token \p index is published. Returns false if
+  /// the buffer was finished without reaching it.
+  bool WaitFor(unsigned index);
+
+  /// WaitForFinish - Block until the writer has finished. Everything it did
+  /// before Finish is then visible.
+  void WaitForFinish() { WaitFor(UINT_MAX); }
+
+  /// FindFirstTokenAt - Return the index of the first token at or after
+  /// \p offset, or of the eof token when there is none, waiting only until
+  /// that token is published.
+  unsigned FindFirstTokenAt(uint32_t offset);
+
+  unsigned GetNumPublished() const {
+    return numPublished.load(std::memory_order_acquire);
+  }
+  unsigned GetNumDeferredDiags() const {
+    return numDeferredDiags.load(std::memory_order_acquire);
+  }
+
+  /// Copy the deferred diagnostics from \p first on that were found at or
+  /// before token \p index.
+  void GetDeferredDiags(unsigned first, unsigned index,
+                        llvm::SmallVectorImpl<DeferredDiag> &result);
+
+  tok::TokenKind GetKind(unsigned index) const {
+    return GetChunk(index).kinds[index % ChunkSize];
+  }
+  unsigned short GetFlags(unsigned index) const {
+    return GetChunk(index).flags[index % ChunkSize];
+  }
+  uint32_t GetOffset(unsigned index) const {
+    return GetChunk(index).offsets[index % ChunkSize];
+  }
+  uint32_t GetLength(unsigned index) {
+    uint16_t length = GetChunk(index).lengths[index % ChunkSize];
+    return length == LongLength ? GetLongLength(index) : length;
+  }
+
+  /// The bytes held by the token arrays.
+  size_t GetMemorySize() const;
+};
+
+} // namespace lex
+} // end namespace clang
+
+#endif
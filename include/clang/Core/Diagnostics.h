@@ -1,38 +1,249 @@
 #ifndef LLVM_CLANG_CORE_DIAGNOSTS_H
 #define LLVM_CLANG_CORE_DIAGNOSTS_H
 
-#include "clang/Basic/Specifiers.h"
-#include "llvm/ADT/ArrayRef.h"
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "clang/Core/SourceLocation.h"
+
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
-#include "llvm/ADT/iterator_range.h"
-#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
-#include <limits>
-#include <list>
-#include <map>
-#include <memory>
-#include <optional>
-#include <string>
-#include <type_traits>
-#include <utility>
+#include <thread>
 #include <vector>
 
 namespace llvm {
-class Error;
 class raw_ostream;
 } // namespace llvm
 
 namespace clang {
+namespace src {
+class SourceManager;
+} // namespace src
+
 namespace diags {
+
+enum class DiagID : uint16_t {
+#define DIAG(Id, Level, Format) Id,
+#include "clang/Core/DiagnosticKinds.def"
+  Count
+};
+
+enum class DiagLevel : uint8_t { Ignored, Note, Remark, Warning, Error, Fatal };
+
+/// DiagnosticArgument - One %N argument, kept unformatted until the
+/// diagnostic is rendered.
+class DiagnosticArgument final {
+public:
+  enum class Kind : uint8_t { SInt, UInt, String };
+
+private:
+  Kind kind;
+  union {
+    int64_t sintVal;
+    uint64_t uintVal;
+  };
+  llvm::StringRef stringVal;
+
+public:
+  DiagnosticArgument(int64_t val) : kind(Kind::SInt), sintVal(val) {}
+  DiagnosticArgument(uint64_t val) : kind(Kind::UInt), uintVal(val) {}
+  DiagnosticArgument(llvm::StringRef val)
+      : kind(Kind::String), uintVal(0), stringVal(val) {}
+
+public:
+  Kind GetKind() const { return kind; }
+  int64_t GetSInt() const {
+    assert(kind == Kind::SInt);
+    return sintVal;
+  }
+  uint64_t GetUInt() const {
+    assert(kind == Kind::UInt);
+    return uintVal;
+  }
+  llvm::StringRef GetString() const {
+    assert(kind == Kind::String);
+    return stringVal;
+  }
+  /// The argument as an index for %select.
+  uint64_t GetSelectIndex() const;
+};
+
+/// Diagnostic - A reported diagnostic, with its arguments but no text.
+struct Diagnostic final {
+  DiagID id;
+  DiagLevel level;
+  src::SourceLocation loc;
+
+  /// The order of the diagnostic within the buffer that it was reported
+  /// into; breaks ties between diagnostics at the same location.
+  uint32_t sequence = 0;
+
+  llvm::SmallVector<DiagnosticArgument, 4> args;
+
+  /// Notes reported right after this diagnostic, on the same thread. They
+  /// stay with it when diagnostics are put in source order.
+  std::vector<Diagnostic> notes;
+};
+
+class DiagnosticEngine;
+
+/// DiagnosticConsumer - Receives the diagnostics of an engine in source
+/// order when the engine is flushed.
+class DiagnosticConsumer {
+public:
+  virtual ~DiagnosticConsumer();
+
+  virtual void HandleDiagnostic(const Diagnostic &diag,
+                                const DiagnosticEngine &engine) = 0;
+};
+
+/// TextDiagnosticPrinter - Prints "file:line:column: level: message".
+class TextDiagnosticPrinter final : public DiagnosticConsumer {
+  llvm::raw_ostream &os;
+
+public:
+  explicit TextDiagnosticPrinter(llvm::raw_ostream &os) : os(os) {}
+
+  void HandleDiagnostic(const Diagnostic &diag,
+                        const DiagnosticEngine &engine) override;
+};
+
+/// DiagnosticBuffer - The diagnostics that one thread reported. Only that
+/// thread touches it until the engine is flushed.
+struct DiagnosticBuffer final {
+  DiagnosticBuffer *next = nullptr;
+  std::thread::id owner;
+  std::vector<Diagnostic> diagnostics;
+  uint32_t nextSequence = 0;
+
+  /// Set when the last diagnostic other than a note was ignored, so that
+  /// its notes are ignored with it.
+  bool suppressNotes = false;
+
+  /// Copies of string arguments, alive until the engine is flushed.
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver strings{allocator};
+};
+
+/// DiagnosticBuilder - Collects the arguments of one diagnostic and hands it
+/// to the thread's buffer when it goes out of scope. A diagnostic that is
+/// ignored gets an inactive builder that records nothing.
+class DiagnosticBuilder final {
+  DiagnosticEngine *engine;
+  DiagnosticBuffer *buffer;
+  Diagnostic diag;
+
+  DiagnosticBuilder(const DiagnosticBuilder &) = delete;
+  void operator=(const DiagnosticBuilder &) = delete;
+
+  friend class DiagnosticEngine;
+  DiagnosticBuilder(DiagnosticEngine *engine, DiagnosticBuffer *buffer,
+                    DiagID id, DiagLevel level, src::SourceLocation loc);
+
+public:
+  DiagnosticBuilder(DiagnosticBuilder &&other);
+  ~DiagnosticBuilder();
+
+public:
+  bool IsActive() const { return engine != nullptr; }
+
+  DiagnosticBuilder &operator<<(int64_t val);
+  DiagnosticBuilder &operator<<(uint64_t val);
+  DiagnosticBuilder &operator<<(int val) { return *this << int64_t(val); }
+  DiagnosticBuilder &operator<<(unsigned val) {
+    return *this << uint64_t(val);
+  }
+  DiagnosticBuilder &operator<<(bool val) { return *this << uint64_t(val); }
+  DiagnosticBuilder &operator<<(llvm::StringRef val);
+  DiagnosticBuilder &operator<<(const char *val) {
+    return *this << llvm::StringRef(val);
+  }
+};
+
+/// DiagnosticEngine - The Stone diagnostic engine. Any number of threads may
+/// report into it at once without taking a lock: each thread appends to a
+/// buffer of its own, registered on a lock-free list the first time the
+/// thread reports and found again through a thread_local cache that holds
+/// one buffer per engine, so a thread can move between engines freely.
+///
+/// Nothing is formatted when a diagnostic is reported; the arguments are
+/// stored and the text is built only when a consumer renders it, so a
+/// suppressed warning costs a level lookup and nothing else.
+///
+/// Flush, once the reporting threads are done, merges the buffers in
+/// source order, which does not depend on how the work was scheduled.
 class DiagnosticEngine final {
+  const src::SourceManager &sm;
+  DiagnosticConsumer &consumer;
+
+  /// Identifies this engine to the thread_local buffer caches, which must
+  /// not mistake a new engine at a reused address for an old one.
+  const uint64_t engineID;
+
+  /// The buffers of every thread that has reported, newest first.
+  std::atomic<DiagnosticBuffer *> buffers{nullptr};
+
+  /// The level of each diagnostic. Set up before reporting starts.
+  DiagLevel levels[unsigned(DiagID::Count)];
+  bool ignoreAllWarnings = false;
+  bool warningsAsErrors = false;
+
+  std::atomic<unsigned> numErrors{0};
+  std::atomic<unsigned> numWarnings{0};
+
+  DiagnosticEngine(const DiagnosticEngine &) = delete;
+  void operator=(const DiagnosticEngine &) = delete;
+
+  friend class DiagnosticBuilder;
+  void Commit(DiagnosticBuffer *buffer, Diagnostic &&diag);
+
 public:
-  // DiagnosticEngine(src::SourceManager& srcMgr)
+  DiagnosticEngine(const src::SourceManager &sm,
+                   DiagnosticConsumer &consumer);
+  ~DiagnosticEngine();
+
+public:
+  /// Report - Start reporting \p id at \p loc. Safe to call from any
+  /// thread.
+  DiagnosticBuilder Report(src::SourceLocation loc, DiagID id);
+
+  /// Flush - Hand every buffered diagnostic to the consumer, in source
+  /// order, and empty the buffers. No thread may report meanwhile.
+  void Flush();
+
+  /// GetLevel - Return the level that \p id is reported at.
+  DiagLevel GetLevel(DiagID id) const;
+  void SetLevel(DiagID id, DiagLevel level) { levels[unsigned(id)] = level; }
+  void SetIgnoreAllWarnings(bool ignore) { ignoreAllWarnings = ignore; }
+  void SetWarningsAsErrors(bool asErrors) { warningsAsErrors = asErrors; }
+
+  bool HasErrorOccurred() const {
+    return numErrors.load(std::memory_order_relaxed) != 0;
+  }
+  unsigned GetNumErrors() const {
+    return numErrors.load(std::memory_order_relaxed);
+  }
+  unsigned GetNumWarnings() const {
+    return numWarnings.load(std::memory_order_relaxed);
+  }
+
+  const src::SourceManager &GetSourceManager() const { return sm; }
+
+  /// FormatDiagnostic - Build the message text of \p diag.
+  static void FormatDiagnostic(const Diagnostic &diag,
+                               llvm::SmallVectorImpl<char> &result);
+
+  static llvm::StringRef GetFormat(DiagID id);
+  static llvm::StringRef GetLevelName(DiagLevel level);
+
+private:
+  /// Return the calling thread's buffer, registering one if needed.
+  DiagnosticBuffer *GetThreadBuffer();
 };
+
 } // namespace diags
 } // namespace clang
 
@@ -2,6 +2,7 @@
 #define CLANG_INLINE_BITFIELD_H
 
 #include "llvm/Support/Compiler.h"
+#include <cstddef>
 #include <cstdint>
 
 // Boilerplate namespace in case we add non-macros.
@@ -96,6 +97,12 @@ namespace clang {
 // XXX/HACK: templated max() doesn't seem to work in a bitfield size context.
 constexpr unsigned BitMax(unsigned a, unsigned b) { return a > b ? a : b; }
 
+/// Whether \p T fits in \p budget bytes. Node size budgets are written for
+/// 64-bit hosts and hold trivially elsewhere.
+template <typename T> constexpr bool FitsSizeBudget(size_t budget) {
+  return sizeof(void *) != 8 || sizeof(T) <= budget;
+}
+
 constexpr unsigned CountBitsUsed(uint64_t arg) {
   // Is there a C++ "std::countLeadingZeros()"?
   return (arg & 1ull << 63   ? 63
@@ -1,38 +1,78 @@
 #ifndef LLVM_CLANG_UTILS_SOURCELOCATION_H
 #define LLVM_CLANG_UTILS_SOURCELOCATION_H
 
-#include "clang/Basic/Specifiers.h"
-#include "llvm/ADT/ArrayRef.h"
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/IntrusiveRefCntPtr.h"
-#include "llvm/ADT/SmallVector.h"
-#include "llvm/ADT/StringRef.h"
-#include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/Compiler.h"
 
 #include <cassert>
 #include <cstdint>
-#include <limits>
-#include <list>
-#include <map>
-#include <memory>
-#include <optional>
-#include <string>
-#include <type_traits>
-#include <utility>
-#include <vector>
-
-namespace llvm {
-class Error;
-class raw_ostream;
-} // namespace llvm
 
 namespace clang {
 namespace src {
+
+class SourceManager;
+
+/// SourceLocation - A position in one of the buffers of a src::SourceManager.
+/// Every buffer owns a contiguous range of a single 32-bit offset space, so a
+/// location is just an offset into that space; 0 is the invalid location.
 class SourceLocation final {
+  friend class SourceManager;
+
+  uint32_t offset = 0;
+
+  explicit SourceLocation(uint32_t offset) : offset(offset) {}
+
 public:
-  bool IsValid() const { return false; }
+  SourceLocation() = default;
+
+public:
+  bool IsValid() const { return offset != 0; }
+  bool IsInvalid() const { return offset == 0; }
+
+  /// GetLocWithOffset - Return the location \p delta bytes further on, in
+  /// the same buffer.
+  SourceLocation GetLocWithOffset(int32_t delta) const {
+    assert(IsValid() && "offsetting the invalid location");
+    return SourceLocation(offset + delta);
+  }
+
+  uint32_t GetRawEncoding() const { return offset; }
+  static SourceLocation GetFromRawEncoding(uint32_t encoding) {
+    return SourceLocation(encoding);
+  }
+
+  friend bool operator==(SourceLocation lhs, SourceLocation rhs) {
+    return lhs.offset == rhs.offset;
+  }
+  friend bool operator!=(SourceLocation lhs, SourceLocation rhs) {
+    return lhs.offset != rhs.offset;
+  }
+  /// Orders locations of the same buffer by position.
+  friend bool operator<(SourceLocation lhs, SourceLocation rhs) {
+    return lhs.offset < rhs.offset;
+  }
 };
+
+static_assert(sizeof(SourceLocation) == 4, "SourceLocation must stay 32-bit");
+
+/// SourceRange - A pair of locations, both inclusive.
+class SourceRange final {
+  SourceLocation start;
+  SourceLocation end;
+
+public:
+  SourceRange() = default;
+  SourceRange(SourceLocation loc) : start(loc), end(loc) {}
+  SourceRange(SourceLocation start, SourceLocation end)
+      : start(start), end(end) {}
+
+public:
+  SourceLocation GetStart() const { return start; }
+  SourceLocation GetEnd() const { return end; }
+
+  bool IsValid() const { return start.IsValid() && end.IsValid(); }
+  bool IsInvalid() const { return !IsValid(); }
+};
+
 } // namespace src
 } // namespace clang
 
@@ -1,37 +1,138 @@
 #ifndef LLVM_CLANG_UTILS_SOURCEMANAGER_H
 #define LLVM_CLANG_UTILS_SOURCEMANAGER_H
 
-#include "clang/Basic/Specifiers.h"
-#include "llvm/ADT/ArrayRef.h"
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/IntrusiveRefCntPtr.h"
-#include "llvm/ADT/SmallVector.h"
+#include "clang/Core/SourceLocation.h"
+
 #include "llvm/ADT/StringRef.h"
-#include "llvm/ADT/iterator_range.h"
-#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
 
-#include <cassert>
 #include <cstdint>
-#include <limits>
-#include <list>
-#include <map>
 #include <memory>
-#include <optional>
-#include <string>
-#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace llvm {
-class Error;
 class raw_ostream;
 } // namespace llvm
 
 namespace clang {
 namespace src {
+
+/// BufferID - Names a buffer of a SourceManager. 0 is the invalid buffer.
+using BufferID = unsigned;
+
+/// SourceManager - Owns the source buffers of a Stone compile and maps
+/// src::SourceLocation to buffer, line and column.
+///
+/// Stone has no macro expansions and no include stack, so a location is a
+/// plain offset: buffer N covers [base, base + size] of one 32-bit space,
+/// the extra position being its end. Finding the buffer of a location is a
+/// search over the bases; finding its line is a search over a line table
+/// that is only built for buffers that someone asks a line of.
+///
+/// Line queries mutate caches and are not thread safe.
 class SourceManager final {
+  struct SrcBuffer final {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+    /// The offset of the first character of the buffer.
+    uint32_t base = 0;
+
+    /// The offset in the buffer of the start of every line, built on the
+    /// first line query.
+    mutable std::vector<uint32_t> lineOffsets;
+
+    uint32_t GetSize() const { return buffer->getBufferSize(); }
+    bool Contains(uint32_t offset) const {
+      return offset >= base && offset <= base + GetSize();
+    }
+  };
+
+  /// Indexed by BufferID - 1, ordered by base.
+  std::vector<SrcBuffer> buffers;
+
+  /// The first offset not yet given to a buffer. 0 stays invalid.
+  uint32_t nextBase = 1;
+
+  /// The buffer that the last FindBufferID found; most lookups in a row are
+  /// for the same buffer.
+  mutable BufferID lastLookupBufferID = 0;
+
+  /// The buffer and line of the last line query. Diagnostics and line
+  /// tables tend to ask about nearby locations in order, which the cache
+  /// answers with a short forward scan instead of a search.
+  mutable BufferID lastQueryBufferID = 0;
+  mutable unsigned lastQueryLine = 0;
+
+  mutable unsigned numLineQueries = 0;
+  mutable unsigned numLineCacheHits = 0;
+
+  SourceManager(const SourceManager &) = delete;
+  void operator=(const SourceManager &) = delete;
+
+public:
+  SourceManager() = default;
+  ~SourceManager();
+
 public:
+  /// AddBuffer - Take ownership of \p buffer and give it the next range of
+  /// the location space.
+  BufferID AddBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  /// AddFile - Open \p path, memory mapped when it is large enough, and add
+  /// it as a buffer.
+  llvm::ErrorOr<BufferID> AddFile(llvm::StringRef path);
+
+  unsigned GetNumBuffers() const { return buffers.size(); }
+
+  /// FindBufferID - Return the buffer that \p loc points into, or 0.
+  BufferID FindBufferID(SourceLocation loc) const;
+
+  SourceLocation GetLocForBufferStart(BufferID bufferID) const;
+  SourceLocation GetLocForBufferEnd(BufferID bufferID) const;
+
+  /// GetLoc - Return the location \p offset bytes into \p bufferID.
+  SourceLocation GetLoc(BufferID bufferID, uint32_t offset) const;
+
+  /// GetDecomposedLoc - Return the buffer of \p loc and its offset in it.
+  std::pair<BufferID, uint32_t> GetDecomposedLoc(SourceLocation loc) const;
+
+  llvm::StringRef GetBufferData(BufferID bufferID) const;
+  llvm::StringRef GetBufferName(BufferID bufferID) const;
+
+  /// GetCharacterData - Return the character that \p loc points at.
+  const char *GetCharacterData(SourceLocation loc) const;
+
+  /// GetLineNumber - Return the 1-based line of \p loc, or 0 if invalid.
+  unsigned GetLineNumber(SourceLocation loc) const;
+
+  /// GetLineAndColumn - Return the 1-based line and column of \p loc, or
+  /// {0, 0} if invalid. Columns count bytes.
+  std::pair<unsigned, unsigned> GetLineAndColumn(SourceLocation loc) const;
+
+  /// GetLineText - Return the text of the line that \p loc is on, without
+  /// the line break.
+  llvm::StringRef GetLineText(SourceLocation loc) const;
+
+  /// Print \p loc as "name:line:column".
+  void PrintLoc(SourceLocation loc, llvm::raw_ostream &os) const;
+
+  void PrintStats() const;
+
+private:
+  const SrcBuffer &GetBuffer(BufferID bufferID) const {
+    assert(bufferID != 0 && bufferID <= buffers.size() && "invalid buffer");
+    return buffers[bufferID - 1];
+  }
+
+  /// Return the 0-based line of \p offset in \p bufferID.
+  unsigned FindLineIndex(BufferID bufferID, uint32_t offset) const;
+
+  static void ComputeLineOffsets(llvm::StringRef data,
+                                 std::vector<uint32_t> &lineOffsets);
 };
+
 } // namespace src
 } // namespace clang
 
@@ -415,6 +415,28 @@ public:
   LLVM_PREFERRED_TYPE(bool)
   unsigned ModulesShareFileManager : 1;
 
+  /// Treat all inputs as the source files of one module: parse them
+  /// concurrently and merge their declarations into one AST.
+  LLVM_PREFERRED_TYPE(bool)
+  unsigned CompileModule : 1;
+
+  /// Lex the main file into a token buffer before parsing it.
+  LLVM_PREFERRED_TYPE(bool)
+  unsigned PreTokenize : 1;
+
+  /// With PreTokenize, fill the token buffer on a worker thread that runs
+  /// ahead of the parser.
+  LLVM_PREFERRED_TYPE(bool)
+  unsigned PreTokenizeOnThread : 1;
+
+  /// Skip malformed top-level declarations and keep parsing.
+  LLVM_PREFERRED_TYPE(bool)
+  unsigned RecoverMalformedDecls : 1;
+
+  /// Write the import dependencies of the inputs instead of compiling them.
+  LLVM_PREFERRED_TYPE(bool)
+  unsigned ScanImports : 1;
+
   CodeCompleteOptions CodeCompleteOpts;
 
   /// Specifies the output format of the AST.
@@ -578,9 +600,31 @@ public:
   /// Minimum time granularity (in microseconds) traced by time profiler.
   unsigned TimeTraceGranularity;
 
+  /// Number of threads used to parse module files; 0 means one per core.
+  unsigned CompileModuleJobs = 0;
+
   /// Path which stores the output files for -ftime-trace
   std::string TimeTracePath;
 
+  /// The file listing the inputs of a -batch-inputs compile.
+  std::string BatchInputsFile;
+
+  /// The output file of each input of a batch compile, in input order. An
+  /// empty one is named after its input.
+  std::vector<std::string> BatchOutputFiles;
+
+  /// The directory of the compile cache, if any.
+  std::string CompileCachePath;
+
+  /// The size limit of the compile cache, in MiB.
+  unsigned CompileCacheSize = 1024;
+
+  /// The format of the -scan-imports output: "make", "ninja" or "json".
+  std::string ScanImportsFormat = "make";
+
+  /// The directory of the binary Stone module interfaces.
+  std::string ModuleInterfaceDir;
+
   FrontendInputAction InputAction = FrontendInputAction::None;
 
 public:
@@ -595,6 +639,8 @@ public:
         BuildingImplicitModuleUsesLock(true), ModulesEmbedAllFiles(false),
         IncludeTimestamps(true), UseTemporary(true),
         AllowPCMWithCompilerErrors(false), ModulesShareFileManager(true),
+        CompileModule(false), PreTokenize(false), PreTokenizeOnThread(false),
+        RecoverMalformedDecls(false), ScanImports(false),
         TimeTraceGranularity(500) {}
 
   /// getInputKindForExtension - Return the appropriate input kind for a file
@@ -13,46 +13,141 @@
 namespace clang {
 namespace syn {
 
+/// Allocation statistics for one AllocationArena.
+struct AllocationArenaStats final {
+  /// Bytes handed out from the arena.
+  uint64_t bytesAllocated = 0;
+  /// Number of allocations made from the arena.
+  uint64_t numAllocations = 0;
+  /// Bytes given back to the system when temporary arenas were released.
+  uint64_t bytesReleased = 0;
+  /// Number of temporary arenas that have been opened.
+  uint64_t numArenas = 0;
+};
+
 class ASTContext final {
+  friend class TemporaryArenaRAII;
+
   const LangOptions &langOpts;
   IdentifierTable identifiers;
 
 private:
-  mutable llvm::SmallVector<Type *, 0> Types;
-  // mutable llvm::FoldingSet<ComplexType> ComplexTypes;
-  // mutable llvm::FoldingSet<PointerType>
-  // PointerTypes{GeneralTypesLog2InitSize}; mutable
-  // llvm::FoldingSet<BlockPointerType> BlockPointerTypes; mutable
-  // llvm::FoldingSet<LValueReferenceType> LValueReferenceTypes; mutable
-  // llvm::FoldingSet<RValueReferenceType> RValueReferenceTypes; mutable
-  // llvm::FoldingSet<MemberPointerType> MemberPointerTypes;
+  /// TypeTables - The types of one arena and the sets that unique them.
+  struct TypeTables final {
+    llvm::SmallVector<Type *, 0> types;
+    llvm::FoldingSet<PointerType> pointerTypes;
+    llvm::FoldingSet<LValueReferenceType> lValueReferenceTypes;
+    llvm::FoldingSet<RValueReferenceType> rValueReferenceTypes;
+    llvm::FoldingSet<FunType> funTypes;
+    llvm::FoldingSet<AutoType> autoTypes;
+  };
+
+  /// A temporary arena owned by one constraint solver instance. Arenas nest:
+  /// a solver started while another is running gets its own arena, which is
+  /// released before the outer one. The types built from type variables live
+  /// here, uniqued in tables of their own, and go away with the arena.
+  struct TemporaryArena final {
+    llvm::BumpPtrAllocator allocator;
+    TypeTables typeTables;
+    unsigned numTypeVariables = 0;
+    TemporaryArena *prev = nullptr;
+  };
+
+  /// The allocator for AllocationArena::Permanent.
+  mutable llvm::BumpPtrAllocator permanentAllocator;
+
+  /// The innermost open temporary arena, or null if no solver is active.
+  TemporaryArena *temporaryArena = nullptr;
+
+  mutable AllocationArenaStats arenaStats[2];
+
+  llvm::BumpPtrAllocator &GetAllocator(AllocationArena arena) const;
+
+private:
+  /// The types of the permanent arena, which live as long as the context.
+  mutable TypeTables permanentTypeTables;
+
+  /// The tables that a new type of \p arena goes in: the permanent ones or
+  /// those of the innermost temporary arena.
+  TypeTables &GetTypeTables(AllocationArena arena) const;
+
+  /// Find the type profiled by \p ID in \p set of the tables of \p arena.
+  /// A temporary type may have been made in any open temporary arena, so
+  /// they are all searched; \p insertPos is for the innermost one.
+  template <typename T>
+  T *FindType(llvm::FoldingSet<T> TypeTables::*set,
+              const llvm::FoldingSetNodeID &ID, AllocationArena arena,
+              void *&insertPos) const {
+    if (arena == AllocationArena::Permanent) {
+      return (permanentTypeTables.*set).FindNodeOrInsertPos(ID, insertPos);
+    }
+    assert(temporaryArena && "temporary type outside of a solver arena");
+    if (T *type = (temporaryArena->typeTables.*set).FindNodeOrInsertPos(
+            ID, insertPos)) {
+      return type;
+    }
+    for (TemporaryArena *outer = temporaryArena->prev; outer;
+         outer = outer->prev) {
+      void *outerInsertPos = nullptr;
+      if (T *type =
+              (outer->typeTables.*set).FindNodeOrInsertPos(ID, outerInsertPos)) {
+        return type;
+      }
+    }
+    return nullptr;
+  }
+
+  /// The builtin types, indexed by TypeKind.
+  BuiltinType *BuiltinTypes[static_cast<unsigned>(TypeKind::TypeLast) + 1] =
+      {};
+
 
 private:
-  const CanType<Type> BuiltinFloat16Type;  /// 32-bit IEEE floating point
-  const CanType<Type> BuiltinFloat32Type;  /// 32-bit IEEE floating point
-  const CanType<Type> BuiltinFloat64Type;  /// 64-bit IEEE floating point
-  const CanType<Type> BuiltinFloat128Type; /// 128-bit IEEE floating point
-  const CanType<Type> BuiltinFloatType;    /// 128-bit IEEE floating point
-
-  const CanType<Type> BuiltinInt8Type;
-  const CanType<Type> BuiltinInt16Type;
-  const CanType<Type> BuiltinInt32Type;
-  const CanType<Type> BuiltinInt64Type;
-  const CanType<Type> BuiltinInt128Type;
-  const CanType<Type> BuiltinIntType;
-
-  const CanType<Type> BuiltinUInt8Type;
-  const CanType<Type> BuiltinUInt16Type;
-  const CanType<Type> BuiltinUInt32Type;
-  const CanType<Type> BuiltinUInt64Type;
-  const CanType<Type> BuiltinUInt128Type;
-  const CanType<Type> BuiltinUIntType;
-
-  const CanType<Type> BuiltinVoidType;
-  const CanType<Type> BuiltinNullType;
-  const CanType<Type> BuiltinBoolType;
-
-  void AddBuiltinType(const CanType<Type> &canType, TypeKind kind);
+  CanType<Type> BuiltinFloat16Type;  /// 16-bit IEEE floating point
+  CanType<Type> BuiltinFloat32Type;  /// 32-bit IEEE floating point
+  CanType<Type> BuiltinFloat64Type;  /// 64-bit IEEE floating point
+  CanType<Type> BuiltinFloat128Type; /// 128-bit IEEE floating point
+  CanType<Type> BuiltinFloatType;    /// Target-sized floating point
+
+  CanType<Type> BuiltinInt8Type;
+  CanType<Type> BuiltinInt16Type;
+  CanType<Type> BuiltinInt32Type;
+  CanType<Type> BuiltinInt64Type;
+  CanType<Type> BuiltinInt128Type;
+  CanType<Type> BuiltinIntType;
+
+  CanType<Type> BuiltinUInt8Type;
+  CanType<Type> BuiltinUInt16Type;
+  CanType<Type> BuiltinUInt32Type;
+  CanType<Type> BuiltinUInt64Type;
+  CanType<Type> BuiltinUInt128Type;
+  CanType<Type> BuiltinUIntType;
+
+  CanType<Type> BuiltinVoidType;
+  CanType<Type> BuiltinNullType;
+  CanType<Type> BuiltinBoolType;
+
+  /// Allocate the builtin type for \p kind into the builtin table.
+  void CreateBuiltinType(TypeKind kind);
+
+  /// Bind \p canType to the preallocated builtin type for \p kind.
+  void AddBuiltinType(CanType<Type> &canType, TypeKind kind);
+
+  /// Record a newly created type, which was allocated in \p arena. A type
+  /// lives as long as its arena, so it must not be put in the permanent
+  /// tables if it came from a temporary arena.
+  template <typename T>
+  T *AddType(T *type,
+             AllocationArena arena = AllocationArena::Permanent) const {
+    assert(GetAllocator(arena).identifyObject(type) &&
+           "type allocated outside of its arena");
+    if (arena == AllocationArena::Temporary) {
+      type->SetTemporary();
+    }
+    GetTypeTables(arena).types.push_back(type);
+    return type;
+  }
+
 
 public:
   ASTContext(const LangOptions &langOpts);
@@ -65,6 +160,98 @@ public:
   }
 
 public:
+  //===--------------------------------------------------------------------===//
+  // Type factory. Every type is uniqued, so two types are the same type
+  // exactly when their canonical type pointers are equal.
+  //===--------------------------------------------------------------------===//
+
+  /// Return the preallocated builtin type for \p kind.
+  CanType<Type> GetBuiltinType(TypeKind kind) const {
+    auto *builtinType = BuiltinTypes[static_cast<unsigned>(kind)];
+    assert(builtinType && "Not a builtin type kind");
+    return CanType<Type>::CreateUnsafe(QualType(builtinType, 0));
+  }
+
+  CanType<Type> GetIntType() const { return BuiltinIntType; }
+  CanType<Type> GetUIntType() const { return BuiltinUIntType; }
+  CanType<Type> GetFloatType() const { return BuiltinFloatType; }
+  CanType<Type> GetBoolType() const { return BuiltinBoolType; }
+  CanType<Type> GetVoidType() const { return BuiltinVoidType; }
+  CanType<Type> GetNullType() const { return BuiltinNullType; }
+
+  QualType GetPointerType(QualType pointeeType) const;
+  QualType GetLValueReferenceType(QualType pointeeType) const;
+  QualType GetRValueReferenceType(QualType pointeeType) const;
+  QualType GetFunType(QualType resultType,
+                      llvm::ArrayRef<QualType> paramTypes) const;
+
+  /// Return the type declared by \p decl, which must be an enum, struct or
+  /// interface.
+  QualType GetNominalType(NominalTypeDecl *decl) const;
+  QualType GetEnumType(EnumDecl *decl) const;
+  QualType GetStructType(StructDecl *decl) const;
+  QualType GetInterfaceType(InterfaceDecl *decl) const;
+
+  QualType GetAliasType(AliasDecl *decl, QualType underlyingType) const;
+
+  /// Return 'auto', deduced as \p deducedType if it is not null.
+  QualType GetAutoType(QualType deducedType = QualType()) const;
+
+  /// Whether \p T1 and \p T2 are the same type, ignoring sugar.
+  bool HasSameType(QualType T1, QualType T2) const {
+    return T1.GetCanType() == T2.GetCanType();
+  }
+
+  /// CreateTypeVariable - Create a fresh type variable in the innermost
+  /// temporary arena, which must be open.
+  QualType CreateTypeVariable() const;
+
+  /// GetNumTypes - The number of types in the permanent arena and in every
+  /// open temporary arena.
+  size_t GetNumTypes() const;
+
+public:
+  /// Allocate - Allocate \p bytes of memory with \p alignment from \p arena.
+  ///
+  /// Memory in the temporary arena is only valid until the innermost
+  /// TemporaryArenaRAII is destroyed.
+  void *Allocate(size_t bytes, unsigned alignment = 8,
+                 AllocationArena arena = AllocationArena::Permanent) const;
+
+  template <typename T>
+  T *Allocate(size_t num = 1,
+              AllocationArena arena = AllocationArena::Permanent) const {
+    return static_cast<T *>(Allocate(num * sizeof(T), alignof(T), arena));
+  }
+
+  /// Deallocate - Memory in the arenas is released in bulk, never one
+  /// object at a time.
+  void Deallocate(void *ptr) const {}
+
+  /// HasTemporaryArena - Whether a constraint solver arena is currently open.
+  bool HasTemporaryArena() const { return temporaryArena != nullptr; }
+
+public:
+  const AllocationArenaStats &GetArenaStats(AllocationArena arena) const {
+    return arenaStats[static_cast<unsigned>(arena)];
+  }
+  void PrintStats() const;
+};
+
+/// TemporaryArenaRAII - Opens a temporary arena for one constraint solver
+/// instance. Everything allocated in AllocationArena::Temporary while this
+/// object is alive is released as soon as it is destroyed, so solver garbage
+/// does not accumulate for the whole translation unit.
+class TemporaryArenaRAII final {
+  ASTContext &ctx;
+  ASTContext::TemporaryArena arena;
+
+  TemporaryArenaRAII(const TemporaryArenaRAII &) = delete;
+  void operator=(const TemporaryArenaRAII &) = delete;
+
+public:
+  explicit TemporaryArenaRAII(ASTContext &ctx);
+  ~TemporaryArenaRAII();
 };
 } // namespace syn
 
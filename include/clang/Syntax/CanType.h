@@ -29,14 +29,45 @@ public:
   /// canonical type pointers.
   template <typename U>
   CanType(const CanType<U> &other,
-          std::enable_if_t<std::is_base_of<T, U>::value, int> = 0);
+          std::enable_if_t<std::is_base_of<T, U>::value, int> = 0)
+      : underlyType(other.GetQualType()) {}
 
 public:
   /// Retrieve the underlying type pointer, which refers to a
   /// canonical type.
   ///
   /// The underlying pointer must not be nullptr.
-  // const T *GetTypePtr() const { return cast<T>(underlyType.getTypePtr()); }
+  const T *GetTypePtr() const {
+    return llvm::cast<T>(underlyType.GetTypePtr());
+  }
+
+  /// Retrieve the underlying type pointer, which refers to a
+  /// canonical type, or nullptr.
+  const T *GetTypePtrOrNull() const {
+    return llvm::cast_or_null<T>(underlyType.GetTypePtrOrNull());
+  }
+
+  /// Retrieve the canonical type as a QualType.
+  QualType GetQualType() const { return underlyType; }
+  operator QualType() const { return underlyType; }
+
+  bool IsNull() const { return underlyType.IsNull(); }
+
+  /// Build a canonical type from a QualType that is known to be canonical.
+  static CanType<T> CreateUnsafe(QualType other) {
+    assert((other.IsNull() || other.IsCanonical()) &&
+           "Type is not canonical!");
+    CanType<T> result;
+    result.underlyType = other;
+    return result;
+  }
+
+  friend bool operator==(const CanType &LHS, const CanType &RHS) {
+    return LHS.underlyType == RHS.underlyType;
+  }
+  friend bool operator!=(const CanType &LHS, const CanType &RHS) {
+    return LHS.underlyType != RHS.underlyType;
+  }
 };
 
 } // namespace syn
@@ -58,10 +58,11 @@ enum class DeclAvailability : uint8_t {
   Unavailable
 };
 
+/// Decl - The root of the declaration hierarchy. The kind, location and
+/// flags live in the 64-bit Bits word rather than in fields of their own,
+/// which keeps a Decl at three words. Decl.cpp holds the size budget of
+/// each class.
 class alignas(1 << DeclAlignInBits) Decl : public ASTAllocation<Decl> {
-  DeclKind kind;
-  SourceLocation loc;
-
 public:
   /// The kind of ownership a declaration has, for visibility purposes.
   /// This enumeration is designed such that higher values represent higher
@@ -144,8 +145,8 @@ protected:
     uint64_t OpaqueBits;
 
     CLANG_INLINE_BITFIELD_BASE(
-        Decl, clang::BitMax(NumDeclKindBits, 8) + 1 + 1 + 1 + 1 + 1 + 1, Kind
-        : clang::BitMax(NumDeclKindBits, 8),
+        Decl, clang::BitMax(NumDeclKindBits, 8) + 1 + 1 + 1 + 1 + 1 + 1 + 32,
+        Kind : clang::BitMax(NumDeclKindBits, 8),
 
           /// Whether this declaration is invalid.
           IsValid : 1,
@@ -170,7 +171,10 @@ protected:
           Used : 1,
 
           /// Wether this is a top level decl
-          IsTopLevel : 1);
+          IsTopLevel : 1,
+
+          /// The raw encoding of the location of the declaration.
+          Loc : 32);
 
   } Bits;
 
@@ -182,12 +186,40 @@ public:
   Decl &operator=(Decl &&) = delete;
 
 public:
-  Decl(DeclKind kind, DeclContext *dc, SourceLocation loc) : kind(kind) {}
+  Decl(DeclKind kind, DeclContext *dc, SourceLocation loc)
+      : JointDeclContext(dc) {
+    Bits.OpaqueBits = 0;
+    Bits.Decl.Kind = static_cast<unsigned>(kind);
+    Bits.Decl.Loc = loc.getRawEncoding();
+  }
 
 public:
-  DeclKind GetKind() { return kind; }
+  DeclKind GetKind() const { return static_cast<DeclKind>(Bits.Decl.Kind); }
+  SourceLocation GetLoc() const {
+    return SourceLocation::getFromRawEncoding(Bits.Decl.Loc);
+  }
+
+  /// GetDeclContext - Return the context that this declaration semantically
+  /// belongs to.
+  DeclContext *GetDeclContext() const {
+    if (IsInSemanticDeclContext()) {
+      return GetSemanticDeclContext();
+    }
+    return GetMultipleDeclContext()->SemanticDeclContext;
+  }
+
+  /// GetNextDeclInContext - Return the member of the same context that was
+  /// added after this one.
+  Decl *GetNextDeclInContext() const {
+    return NextInContextAndBits.getPointer();
+  }
 };
 
+inline DeclContext::DeclIterator &DeclContext::DeclIterator::operator++() {
+  current = current->GetNextDeclInContext();
+  return *this;
+}
+
 class NamedDecl : public Decl {
   /// The name of this declaration, which is typically a normal
   /// identifier but may also be a special kind of name (C++
@@ -198,6 +230,14 @@ protected:
   NamedDecl(DeclKind kind, DeclContext *dc, SourceLocation loc,
             DeclarationName name)
       : Decl(kind, dc, loc), name(name) {}
+
+public:
+  DeclarationName GetName() const { return name; }
+
+  static bool classof(const Decl *decl) {
+    return decl->GetKind() >= DeclKind::FirstNamed &&
+           decl->GetKind() <= DeclKind::LastNamed;
+  }
 };
 
 class ValueDecl : public NamedDecl {
@@ -208,7 +248,7 @@ class DeclaratorDecl : public ValueDecl {
 public:
 };
 
-class FunctionDecl : public DeclaratorDecl {
+class FunctionDecl : public DeclaratorDecl, public DeclContext {
 
 public:
 };
@@ -256,16 +296,34 @@ protected:
 // };
 
 // TODO: Redeclarable<NominalType>
-class NominalTypeDecl : public TypeDecl {
-public:
+class NominalTypeDecl : public TypeDecl, public DeclContext {
+protected:
+  NominalTypeDecl(DeclKind kind, const ASTContext &astContext,
+                  DeclContext *dc, SourceLocation loc,
+                  const IdentifierInfo *identifier)
+      : TypeDecl(kind, dc, loc, identifier), DeclContext(kind, astContext) {}
 };
 
 class EnumDecl : public NominalTypeDecl {
+  /// The integer type the enumerators are stored as, from the ': type'
+  /// clause. Null means the default, int32.
+  QualType integerType;
+
+public:
+  EnumDecl(const ASTContext &astContext, DeclContext *dc, SourceLocation loc,
+           const IdentifierInfo *identifier)
+      : NominalTypeDecl(DeclKind::Enum, astContext, dc, loc, identifier) {}
+
 public:
+  QualType GetIntegerType() const { return integerType; }
+  void SetIntegerType(QualType ty) { integerType = ty; }
 };
 
 class StructDecl : public NominalTypeDecl {
 public:
+  StructDecl(const ASTContext &astContext, DeclContext *dc,
+             SourceLocation loc, const IdentifierInfo *identifier)
+      : NominalTypeDecl(DeclKind::Struct, astContext, dc, loc, identifier) {}
 };
 
 class ClassDecl : public NominalTypeDecl {
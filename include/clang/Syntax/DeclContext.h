@@ -1,17 +1,133 @@
 #ifndef LLVM_CLANG_SYNTAX_DECLCONTEXT_H
 #define LLVM_CLANG_SYNTAX_DECLCONTEXT_H
 
+#include "clang/AST/DeclarationName.h"
 #include "clang/Syntax/TypeAlignment.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/iterator_range.h"
+
+#include <cstdint>
+#include <iterator>
 #include <memory>
 
 namespace clang {
 namespace syn {
 
+class ASTContext;
+class Decl;
+class NamedDecl;
+enum class DeclKind : uint8_t;
+
+/// DeclContext - A declaration that contains other declarations: a space,
+/// a nominal type, a function or an export block.
+///
+/// The members are kept in declaration order on an intrusive list threaded
+/// through Decl::NextInContextAndBits, so adding one allocates nothing.
+/// Lookup walks that list while the context is small, which is what most
+/// contexts are. The first lookup in a context of more than
+/// LookupTableThreshold members builds an open-addressed hash table in the
+/// ASTContext's permanent arena, after which lookups are O(1) and
+/// AddDecl keeps the table current.
+///
+/// Lookup builds the table lazily and is not thread safe.
 class alignas(1 << DeclAlignInBits) DeclContext {
 public:
+  /// Contexts with at most this many members are searched linearly.
+  static constexpr unsigned LookupTableThreshold = 8;
+
+private:
+  /// One slot of the lookup table. Declarations with the same name, such
+  /// as overloads, get a slot each, in declaration order along the probe
+  /// sequence.
+  struct LookupEntry final {
+    DeclarationName name;
+    NamedDecl *decl = nullptr;
+  };
+
+  DeclKind declKind;
+  unsigned numDecls = 0;
+  const ASTContext &astContext;
+
+  Decl *firstDecl = nullptr;
+  Decl *lastDecl = nullptr;
+
+  /// The lookup table, or null until a lookup needs it. The bucket count is
+  /// a power of two. Tables outgrown by AddDecl are left in the arena.
+  mutable LookupEntry *lookupBuckets = nullptr;
+  mutable unsigned numLookupBuckets = 0;
+  mutable unsigned numLookupEntries = 0;
+
+  DeclContext(const DeclContext &) = delete;
+  void operator=(const DeclContext &) = delete;
+
+protected:
+  DeclContext(DeclKind declKind, const ASTContext &astContext)
+      : declKind(declKind), astContext(astContext) {}
+
+public:
+  /// DeclIterator - Walks the members of a context in declaration order.
+  class DeclIterator final {
+    Decl *current = nullptr;
+
+  public:
+    using value_type = Decl *;
+    using reference = Decl *;
+    using pointer = Decl *;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    DeclIterator() = default;
+    explicit DeclIterator(Decl *current) : current(current) {}
+
+    Decl *operator*() const { return current; }
+    Decl *operator->() const { return current; }
+    inline DeclIterator &operator++();
+    DeclIterator operator++(int) {
+      DeclIterator prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    friend bool operator==(DeclIterator lhs, DeclIterator rhs) {
+      return lhs.current == rhs.current;
+    }
+    friend bool operator!=(DeclIterator lhs, DeclIterator rhs) {
+      return lhs.current != rhs.current;
+    }
+  };
+
+public:
+  DeclKind GetDeclKind() const { return declKind; }
+
+  llvm::iterator_range<DeclIterator> GetDecls() const {
+    return {DeclIterator(firstDecl), DeclIterator()};
+  }
+  Decl *GetFirstDecl() const { return firstDecl; }
+  Decl *GetLastDecl() const { return lastDecl; }
+  unsigned GetNumDecls() const { return numDecls; }
+  bool IsEmpty() const { return firstDecl == nullptr; }
+
+  /// AddDecl - Append \p decl to the members of this context.
+  void AddDecl(Decl *decl);
+
+  /// Lookup - Append the members named \p name to \p results, in
+  /// declaration order.
+  void Lookup(DeclarationName name,
+              llvm::SmallVectorImpl<NamedDecl *> &results) const;
+
+  /// HasLookupTable - Whether lookups in this context use the hash table.
+  bool HasLookupTable() const { return lookupBuckets != nullptr; }
+
+private:
+  /// Build a table of \p numBuckets slots holding every named member.
+  void BuildLookupTable(unsigned numBuckets) const;
+
+  /// Add \p decl to the lookup table, which must have room for it.
+  void InsertIntoLookupTable(NamedDecl *decl) const;
 };
+
 } // namespace syn
 
 } // end namespace clang
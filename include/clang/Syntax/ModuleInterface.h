@@ -0,0 +1,145 @@
+#ifndef LLVM_CLANG_SYNTAX_MODULEINTERFACE_H
+#define LLVM_CLANG_SYNTAX_MODULEINTERFACE_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace clang {
+namespace syn {
+
+class NamedDecl;
+enum class DeclKind : uint8_t;
+
+/// The binary interface of a Stone module is laid out as:
+///
+///   header    magic "STNI", version, decl count, and the offsets of the
+///             decl records and of the name table, as little-endian 32-bit
+///             words
+///   name      the module name, as a 32-bit length and its bytes
+///   records   one record per exported decl: its kind, its name and an
+///             opaque payload, each string preceded by its 32-bit length
+///   table     an llvm::OnDiskChainedHashTable from each exported name to
+///             the offsets of the records with that name
+///
+/// All offsets are from the start of the file.
+namespace module_interface {
+constexpr char Magic[4] = {'S', 'T', 'N', 'I'};
+constexpr uint32_t Version = 1;
+constexpr unsigned HeaderSize = 20;
+/// The extension of an interface file, which is named after its module.
+constexpr llvm::StringLiteral FileExtension("stni");
+} // namespace module_interface
+
+/// ModuleInterfaceDecl - A decl record as read from an interface. The
+/// strings point into the interface file.
+struct ModuleInterfaceDecl final {
+  DeclKind kind;
+  llvm::StringRef name;
+  llvm::StringRef payload;
+};
+
+/// ModuleInterfaceWriter - Collects the exported decls of a module and
+/// writes its binary interface.
+class ModuleInterfaceWriter final {
+  struct Record final {
+    DeclKind kind;
+    llvm::StringRef name;
+    llvm::StringRef payload;
+  };
+
+  std::string moduleName;
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver strings{allocator};
+  std::vector<Record> records;
+
+  ModuleInterfaceWriter(const ModuleInterfaceWriter &) = delete;
+  void operator=(const ModuleInterfaceWriter &) = delete;
+
+public:
+  explicit ModuleInterfaceWriter(llvm::StringRef moduleName)
+      : moduleName(moduleName) {}
+
+public:
+  /// AddDecl - Export a decl of \p kind named \p name. \p payload is
+  /// whatever the importer needs to rebuild it, and is stored as is.
+  void AddDecl(DeclKind kind, llvm::StringRef name, llvm::StringRef payload);
+
+  /// AddDecl - Export \p decl.
+  void AddDecl(const NamedDecl *decl, llvm::StringRef payload = "");
+
+  unsigned GetNumDecls() const { return records.size(); }
+
+  /// Emit - Write the interface to \p os.
+  void Emit(llvm::raw_ostream &os) const;
+};
+
+/// ModuleInterfaceReader - Reads a binary module interface that has been
+/// mapped into memory.
+///
+/// Opening an interface checks its header and nothing else. The name table
+/// is probed in place and a record is only decoded once a lookup reaches
+/// it, so the cost of an import follows the names that the importer looks
+/// up rather than the size of the module.
+class ModuleInterfaceReader final {
+  class NameTable;
+
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  std::unique_ptr<NameTable> nameTable;
+  llvm::StringRef moduleName;
+  uint32_t numDecls = 0;
+
+  /// The records lie in [recordsOffset, tableOffset) of the buffer.
+  uint32_t recordsOffset = 0;
+  uint32_t tableOffset = 0;
+
+  mutable unsigned numLookups = 0;
+  mutable unsigned numDeclsRead = 0;
+
+  ModuleInterfaceReader(const ModuleInterfaceReader &) = delete;
+  void operator=(const ModuleInterfaceReader &) = delete;
+
+  ModuleInterfaceReader(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  /// Decode the record at \p offset. A record that does not fit in the
+  /// records section of the file is an error.
+  llvm::Expected<ModuleInterfaceDecl> ReadDecl(uint32_t offset) const;
+
+public:
+  ~ModuleInterfaceReader();
+
+  /// Open - Map the interface at \p path, which the reader keeps mapped
+  /// for as long as it lives.
+  static llvm::Expected<std::unique_ptr<ModuleInterfaceReader>>
+  Open(llvm::StringRef path);
+
+  /// Create - Read the interface held in \p buffer.
+  static llvm::Expected<std::unique_ptr<ModuleInterfaceReader>>
+  Create(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+public:
+  llvm::StringRef GetModuleName() const { return moduleName; }
+  unsigned GetNumDecls() const { return numDecls; }
+
+  /// Lookup - Append the exported decls named \p name to \p results, in
+  /// the order they were added to the writer. Records are only checked once
+  /// a lookup reaches them, so a corrupt one is reported here.
+  llvm::Error Lookup(llvm::StringRef name,
+                     llvm::SmallVectorImpl<ModuleInterfaceDecl> &results) const;
+
+  void PrintStats() const;
+};
+
+} // namespace syn
+
+} // end namespace clang
+
+#endif
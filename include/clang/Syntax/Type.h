@@ -36,10 +36,33 @@ namespace clang {
 namespace syn {
 class Type;
 class QualType;
+class ASTContext;
+class AliasDecl;
+class EnumDecl;
+class InterfaceDecl;
+class NominalTypeDecl;
+class StructDecl;
 
 // Provide forward declarations for all of the *Type classes.
 #define TYPE(Class, Base) class Class##Type;
 #include "clang/Syntax/TypeNode.inc"
+} // namespace syn
+} // namespace clang
+
+namespace llvm {
+template <> struct PointerLikeTypeTraits<::clang::syn::Type *> {
+  static inline void *getAsVoidPointer(::clang::syn::Type *P) { return P; }
+
+  static inline ::clang::syn::Type *getFromVoidPointer(void *P) {
+    return static_cast<::clang::syn::Type *>(P);
+  }
+
+  static constexpr int NumLowBitsAvailable = clang::syn::TypeAlignInBits;
+};
+} // namespace llvm
+
+namespace clang {
+namespace syn {
 
 enum : uint64_t {
   /// The maximum supported address space number.
@@ -185,47 +208,140 @@ public:
   void ClearLocalImmutable();
   void ClearLocalVolatile();
 
+  /// Return the canonical type of this type, keeping the local qualifiers.
   QualType GetCanType() const;
+
+  /// Whether this type is its own canonical type.
+  bool IsCanonical() const;
+
+  bool IsNull() const { return val.getPointer() == nullptr; }
+
+  void *GetAsOpaquePtr() const { return val.getOpaqueValue(); }
+
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    ID.AddPointer(GetAsOpaquePtr());
+  }
+
+  friend bool operator==(const QualType &LHS, const QualType &RHS) {
+    return LHS.val == RHS.val;
+  }
+  friend bool operator!=(const QualType &LHS, const QualType &RHS) {
+    return LHS.val != RHS.val;
+  }
 };
 
+/// Whether \p kind is the kind of a BuiltinType.
+inline bool IsBuiltinTypeKind(TypeKind kind) {
+  switch (kind) {
+#define BUILTIN_TYPE(Id) case TypeKind::Id:
+#include "clang/Syntax/BuiltinType.def"
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Type - The root of the type hierarchy. The kind and the small fields of
+/// every subclass are packed into one 64-bit Bits word, so that a type is
+/// that word plus its canonical type and whatever pointers the subclass
+/// adds. Type.cpp holds the size budget of each class.
 class alignas(1 << TypeAlignInBits) Type
     : public syn::ASTAllocation<std::aligned_storage<8, 8>::type> {
-  TypeKind kind;
+  friend class ASTContext;
+
+  /// The canonical type of this type. A canonical type points at itself.
+  QualType canType;
 
 protected:
   union {
+    uint64_t OpaqueBits;
 
-    CLANG_INLINE_BITFIELD_BASE(Type, clang::BitMax(NumTypeKindBits, 8) + 1, Kind
-                               : clang::BitMax(NumTypeKindBits, 8),
+    CLANG_INLINE_BITFIELD_BASE(Type, clang::BitMax(NumTypeKindBits, 8) + 1 + 1,
+      Kind : clang::BitMax(NumTypeKindBits, 8),
 
-                                 /// Whether this declaration is invalid.
-                                 IsBuiltin : 1);
+      /// Whether this is a BuiltinType.
+      IsBuiltin : 1,
+
+      /// Whether this type lives in a temporary arena, because it is or
+      /// contains a type variable.
+      IsTemporary : 1
+    );
+
+    CLANG_INLINE_BITFIELD_FULL(FunType, Type, 32,
+      : NumPadBits,
+      NumParams : 32
+    );
+
+    CLANG_INLINE_BITFIELD_FULL(TypeVariableType, Type, 32,
+      : NumPadBits,
+      ID : 32
+    );
   } Bits;
 
+  /// Set by ASTContext when it records a type from a temporary arena.
+  void SetTemporary() { Bits.Type.IsTemporary = true; }
+
 public:
-  Type(TypeKind kind) : kind(kind) {}
+  void *operator new(size_t bytes, const syn::ASTContext &ctx,
+                     syn::AllocationArena arena = AllocationArena::Permanent,
+                     unsigned alignment = 1 << TypeAlignInBits) {
+    return syn::ASTContextAllocateMem(bytes, ctx, arena, alignment);
+  }
+  void *operator new(size_t bytes, void *mem) throw() {
+    assert(mem && "placement new into failed allocation");
+    return mem;
+  }
+
+public:
+  /// Create a type whose canonical type is \p canType, or a canonical type if
+  /// \p canType is null.
+  Type(TypeKind kind, QualType canType = QualType())
+      : canType(canType.IsNull() ? QualType(this, 0) : canType) {
+    Bits.OpaqueBits = 0;
+    Bits.Type.Kind = static_cast<unsigned>(kind);
+    Bits.Type.IsBuiltin = IsBuiltinTypeKind(kind);
+  }
+
+public:
+  TypeKind GetKind() const { return static_cast<TypeKind>(Bits.Type.Kind); }
+  bool IsBuiltin() const { return Bits.Type.IsBuiltin; }
+
+  /// IsTemporary - Whether this type is released with the temporary arena
+  /// that it was created in.
+  bool IsTemporary() const { return Bits.Type.IsTemporary; }
+  AllocationArena GetArena() const {
+    return IsTemporary() ? AllocationArena::Temporary
+                         : AllocationArena::Permanent;
+  }
+
+  QualType GetCanType() const { return canType; }
+  bool IsCanonical() const { return canType.GetTypePtr() == this; }
 };
 
-class BuilitinType : public Type {
+class BuiltinType : public Type {
+
+public:
+  BuiltinType(TypeKind kind) : Type(kind) {}
 
 public:
-  BuilitinType(TypeKind kind) : Type(kind) {}
+  static bool IsBuiltinKind(TypeKind kind) { return IsBuiltinTypeKind(kind); }
+  static bool classof(const Type *T) { return T->IsBuiltin(); }
 };
 
-class VoidType final : public BuilitinType {
+class VoidType final : public BuiltinType {
 public:
-  VoidType() : BuilitinType(TypeKind::Void) {}
+  VoidType() : BuiltinType(TypeKind::Void) {}
 };
 
-class NullType final : public BuilitinType {
+class NullType final : public BuiltinType {
 public:
-  NullType() : BuilitinType(TypeKind::Null) {}
+  NullType() : BuiltinType(TypeKind::Null) {}
 };
 
-class NumericType : public BuilitinType {
+class NumericType : public BuiltinType {
 
 public:
-  NumericType(TypeKind kind) : BuilitinType(kind) {}
+  NumericType(TypeKind kind) : BuiltinType(kind) {}
 };
 
 class SignedType : public NumericType {
@@ -330,20 +446,74 @@ public:
 };
 
 class FunctionType : public Type {
+  QualType resultType;
 
 public:
-  FunctionType(TypeKind kind) : Type(kind) {}
+  FunctionType(TypeKind kind, QualType resultType, QualType canType)
+      : Type(kind, canType), resultType(resultType) {}
+
+public:
+  QualType GetResultType() const { return resultType; }
+
+  static bool classof(const Type *T) { return T->GetKind() == TypeKind::Fun; }
 };
 
-class FunType : public FunctionType {
+class FunType final : public FunctionType,
+                      public llvm::FoldingSetNode,
+                      private llvm::TrailingObjects<FunType, QualType> {
+  friend TrailingObjects;
+  friend class ASTContext;
+
+  FunType(QualType resultType, llvm::ArrayRef<QualType> paramTypes,
+          QualType canType)
+      : FunctionType(TypeKind::Fun, resultType, canType) {
+    Bits.FunType.NumParams = paramTypes.size();
+    assert(Bits.FunType.NumParams == paramTypes.size() && "too many params");
+    std::uninitialized_copy(paramTypes.begin(), paramTypes.end(),
+                            getTrailingObjects<QualType>());
+  }
 
 public:
-  FunType() : FunctionType(TypeKind::Fun) {}
+  unsigned GetNumParams() const { return Bits.FunType.NumParams; }
+  llvm::ArrayRef<QualType> GetParamTypes() const {
+    return {getTrailingObjects<QualType>(), GetNumParams()};
+  }
+
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    Profile(ID, GetResultType(), GetParamTypes());
+  }
+  static void Profile(llvm::FoldingSetNodeID &ID, QualType resultType,
+                      llvm::ArrayRef<QualType> paramTypes) {
+    resultType.Profile(ID);
+    ID.AddInteger(paramTypes.size());
+    for (QualType paramType : paramTypes) {
+      paramType.Profile(ID);
+    }
+  }
+
+  static bool classof(const Type *T) { return T->GetKind() == TypeKind::Fun; }
 };
 
-class PointerType : public Type {
+class PointerType final : public Type, public llvm::FoldingSetNode {
+  QualType pointeeType;
+
+public:
+  PointerType(QualType pointeeType, QualType canType)
+      : Type(TypeKind::Pointer, canType), pointeeType(pointeeType) {}
+
 public:
-  PointerType() : Type(TypeKind::Pointer) {}
+  QualType GetPointeeType() const { return pointeeType; }
+
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    Profile(ID, GetPointeeType());
+  }
+  static void Profile(llvm::FoldingSetNodeID &ID, QualType pointeeType) {
+    pointeeType.Profile(ID);
+  }
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::Pointer;
+  }
 };
 
 class BlockPointerType : public Type {
@@ -356,61 +526,184 @@ public:
   MemberPointerType() : Type(TypeKind::MemberPointer) {}
 };
 
-class ReferenceType : public Type {
+class ReferenceType : public Type, public llvm::FoldingSetNode {
+  QualType pointeeType;
+
 public:
-  ReferenceType(TypeKind kind) : Type(kind) {}
+  ReferenceType(TypeKind kind, QualType pointeeType, QualType canType)
+      : Type(kind, canType), pointeeType(pointeeType) {}
+
+public:
+  QualType GetPointeeType() const { return pointeeType; }
+
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    Profile(ID, GetPointeeType());
+  }
+  static void Profile(llvm::FoldingSetNodeID &ID, QualType pointeeType) {
+    pointeeType.Profile(ID);
+  }
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::LValueReference ||
+           T->GetKind() == TypeKind::RValueReference;
+  }
 };
 
-class LValueReferenceType : public Type {
+class LValueReferenceType final : public ReferenceType {
 public:
-  LValueReferenceType() : Type(TypeKind::LValueReference) {}
+  LValueReferenceType(QualType pointeeType, QualType canType)
+      : ReferenceType(TypeKind::LValueReference, pointeeType, canType) {}
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::LValueReference;
+  }
 };
 
-class RValueReferenceType : public Type {
+class RValueReferenceType final : public ReferenceType {
 public:
-  RValueReferenceType() : Type(TypeKind::RValueReference) {}
+  RValueReferenceType(QualType pointeeType, QualType canType)
+      : ReferenceType(TypeKind::RValueReference, pointeeType, canType) {}
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::RValueReference;
+  }
 };
 
+/// A nominal type is always canonical and is uniqued by its declaration;
+/// ASTContext caches it in TypeDecl::typeForDecl.
 class NominalType : public Type {
+  NominalTypeDecl *decl;
+
 public:
-  NominalType(TypeKind kind) : Type(kind) {}
+  NominalType(TypeKind kind, NominalTypeDecl *decl) : Type(kind), decl(decl) {}
+
+public:
+  NominalTypeDecl *GetDecl() const { return decl; }
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::Enum ||
+           T->GetKind() == TypeKind::Struct ||
+           T->GetKind() == TypeKind::Interface;
+  }
 };
 
 class EnumType : public NominalType {
 public:
-  EnumType() : NominalType(TypeKind::Enum) {}
+  EnumType(NominalTypeDecl *decl) : NominalType(TypeKind::Enum, decl) {}
+
+  static bool classof(const Type *T) { return T->GetKind() == TypeKind::Enum; }
 };
 
 class StructType : public NominalType {
 public:
-  StructType() : NominalType(TypeKind::Struct) {}
+  StructType(NominalTypeDecl *decl) : NominalType(TypeKind::Struct, decl) {}
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::Struct;
+  }
 };
 
 class InterfaceType : public NominalType {
 public:
-  InterfaceType() : NominalType(TypeKind::Interface) {}
+  InterfaceType(NominalTypeDecl *decl)
+      : NominalType(TypeKind::Interface, decl) {}
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::Interface;
+  }
 };
 
 class SugaredType : public Type {
 public:
-  SugaredType(TypeKind kind) : Type(kind) {}
+  SugaredType(TypeKind kind, QualType canType) : Type(kind, canType) {}
 };
 
+/// An alias is sugar: its canonical type is the canonical type of the type
+/// it names.
 class AliasType : public SugaredType {
+  AliasDecl *decl;
+  QualType underlyingType;
+
+public:
+  AliasType(AliasDecl *decl, QualType underlyingType, QualType canType)
+      : SugaredType(TypeKind::Alias, canType), decl(decl),
+        underlyingType(underlyingType) {}
+
 public:
-  AliasType() : SugaredType(TypeKind::Alias) {}
+  AliasDecl *GetDecl() const { return decl; }
+  QualType GetUnderlyingType() const { return underlyingType; }
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::Alias;
+  }
 };
 
 class DeducedType : public Type {
+  QualType deducedType;
+
 public:
-  DeducedType(TypeKind kind) : Type(kind) {}
+  DeducedType(TypeKind kind, QualType deducedType, QualType canType)
+      : Type(kind, canType), deducedType(deducedType) {}
+
+public:
+  QualType GetDeducedType() const { return deducedType; }
+  bool IsDeduced() const { return !deducedType.IsNull(); }
 };
 
-class AutoType final : public DeducedType {
+/// 'auto' before deduction is canonical; once deduced it is sugar for the
+/// deduced type.
+class AutoType final : public DeducedType, public llvm::FoldingSetNode {
+public:
+  AutoType(QualType deducedType, QualType canType)
+      : DeducedType(TypeKind::Auto, deducedType, canType) {}
+
 public:
-  AutoType(TypeKind kind) : DeducedType(TypeKind::Auto) {}
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    Profile(ID, GetDeducedType());
+  }
+  static void Profile(llvm::FoldingSetNodeID &ID, QualType deducedType) {
+    deducedType.Profile(ID);
+  }
+
+  static bool classof(const Type *T) { return T->GetKind() == TypeKind::Auto; }
 };
 
+/// TypeVariableType - A type that the constraint solver has yet to solve
+/// for. Type variables only exist in a temporary arena, along with every
+/// type built from one, and are not uniqued: each is its own type.
+class TypeVariableType final : public Type {
+public:
+  explicit TypeVariableType(unsigned id) : Type(TypeKind::TypeVariable) {
+    Bits.TypeVariableType.ID = id;
+  }
+
+public:
+  /// GetID - The number of this variable within its arena.
+  unsigned GetID() const { return Bits.TypeVariableType.ID; }
+
+  static bool classof(const Type *T) {
+    return T->GetKind() == TypeKind::TypeVariable;
+  }
+};
+
+inline const Type *QualType::GetTypePtr() const {
+  assert(!IsNull() && "Cannot retrieve a NULL type pointer");
+  return val.getPointer();
+}
+
+inline const Type *QualType::GetTypePtrOrNull() const {
+  return val.getPointer();
+}
+
+inline QualType QualType::GetCanType() const {
+  QualType canType = GetTypePtr()->GetCanType();
+  return canType.WithFastQuals(GetLocalFastQuals());
+}
+
+inline bool QualType::IsCanonical() const {
+  return GetTypePtr()->IsCanonical();
+}
+
 } // namespace syn
 
 } // end namespace clang
@@ -6,10 +6,11 @@
 
 namespace clang {
 namespace syn {
-constexpr size_t DeclAlignInBits = 8;
-
-// TODO: 4?
-constexpr size_t TypeAlignInBits = 8;
+/// The low bits free in a Decl or Type pointer. These are shifts, not byte
+/// counts: nodes are aligned to 1 << N bytes, and 3 is all that QualType
+/// and Decl::NextInContextAndBits need.
+constexpr size_t DeclAlignInBits = 3;
+constexpr size_t TypeAlignInBits = 3;
 } // namespace syn
 } // namespace clang
 
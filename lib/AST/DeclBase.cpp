@@ -1669,6 +1669,42 @@ void DeclContext::removeDecl(Decl *D) {
   }
 }
 
+void DeclContext::moveTrailingDeclsAfter(Decl *First, Decl *Prev) {
+  assert(First->getLexicalDeclContext() == this &&
+         "decl being moved within non-lexical context");
+  assert((!Prev || Prev->getLexicalDeclContext() == this) &&
+         "decl being moved after a decl of another context");
+
+  // Nothing to do if the run is already in place; otherwise First has a
+  // predecessor, since Prev comes before it.
+  if (First == FirstDecl ||
+      (Prev && Prev->NextInContextAndBits.getPointer() == First))
+    return;
+
+  // Unlink [First, LastDecl].  This is O(n) but hopefully rare.
+  Decl *Last = LastDecl;
+  for (Decl *I = FirstDecl; true; I = I->NextInContextAndBits.getPointer()) {
+    assert(I && "decl not found in linked list");
+    if (I->NextInContextAndBits.getPointer() == First) {
+      I->NextInContextAndBits.setPointer(nullptr);
+      LastDecl = I;
+      break;
+    }
+  }
+
+  // Link it back in after Prev.
+  if (Prev) {
+    Last->NextInContextAndBits.setPointer(
+        Prev->NextInContextAndBits.getPointer());
+    Prev->NextInContextAndBits.setPointer(First);
+    if (Prev == LastDecl)
+      LastDecl = Last;
+  } else {
+    Last->NextInContextAndBits.setPointer(FirstDecl);
+    FirstDecl = First;
+  }
+}
+
 void DeclContext::addHiddenDecl(Decl *D) {
   assert(D->getLexicalDeclContext() == this &&
          "Decl inserted into wrong lexical context");
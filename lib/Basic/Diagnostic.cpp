@@ -495,7 +495,8 @@ void DiagnosticsEngine::setSeverityForAll(diag::Flavor Flavor,
       setSeverity(Diag, Map, Loc);
 }
 
-void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
+void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag,
+                               bool countErrors) {
   assert(CurDiagID == std::numeric_limits<unsigned>::max() &&
          "Multiple diagnostics in flight at once!");
 
@@ -518,6 +519,15 @@ void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
   if (Client->IncludeInDiagnosticCounts()) {
     if (DiagLevel == DiagnosticsEngine::Warning)
       ++NumWarnings;
+    else if (countErrors && DiagLevel >= DiagnosticsEngine::Error)
+      ++NumErrors;
+  }
+  if (countErrors && DiagLevel >= DiagnosticsEngine::Error) {
+    ErrorOccurred = true;
+    UncompilableErrorOccurred = true;
+    UnrecoverableErrorOccurred = true;
+    if (DiagLevel == DiagnosticsEngine::Fatal)
+      FatalErrorOccurred = true;
   }
 
   CurDiagID = std::numeric_limits<unsigned>::max();
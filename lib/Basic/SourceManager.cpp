@@ -691,6 +691,10 @@ void SourceManager::overrideFileContents(
   IR.setBuffer(std::move(Buffer));
   IR.BufferOverridden = true;
 
+  // The line table, if any, describes the contents being replaced.
+  IR.SourceLineCache = SrcMgr::LineOffsetMapping();
+  LastLineNoFileIDQuery = FileID();
+
   getOverriddenFilesInfo().OverriddenFilesWithBuffer.insert(SourceFile);
 }
 
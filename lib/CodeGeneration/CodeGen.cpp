@@ -1,3 +1,20 @@
+#include "clang/CodeGeneration/CodeGeneration.h"
+#include "clang/Basic/CodeGenOptions.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/Frontend/Driver/CodeGenOptions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace clang;
 
 // codegen::CodeGenModule::CodeGenModule(codegen::CodeGenAction &codeGenAction)
 //     : codeGenAction(codeGenAction), codeGenPassMgr(nullptr),
@@ -13,35 +30,169 @@
 //   return std::make_unique<codegen::CodeGenExecution>(GetCodeGenModule());
 // }
 
-// codegen::CodeGenPassManager::CodeGenPassManager(llvm::Module *llvmModule)
-//     : lfpm(llvmModule) {
-//   // Register all the ctx analyses with the managers.
-//   pb.registerModuleAnalyses(mam);
-//   pb.registerCGSCCAnalyses(cgam);
-//   pb.registerFunctionAnalyses(fam);
-//   pb.registerLoopAnalyses(lam);
-//   pb.crossRegisterProxies(lam, fam, cgam, mam);
-//   // mpm =
-//   pb.buildPerModuleDefaultPipeline(codeGenOpts.GetOptimizationLevel());
-// }
+codegen::CodeGenPassManager::CodeGenPassManager(
+    llvm::TargetMachine &targetMachine, const CodeGenOptions &codeGenOpts)
+    : targetLibraryInfo(llvm::driver::createTLII(
+          targetMachine.getTargetTriple(), codeGenOpts.getVecLib())),
+      pb(&targetMachine, GetPipelineTuningOptions(codeGenOpts)),
+      verifyModule(codeGenOpts.VerifyModule),
+      disableLLVMPasses(codeGenOpts.DisableLLVMPasses) {
+  // The preset library info goes in before the default registration, which
+  // would otherwise install a plain one.
+  fam.registerPass(
+      [this] { return llvm::TargetLibraryAnalysis(*targetLibraryInfo); });
 
-// // TODO: Ok for now -- may move to IRGenMoulde
-// CodeGenTypeCache::CodeGenTypeCache(llvm::LLVMContext &llvmContext) {
+  // Register all the analyses with the managers once; they are reused for
+  // every module optimized through this pass manager.
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+}
 
-//   VoidTy = llvm::Type::getVoidTy(llvmContext);
+codegen::CodeGenPassManager::~CodeGenPassManager() = default;
 
-//   // Int types
-//   Int8Ty = llvm::Type::getInt8Ty(llvmContext);
-//   Int16Ty = llvm::Type::getInt16Ty(llvmContext);
-//   Int32Ty = llvm::Type::getInt32Ty(llvmContext);
-//   Int64Ty = llvm::Type::getInt64Ty(llvmContext);
+llvm::PipelineTuningOptions
+codegen::CodeGenPassManager::GetPipelineTuningOptions(
+    const CodeGenOptions &codeGenOpts) {
+  llvm::PipelineTuningOptions tuningOpts;
+  tuningOpts.LoopUnrolling = codeGenOpts.UnrollLoops;
+  // Loop interleaving mirrors loop unrolling, as it does in clang.
+  tuningOpts.LoopInterleaving = codeGenOpts.UnrollLoops;
+  tuningOpts.LoopVectorization = codeGenOpts.VectorizeLoop;
+  tuningOpts.SLPVectorization = codeGenOpts.VectorizeSLP;
+  tuningOpts.MergeFunctions = codeGenOpts.MergeFunctions;
+  // Only the integrated assembler understands the .cgprofile section.
+  tuningOpts.CallGraphProfile = !codeGenOpts.DisableIntegratedAS;
+  tuningOpts.UnifiedLTO = codeGenOpts.UnifiedLTO;
+  return tuningOpts;
+}
 
-//   // IntPtr types
-//   Int8PtrTy = Int8Ty->getPointerTo();
-//   Int16PtrTy = Int16Ty->getPointerTo();
-//   Int32PtrTy = Int32Ty->getPointerTo();
-//   Int64PtrTy = Int16Ty->getPointerTo();
-// }
+codegen::CodeGenOptPreset
+codegen::CodeGenPassManager::GetOptPreset(const CodeGenOptions &codeGenOpts) {
+  switch (codeGenOpts.OptimizationLevel) {
+  case 0:
+    return CodeGenOptPreset::O0;
+  case 1:
+    return CodeGenOptPreset::O1;
+  case 2:
+    switch (codeGenOpts.OptimizeSize) {
+    case 0:
+      return CodeGenOptPreset::O2;
+    case 1:
+      return CodeGenOptPreset::Os;
+    default:
+      return CodeGenOptPreset::Oz;
+    }
+  default:
+    return CodeGenOptPreset::O3;
+  }
+}
+
+llvm::OptimizationLevel
+codegen::CodeGenPassManager::GetOptimizationLevel(CodeGenOptPreset preset) {
+  switch (preset) {
+  case CodeGenOptPreset::O0:
+    return llvm::OptimizationLevel::O0;
+  case CodeGenOptPreset::O1:
+    return llvm::OptimizationLevel::O1;
+  case CodeGenOptPreset::O2:
+    return llvm::OptimizationLevel::O2;
+  case CodeGenOptPreset::O3:
+    return llvm::OptimizationLevel::O3;
+  case CodeGenOptPreset::Os:
+    return llvm::OptimizationLevel::Os;
+  case CodeGenOptPreset::Oz:
+    return llvm::OptimizationLevel::Oz;
+  }
+  llvm_unreachable("invalid optimization preset");
+}
+
+llvm::ModulePassManager &
+codegen::CodeGenPassManager::GetModulePipeline(CodeGenOptPreset preset) {
+  auto &pipeline = modulePipelines[unsigned(preset)];
+  if (!pipeline) {
+    pipeline.emplace();
+    // Catch broken IR from IR generation before any pass sees it.
+    if (verifyModule) {
+      pipeline->addPass(llvm::VerifierPass());
+    }
+    if (!disableLLVMPasses) {
+      auto level = GetOptimizationLevel(preset);
+      pipeline->addPass(preset == CodeGenOptPreset::O0
+                            ? pb.buildO0DefaultPipeline(level)
+                            : pb.buildPerModuleDefaultPipeline(level));
+    }
+  }
+  return *pipeline;
+}
+
+void codegen::CodeGenPassManager::RunModulePipeline(llvm::Module &llvmModule,
+                                                    CodeGenOptPreset preset) {
+  GetModulePipeline(preset).run(llvmModule, mam);
+  ClearAnalyses();
+  ++numModulesOptimized;
+}
+
+void codegen::CodeGenPassManager::ClearAnalyses() {
+  lam.clear();
+  fam.clear();
+  cgam.clear();
+  mam.clear();
+}
+
+void codegen::CodeGenPassManager::PrintStats() const {
+  llvm::errs() << "\n*** CodeGenPassManager Stats:\n";
+  llvm::errs() << "  " << numModulesOptimized << " modules optimized.\n";
+  unsigned numPipelines = 0;
+  for (const auto &pipeline : modulePipelines) {
+    numPipelines += pipeline.has_value();
+  }
+  llvm::errs() << "  " << numPipelines << " module pipelines built.\n";
+}
+
+unsigned codegen::GetNumSplitModules(const CodeGenOptions &codeGenOpts) {
+  unsigned numJobs = codeGenOpts.CodeGenJobs;
+  if (numJobs == 0) {
+    numJobs = llvm::heavyweight_hardware_concurrency().compute_thread_count();
+  }
+  return std::max(1u, numJobs);
+}
+
+bool codegen::EmitSplitModule(llvm::Module &llvmModule,
+                              llvm::ArrayRef<llvm::raw_pwrite_stream *> outputs,
+                              llvm::TargetMachine &targetMachine,
+                              const TargetMachineFactory &createTargetMachine,
+                              llvm::CodeGenFileType fileType) {
+  assert(!outputs.empty() && "expected at least one output");
+
+  // One piece is emitted in place, and addPassesToEmitFile reports a file
+  // type the target cannot emit before anything is written.
+  if (outputs.size() == 1) {
+    llvm::legacy::PassManager codeGenPasses;
+    if (targetMachine.addPassesToEmitFile(codeGenPasses, *outputs[0],
+                                          /*DwoOut=*/nullptr, fileType)) {
+      return false;
+    }
+    codeGenPasses.run(llvmModule);
+    return true;
+  }
+
+  // splitCodeGen gives up with a fatal error when a piece cannot be set
+  // up, so find out first whether the target can emit this file type.
+  llvm::SmallString<0> probeBuffer;
+  llvm::raw_svector_ostream probe(probeBuffer);
+  llvm::legacy::PassManager probePasses;
+  if (targetMachine.addPassesToEmitFile(probePasses, probe,
+                                        /*DwoOut=*/nullptr, fileType)) {
+    return false;
+  }
+
+  llvm::splitCodeGen(llvmModule, outputs, /*BCOSs=*/{}, createTargetMachine,
+                     fileType, /*PreserveLocals=*/true);
+  return true;
+}
 
 // void CodeGenExecution::GenerateIR() {
 
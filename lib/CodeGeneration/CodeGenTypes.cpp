@@ -0,0 +1,207 @@
+#include "clang/CodeGeneration/CodeGeneration.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+codegen::CodeGenTypeCache::CodeGenTypeCache(
+    llvm::LLVMContext &llvmContext, const llvm::DataLayout &dataLayout) {
+
+  VoidTy = llvm::Type::getVoidTy(llvmContext);
+
+  // Int types
+  Int1Ty = llvm::Type::getInt1Ty(llvmContext);
+  Int8Ty = llvm::Type::getInt8Ty(llvmContext);
+  Int16Ty = llvm::Type::getInt16Ty(llvmContext);
+  Int32Ty = llvm::Type::getInt32Ty(llvmContext);
+  Int64Ty = llvm::Type::getInt64Ty(llvmContext);
+  Int128Ty = llvm::Type::getInt128Ty(llvmContext);
+  IntTy = dataLayout.getIntPtrType(llvmContext);
+
+  // Float types
+  HalfTy = llvm::Type::getHalfTy(llvmContext);
+  FloatTy = llvm::Type::getFloatTy(llvmContext);
+  DoubleTy = llvm::Type::getDoubleTy(llvmContext);
+
+  PtrTy = llvm::PointerType::getUnqual(llvmContext);
+
+  CharTy = Int32Ty;
+
+  RelativeAddressTy = Int32Ty;
+  RelativeAddressPtrTy = PtrTy;
+}
+
+codegen::CodeGenTypes::CodeGenTypes(llvm::LLVMContext &llvmContext,
+                                    const llvm::DataLayout &dataLayout)
+    : llvmContext(llvmContext), typeCache(llvmContext, dataLayout) {}
+
+llvm::Type *codegen::CodeGenTypes::ConvertType(syn::QualType ty) {
+  // Qualifiers and sugar do not change the lowering, so everything is keyed
+  // by the canonical type.
+  const syn::Type *canType = ty.GetCanType().GetTypePtr();
+
+  ++numLookups;
+  auto found = convertedTypes.find(canType);
+  if (found != convertedTypes.end()) {
+    return found->second;
+  }
+  ++numConversions;
+  llvm::Type *llvmType = ConvertCanType(canType);
+
+  // Converting a function type converts its parameters, which may have
+  // grown the map; insert rather than hold on to an iterator.
+  convertedTypes.try_emplace(canType, llvmType);
+  return llvmType;
+}
+
+llvm::Type *codegen::CodeGenTypes::ConvertTypeForMem(syn::QualType ty) {
+  llvm::Type *llvmType = ConvertType(ty);
+  // Nothing is stored in less than a byte.
+  if (llvmType->isIntegerTy(1)) {
+    return typeCache.Int8Ty;
+  }
+  return llvmType;
+}
+
+llvm::FunctionType *
+codegen::CodeGenTypes::ConvertFunType(const syn::FunType *funType) {
+  return llvm::cast<llvm::FunctionType>(
+      ConvertType(syn::QualType(funType, 0)));
+}
+
+llvm::Type *codegen::CodeGenTypes::ConvertCanType(const syn::Type *canType) {
+  assert(canType->IsCanonical() && "expected a canonical type");
+
+  switch (canType->GetKind()) {
+  case syn::TypeKind::Void:
+    return typeCache.VoidTy;
+  case syn::TypeKind::Bool:
+    return typeCache.Int1Ty;
+  case syn::TypeKind::Int:
+  case syn::TypeKind::UInt:
+    return typeCache.IntTy;
+  case syn::TypeKind::Int8:
+  case syn::TypeKind::UInt8:
+  case syn::TypeKind::Char8:
+    return typeCache.Int8Ty;
+  case syn::TypeKind::Int16:
+  case syn::TypeKind::UInt16:
+  case syn::TypeKind::Char16:
+    return typeCache.Int16Ty;
+  case syn::TypeKind::Int32:
+  case syn::TypeKind::UInt32:
+  case syn::TypeKind::Char32:
+    return typeCache.Int32Ty;
+  case syn::TypeKind::Char:
+    return typeCache.CharTy;
+  case syn::TypeKind::Int64:
+  case syn::TypeKind::UInt64:
+    return typeCache.Int64Ty;
+  case syn::TypeKind::Int128:
+  case syn::TypeKind::UInt128:
+    return typeCache.Int128Ty;
+  case syn::TypeKind::Float16:
+    return typeCache.HalfTy;
+  case syn::TypeKind::Float32:
+  case syn::TypeKind::Imaginary32:
+    return typeCache.FloatTy;
+  case syn::TypeKind::Float:
+  case syn::TypeKind::Float64:
+  case syn::TypeKind::Imaginary64:
+    return typeCache.DoubleTy;
+  case syn::TypeKind::Complex32:
+    return llvm::StructType::get(typeCache.FloatTy, typeCache.FloatTy);
+  case syn::TypeKind::Complex64:
+    return llvm::StructType::get(typeCache.DoubleTy, typeCache.DoubleTy);
+
+  case syn::TypeKind::Null:
+  case syn::TypeKind::Pointer:
+  case syn::TypeKind::BlockPointer:
+  case syn::TypeKind::MemberPointer:
+  case syn::TypeKind::LValueReference:
+  case syn::TypeKind::RValueReference:
+    return typeCache.PtrTy;
+
+  case syn::TypeKind::Fun: {
+    auto *funType = llvm::cast<syn::FunType>(canType);
+    llvm::SmallVector<llvm::Type *, 8> paramTypes;
+    paramTypes.reserve(funType->GetNumParams());
+    for (syn::QualType paramType : funType->GetParamTypes()) {
+      paramTypes.push_back(ConvertType(paramType));
+    }
+    return llvm::FunctionType::get(ConvertType(funType->GetResultType()),
+                                   paramTypes, /*isVarArg=*/false);
+  }
+
+  case syn::TypeKind::Enum: {
+    // ASTContext::GetEnumType only creates EnumTypes for EnumDecls.
+    auto *enumDecl = static_cast<const syn::EnumDecl *>(
+        llvm::cast<syn::EnumType>(canType)->GetDecl());
+    syn::QualType integerType = enumDecl->GetIntegerType();
+    // An enum without an explicit integer type is an int32.
+    return integerType.IsNull() ? typeCache.Int32Ty
+                                : ConvertType(integerType);
+  }
+  case syn::TypeKind::Struct:
+  case syn::TypeKind::Interface:
+    return CreateNominalStruct(llvm::cast<syn::NominalType>(canType));
+
+  case syn::TypeKind::Alias:
+    llvm_unreachable("alias types are never canonical");
+  case syn::TypeKind::Auto:
+    llvm_unreachable("cannot lower an undeduced 'auto'");
+  case syn::TypeKind::TypeVariable:
+    llvm_unreachable("cannot lower an unsolved type variable");
+  case syn::TypeKind::None:
+    break;
+  }
+  llvm_unreachable("invalid type kind");
+}
+
+llvm::StructType *codegen::CodeGenTypes::CreateNominalStruct(
+    const syn::NominalType *nominalType) {
+  bool isInterface = llvm::isa<syn::InterfaceType>(nominalType);
+
+  llvm::SmallString<64> name(isInterface ? "interface." : "struct.");
+  name += nominalType->GetDecl()->GetName().getAsString();
+
+  // Created opaque. ConvertType caches it before CompleteNominalType lowers
+  // any member, so a member that refers back to this type finds the
+  // placeholder instead of recursing.
+  auto *structType = llvm::StructType::create(llvmContext, name);
+
+  // An interface value is an existential: the value and its witness table.
+  if (isInterface) {
+    structType->setBody({typeCache.PtrTy, typeCache.PtrTy});
+  }
+  return structType;
+}
+
+void codegen::CodeGenTypes::CompleteNominalType(
+    const syn::NominalType *nominalType,
+    llvm::ArrayRef<syn::QualType> memberTypes) {
+  auto *structType = llvm::cast<llvm::StructType>(
+      ConvertType(syn::QualType(nominalType, 0)));
+  if (!structType->isOpaque()) {
+    return;
+  }
+  llvm::SmallVector<llvm::Type *, 8> llvmMemberTypes;
+  llvmMemberTypes.reserve(memberTypes.size());
+  for (syn::QualType memberType : memberTypes) {
+    llvmMemberTypes.push_back(ConvertTypeForMem(memberType));
+  }
+  structType->setBody(llvmMemberTypes);
+}
+
+void codegen::CodeGenTypes::PrintStats() const {
+  llvm::errs() << "\n*** CodeGenTypes Stats:\n";
+  llvm::errs() << "  " << convertedTypes.size() << " types lowered.\n";
+  llvm::errs() << "  " << numLookups << " lookups, " << numConversions
+               << " conversions.\n";
+}
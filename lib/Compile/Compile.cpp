@@ -1,6 +1,14 @@
 #include "clang/Compile/Compile.h"
+#include "clang/Compile/CompileCache.h"
+#include "clang/Compile/DependencyScanner.h"
 #include "clang/ARCMigrate/ARCMTActions.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/DiagnosticFrontend.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/CodeGen/BackendUtil.h"
 #include "clang/CodeGen/CodeGenAction.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/CodeGeneration/CodeGeneration.h"
 #include "clang/Config/config.h"
 #include "clang/Driver/Options.h"
 #include "clang/ExtractAPI/FrontendActions.h"
@@ -14,11 +22,23 @@
 #include "clang/StaticAnalyzer/Frontend/AnalyzerHelpFlags.h"
 #include "clang/StaticAnalyzer/Frontend/FrontendActions.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/TargetRegistry.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Option/Option.h"
 #include "llvm/Support/BuryPointer.h"
+#include "llvm/Support/CodeGen.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
 
 using namespace clang;
 using namespace llvm::opt;
@@ -67,6 +87,32 @@ bool clang::Compile(CompilerInstance &clangInstance) {
   if (clangInstance.getDiagnostics().hasErrorOccurred()) {
     return false;
   }
+  if (!clangInstance.getFrontendOpts().BatchInputsFile.empty() &&
+      !clang::LoadBatchInputs(clangInstance)) {
+    return false;
+  }
+  if (clangInstance.getFrontendOpts().ScanImports) {
+    return clang::ScanDependencies(clangInstance);
+  }
+  if (clangInstance.getFrontendOpts().CompileModule) {
+    return clang::CompileModule(clangInstance);
+  }
+  // Code generation actions run as separately timed stages instead of one
+  // monolithic backend action, unless they need something only the backend
+  // action sets up.
+  switch (clangInstance.getFrontendOpts().ProgramAction) {
+  case frontend::EmitAssembly:
+  case frontend::EmitBC:
+  case frontend::EmitLLVM:
+  case frontend::EmitLLVMOnly:
+  case frontend::EmitObj:
+    if (clang::CanStageCodeGeneration(clangInstance)) {
+      return clang::ExecuteCompileLLVM(clangInstance);
+    }
+    return clang::ExecuteBackendAction(clangInstance);
+  default:
+    break;
+  }
   auto frontendAction = clang::CreateFrontendAction(clangInstance);
   bool success = clangInstance.ExecuteAction(*frontendAction);
 
@@ -76,18 +122,551 @@ bool clang::Compile(CompilerInstance &clangInstance) {
   return success;
 }
 
+bool clang::LoadBatchInputs(CompilerInstance &instance) {
+  FrontendOptions &frontendOpts = instance.getFrontendOpts();
+  auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(
+      frontendOpts.BatchInputsFile, /*IsText=*/true);
+  if (!buffer) {
+    instance.getDiagnostics().Report(diag::err_fe_error_reading)
+        << frontendOpts.BatchInputsFile << buffer.getError().message();
+    return false;
+  }
+
+  // Each line is an input and an optional output file; blank lines and
+  // lines starting with '#' are skipped.
+  frontendOpts.Inputs.clear();
+  frontendOpts.BatchOutputFiles.clear();
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  for (llvm::StringRef line : lines) {
+    line = line.trim();
+    if (line.empty() || line.starts_with("#")) {
+      continue;
+    }
+    auto [inputFile, outputFile] = llvm::getToken(line);
+    InputKind kind = frontendOpts.DashX;
+    if (kind.isUnknown()) {
+      kind = FrontendOptions::getInputKindForExtension(
+          llvm::sys::path::extension(inputFile).drop_front());
+    }
+    frontendOpts.Inputs.emplace_back(inputFile, kind);
+    frontendOpts.BatchOutputFiles.emplace_back(outputFile.trim());
+  }
+  return true;
+}
+
 bool clang::ExecuteAction() {}
 
+bool clang::CanStageCodeGeneration(const CompilerInstance &instance) {
+  const CodeGenOptions &codeGenOpts = instance.getCodeGenOpts();
+  if (!instance.getLangOpts().Sanitize.empty() ||
+      codeGenOpts.SanitizeCoverageType || codeGenOpts.hasProfileInstr() ||
+      codeGenOpts.hasProfileIRUse() || codeGenOpts.hasProfileClangUse() ||
+      !codeGenOpts.SampleProfileFile.empty() ||
+      !codeGenOpts.MemoryProfileUsePath.empty() ||
+      codeGenOpts.PseudoProbeForProfiling ||
+      !codeGenOpts.CoverageNotesFile.empty() ||
+      !codeGenOpts.CoverageDataFile.empty() ||
+      codeGenOpts.InstrumentFunctions ||
+      codeGenOpts.InstrumentFunctionEntryBare ||
+      codeGenOpts.InstrumentFunctionsAfterInlining) {
+    return false;
+  }
+  if (codeGenOpts.PrepareForLTO || codeGenOpts.PrepareForThinLTO ||
+      !codeGenOpts.ThinLTOIndexFile.empty() ||
+      !codeGenOpts.LinkBitcodeFiles.empty() ||
+      codeGenOpts.getEmbedBitcode() != CodeGenOptions::Embed_Off ||
+      !codeGenOpts.SplitDwarfOutput.empty()) {
+    return false;
+  }
+  return codeGenOpts.PassPlugins.empty() &&
+         codeGenOpts.PassBuilderCallbacks.empty() &&
+         !codeGenOpts.DebugPassManager && !codeGenOpts.VerifyEach;
+}
+
+bool clang::ExecuteBackendAction(CompilerInstance &instance) {
+  FrontendOptions &frontendOpts = instance.getFrontendOpts();
+  if (frontendOpts.BatchInputsFile.empty()) {
+    auto frontendAction = clang::CreateFrontendAction(instance);
+    bool success = instance.ExecuteAction(*frontendAction);
+    if (frontendOpts.DisableFree) {
+      llvm::BuryPointer(std::move(frontendAction));
+    }
+    return success;
+  }
+
+  // ExecuteAction writes every input to the same -o, so a batch runs the
+  // action once per input with that input's output file.
+  std::vector<FrontendInputFile> inputs = std::move(frontendOpts.Inputs);
+  bool success = true;
+  for (unsigned i = 0, e = inputs.size(); i != e; ++i) {
+    frontendOpts.Inputs = {inputs[i]};
+    frontendOpts.OutputFile = frontendOpts.BatchOutputFiles[i];
+    auto frontendAction = clang::CreateFrontendAction(instance);
+    if (!instance.ExecuteAction(*frontendAction)) {
+      success = false;
+      instance.getDiagnostics().Reset(/*soft=*/true);
+    }
+  }
+  frontendOpts.Inputs = std::move(inputs);
+  return success;
+}
+
 bool clang::ExecuteCodeAnalysis() { return true; }
 
-bool clang::SetupCodeGeneration() {}
+namespace {
+
+/// CompileStageTimer - Times one code generation stage under -ftime-report
+/// and records it under -ftime-trace.
+class CompileStageTimer final {
+  llvm::NamedRegionTimer timer;
+  llvm::TimeTraceScope timeTraceScope;
+
+public:
+  CompileStageTimer(CompilerInstance &instance, llvm::StringRef name,
+                    llvm::StringRef description, llvm::StringRef detail = "")
+      : timer(name, description, "stone-compile", "Stone Compile Stages",
+              instance.getCodeGenOpts().TimePasses),
+        timeTraceScope(description, detail) {}
+};
+
+/// IRGenConsumer - Lowers the AST through a CodeGenerator.
+class IRGenConsumer final : public ASTConsumer {
+  std::unique_ptr<CodeGenerator> codeGen;
+
+public:
+  IRGenConsumer(CompilerInstance &instance, llvm::StringRef moduleName,
+                llvm::LLVMContext &llvmContext)
+      : codeGen(CreateLLVMCodeGen(
+            instance.getDiagnostics(), moduleName,
+            &instance.getVirtualFileSystem(),
+            instance.getHeaderSearchOpts(), instance.getPreprocessorOpts(),
+            instance.getCodeGenOpts(), llvmContext)) {}
+
+  std::unique_ptr<llvm::Module> TakeModule() {
+    return std::unique_ptr<llvm::Module>(codeGen->ReleaseModule());
+  }
+
+  void Initialize(ASTContext &context) override {
+    codeGen->Initialize(context);
+  }
+
+  bool HandleTopLevelDecl(DeclGroupRef group) override {
+    return codeGen->HandleTopLevelDecl(group);
+  }
+
+  void HandleInlineFunctionDefinition(FunctionDecl *funDecl) override {
+    codeGen->HandleInlineFunctionDefinition(funDecl);
+  }
+
+  void HandleCXXStaticMemberVarInstantiation(VarDecl *varDecl) override {
+    codeGen->HandleCXXStaticMemberVarInstantiation(varDecl);
+  }
+
+  void HandleTopLevelDeclInObjCContainer(DeclGroupRef group) override {
+    codeGen->HandleTopLevelDeclInObjCContainer(group);
+  }
+
+  void HandleTagDeclDefinition(TagDecl *tagDecl) override {
+    codeGen->HandleTagDeclDefinition(tagDecl);
+  }
+
+  void HandleTagDeclRequiredDefinition(const TagDecl *tagDecl) override {
+    codeGen->HandleTagDeclRequiredDefinition(tagDecl);
+  }
+
+  void CompleteTentativeDefinition(VarDecl *varDecl) override {
+    codeGen->CompleteTentativeDefinition(varDecl);
+  }
+
+  void CompleteExternalDeclaration(VarDecl *varDecl) override {
+    codeGen->CompleteExternalDeclaration(varDecl);
+  }
+
+  void AssignInheritanceModel(CXXRecordDecl *recordDecl) override {
+    codeGen->AssignInheritanceModel(recordDecl);
+  }
+
+  void HandleVTable(CXXRecordDecl *recordDecl) override {
+    codeGen->HandleVTable(recordDecl);
+  }
+
+  void HandleTranslationUnit(ASTContext &context) override {
+    codeGen->HandleTranslationUnit(context);
+  }
+};
+
+/// IRGenAction - Parses one input into an IRGenConsumer and hands out the
+/// resulting module.
+class IRGenAction final : public ASTFrontendAction {
+  llvm::LLVMContext &llvmContext;
+  IRGenConsumer *irGenConsumer = nullptr;
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &instance,
+                                                 StringRef inFile) override {
+    auto consumer =
+        std::make_unique<IRGenConsumer>(instance, inFile, llvmContext);
+    irGenConsumer = consumer.get();
+    return consumer;
+  }
+
+public:
+  explicit IRGenAction(llvm::LLVMContext &llvmContext)
+      : llvmContext(llvmContext) {}
+
+  std::unique_ptr<llvm::Module> TakeModule() {
+    return irGenConsumer ? irGenConsumer->TakeModule() : nullptr;
+  }
+};
+
+} // namespace
+
+codegen::TargetMachineFactory
+clang::SetupCodeGeneration(CompilerInstance &instance) {
+  CompileStageTimer stageTimer(instance, "setup", "Code Generation Setup");
+
+  if (!instance.hasTarget() && !instance.createTarget()) {
+    return nullptr;
+  }
+  std::string triple = instance.getTarget().getTriple().str();
+  const TargetOptions &targetOpts = instance.getTargetOpts();
+  const CodeGenOptions &codeGenOpts = instance.getCodeGenOpts();
+
+  std::string error;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    instance.getDiagnostics().Report(diag::err_fe_unable_to_create_target)
+        << error;
+    return nullptr;
+  }
+
+  // The same options, code model and thresholds as clang's BackendUtil.
+  llvm::TargetOptions options;
+  if (!clang::initTargetOptions(instance.getDiagnostics(), options,
+                                codeGenOpts, targetOpts,
+                                instance.getLangOpts(),
+                                instance.getHeaderSearchOpts())) {
+    return nullptr;
+  }
+
+  // Everything is resolved here, on the calling thread; the factory itself
+  // only creates the target machine, so it is safe to call from the parallel
+  // code generation threads.
+  std::string cpu = targetOpts.CPU;
+  std::string features = llvm::join(targetOpts.Features, ",");
+  llvm::Reloc::Model relocModel = codeGenOpts.RelocationModel;
+  std::optional<llvm::CodeModel::Model> codeModel =
+      clang::getCodeModel(codeGenOpts);
+  uint64_t largeDataThreshold = codeGenOpts.LargeDataThreshold;
+  llvm::CodeGenOptLevel optLevel =
+      llvm::CodeGenOpt::getLevel(codeGenOpts.OptimizationLevel)
+          .value_or(llvm::CodeGenOptLevel::Default);
+  return [=]() {
+    std::unique_ptr<llvm::TargetMachine> targetMachine(
+        target->createTargetMachine(triple, cpu, features, options,
+                                    relocModel, codeModel, optLevel));
+    targetMachine->setLargeDataThreshold(largeDataThreshold);
+    return targetMachine;
+  };
+}
+
+std::unique_ptr<llvm::Module>
+clang::ExecuteIRGeneration(CompilerInstance &instance,
+                           codegen::CodeGenPassManager &passManager,
+                           const FrontendInputFile &input,
+                           llvm::LLVMContext &llvmContext) {
+  CompileStageTimer stageTimer(instance, "irgen", "IR Generation",
+                               input.getFile());
+
+  IRGenAction irGenAction(llvmContext);
+  if (!irGenAction.BeginSourceFile(instance, input)) {
+    passManager.ClearAnalyses();
+    return nullptr;
+  }
+  if (llvm::Error err = irGenAction.Execute()) {
+    llvm::consumeError(std::move(err));
+  }
+  auto llvmModule = irGenAction.TakeModule();
+  // Under -disable-free the consumer is never destroyed, so nothing else
+  // would drop analyses computed for IR of an earlier input.
+  passManager.ClearAnalyses();
+  irGenAction.EndSourceFile();
+
+  if (instance.getDiagnostics().hasErrorOccurred()) {
+    return nullptr;
+  }
+  return llvmModule;
+}
+
+bool clang::ExecuteIROptimization(CompilerInstance &instance,
+                                  codegen::CodeGenPassManager &passManager,
+                                  llvm::Module &llvmModule) {
+  CompileStageTimer stageTimer(instance, "iropt", "IR Optimization",
+                               llvmModule.getName());
+
+  passManager.RunModulePipeline(
+      llvmModule,
+      codegen::CodeGenPassManager::GetOptPreset(instance.getCodeGenOpts()));
+  return true;
+}
+
+/// GetOutputExtension - The extension of the output file that the program
+/// action writes, or "" if it writes none.
+static llvm::StringRef GetOutputExtension(CompilerInstance &instance) {
+  switch (instance.getFrontendOpts().ProgramAction) {
+  case frontend::EmitLLVMOnly:
+    return "";
+  case frontend::EmitBC:
+    return "bc";
+  case frontend::EmitLLVM:
+    return "ll";
+  case frontend::EmitAssembly:
+    return "s";
+  default:
+    return "o";
+  }
+}
+
+/// GetOutputPath - The output file of \p input, as createDefaultOutputFile
+/// names it, or "-" for stdout.
+static std::string GetOutputPath(CompilerInstance &instance,
+                                 const FrontendInputFile &input,
+                                 llvm::StringRef extension) {
+  llvm::StringRef outputFile = instance.getFrontendOpts().OutputFile;
+  if (!outputFile.empty()) {
+    return std::string(outputFile);
+  }
+  if (input.getFile() == "-") {
+    return "-";
+  }
+  llvm::SmallString<128> path(input.getFile());
+  llvm::sys::path::replace_extension(path, extension);
+  return std::string(path);
+}
 
-bool clang::ExecuteCodeGeneration() {}
+/// ReplayCachedDiagnostics - Report the diagnostics of a cached compile
+/// through the DiagnosticsEngine, as the compile itself did, so that they
+/// are printed, counted and filtered like any other.
+static void ReplayCachedDiagnostics(
+    CompilerInstance &instance,
+    llvm::ArrayRef<CompileCache::CachedDiagnostic> diagnostics) {
+  if (diagnostics.empty()) {
+    return;
+  }
+  if (!instance.hasFileManager()) {
+    instance.createFileManager();
+  }
+  if (!instance.hasSourceManager()) {
+    instance.createSourceManager(instance.getFileManager());
+  }
+  SourceManager &sm = instance.getSourceManager();
+  DiagnosticsEngine &diags = instance.getDiagnostics();
 
-bool clang::ExecuteIRGeneration() {}
+  diags.getClient()->BeginSourceFile(instance.getLangOpts());
+  for (const CompileCache::CachedDiagnostic &cached : diagnostics) {
+    // A file that is gone or that no longer has the line is reported
+    // without a location.
+    FullSourceLoc loc;
+    if (!cached.fileName.empty() && cached.line && cached.column) {
+      if (auto file =
+              instance.getFileManager().getOptionalFileRef(cached.fileName)) {
+        FileID fileID = sm.getOrCreateFileID(*file, SrcMgr::C_User);
+        SourceLocation fileLoc =
+            sm.translateLineCol(fileID, cached.line, cached.column);
+        if (fileLoc.isValid()) {
+          loc = FullSourceLoc(fileLoc, sm);
+        }
+      }
+    }
+    diags.Report(StoredDiagnostic(cached.level, cached.id, cached.message,
+                                  loc, /*Ranges=*/{}, /*Fixits=*/{}),
+                 /*countErrors=*/true);
+  }
+  diags.getClient()->EndSourceFile();
+}
 
-bool clang::ExecuteIROptimization() {}
+/// ReplayCachedOutput - Write the output of \p input from \p entry and
+/// report the diagnostics that came with it.
+static bool ReplayCachedOutput(CompilerInstance &instance,
+                               const FrontendInputFile &input,
+                               const CompileCache::Entry &entry) {
+  CompileStageTimer stageTimer(instance, "cache", "Compile Cache Replay",
+                               input.getFile());
 
-bool clang::ExecuteNativeGeneration() {}
+  ReplayCachedDiagnostics(instance, entry.diagnostics);
+  llvm::StringRef extension = GetOutputExtension(instance);
+  auto output = instance.createDefaultOutputFile(
+      /*Binary=*/extension != "ll" && extension != "s", input.getFile(),
+      extension);
+  if (!output) {
+    return false;
+  }
+  *output << entry.output;
+  return true;
+}
 
-bool clang::ExecuteCompileLLVM() {}
+/// GetSplitOutputPath - The output file of piece \p piece of a split module,
+/// next to the main output \p outputPath: "foo.o" becomes "foo.<piece>.o".
+static std::string GetSplitOutputPath(llvm::StringRef outputPath,
+                                      llvm::StringRef extension,
+                                      unsigned piece) {
+  llvm::SmallString<128> path(outputPath);
+  llvm::sys::path::replace_extension(path,
+                                     llvm::Twine(piece) + "." + extension);
+  return std::string(path);
+}
+
+bool clang::ExecuteNativeGeneration(
+    CompilerInstance &instance, llvm::TargetMachine &targetMachine,
+    const codegen::TargetMachineFactory &createTargetMachine,
+    const FrontendInputFile &input, llvm::Module &llvmModule) {
+  CompileStageTimer stageTimer(instance, "native", "Native Generation",
+                               input.getFile());
+
+  llvm::StringRef extension = GetOutputExtension(instance);
+  if (extension.empty()) {
+    return true;
+  }
+
+  auto output = instance.createDefaultOutputFile(
+      /*Binary=*/extension != "ll" && extension != "s", input.getFile(),
+      extension);
+  if (!output) {
+    return false;
+  }
+  if (extension == "bc") {
+    llvm::WriteBitcodeToFile(llvmModule, *output);
+    return true;
+  }
+  if (extension == "ll") {
+    llvmModule.print(*output, nullptr);
+    return true;
+  }
+
+  // With -codegen-jobs the module is split and every piece after the first
+  // is written next to the main output, empty pieces included.
+  bool binary = extension == "o";
+  llvm::SmallVector<std::unique_ptr<llvm::raw_pwrite_stream>, 8> pieceOutputs;
+  llvm::SmallVector<llvm::raw_pwrite_stream *, 8> outputs = {output.get()};
+  unsigned numPieces = codegen::GetNumSplitModules(instance.getCodeGenOpts());
+  std::string outputPath = GetOutputPath(instance, input, extension);
+  if (numPieces > 1 && outputPath == "-") {
+    instance.getDiagnostics().Report(diag::err_fe_split_output_to_stdout)
+        << numPieces;
+    return false;
+  }
+  for (unsigned piece = 1; piece < numPieces; ++piece) {
+    pieceOutputs.push_back(instance.createOutputFile(
+        GetSplitOutputPath(outputPath, extension, piece), binary,
+        /*RemoveFileOnSignal=*/true, instance.getFrontendOpts().UseTemporary));
+    if (!pieceOutputs.back()) {
+      return false;
+    }
+    outputs.push_back(pieceOutputs.back().get());
+  }
+
+  auto fileType = binary ? llvm::CodeGenFileType::ObjectFile
+                         : llvm::CodeGenFileType::AssemblyFile;
+  if (!codegen::EmitSplitModule(llvmModule, outputs, targetMachine,
+                                createTargetMachine, fileType)) {
+    instance.getDiagnostics().Report(
+        diag::err_fe_unable_to_interface_with_target);
+    return false;
+  }
+  return true;
+}
+
+bool clang::ExecuteCompileLLVM(CompilerInstance &instance) {
+  auto createTargetMachine = clang::SetupCodeGeneration(instance);
+  if (!createTargetMachine) {
+    return false;
+  }
+  auto targetMachine = createTargetMachine();
+
+  // One pass manager for all inputs, so that the analyses are registered and
+  // the pipelines built only once.
+  codegen::CodeGenPassManager passManager(*targetMachine,
+                                          instance.getCodeGenOpts());
+
+  // In a batch every input has its own output file, and an error in one
+  // input must not fail the ones after it.
+  FrontendOptions &frontendOpts = instance.getFrontendOpts();
+  bool isBatch = !frontendOpts.BatchInputsFile.empty();
+
+  // Only a compile that writes one output file can be cached, which is not
+  // the case under -codegen-jobs.
+  std::optional<CompileCache> compileCache;
+  llvm::StringRef extension = GetOutputExtension(instance);
+  if (!frontendOpts.CompileCachePath.empty() && !extension.empty() &&
+      instance.getCodeGenOpts().CodeGenJobs == 1) {
+    compileCache.emplace(frontendOpts.CompileCachePath,
+                         uint64_t(frontendOpts.CompileCacheSize) << 20,
+                         instance.getInvocation());
+  }
+
+  bool success = true;
+  for (unsigned i = 0, e = frontendOpts.Inputs.size(); i != e; ++i) {
+    const FrontendInputFile &input = frontendOpts.Inputs[i];
+    if (isBatch) {
+      frontendOpts.OutputFile = frontendOpts.BatchOutputFiles[i];
+    }
+
+    std::string cacheKey;
+    if (compileCache && input.getFile() != "-" &&
+        GetOutputPath(instance, input, extension) != "-") {
+      if (auto contents = llvm::MemoryBuffer::getFile(input.getFile())) {
+        cacheKey = compileCache->ComputeKey(input, (*contents)->getBuffer());
+      }
+    }
+    if (!cacheKey.empty()) {
+      if (auto entry = compileCache->Lookup(cacheKey)) {
+        bool replayed = ReplayCachedOutput(instance, input, *entry);
+        instance.clearOutputFiles(/*EraseFiles=*/!replayed);
+        success &= replayed;
+        continue;
+      }
+    }
+
+    std::optional<CompileCache::DiagnosticRecorder> diagRecorder;
+    if (!cacheKey.empty()) {
+      diagRecorder.emplace(instance.getDiagnostics());
+    }
+    llvm::LLVMContext llvmContext;
+    auto llvmModule =
+        clang::ExecuteIRGeneration(instance, passManager, input, llvmContext);
+    bool compiled =
+        llvmModule &&
+        clang::ExecuteIROptimization(instance, passManager, *llvmModule) &&
+        clang::ExecuteNativeGeneration(instance, *targetMachine,
+                                       createTargetMachine, input,
+                                       *llvmModule);
+    instance.clearOutputFiles(/*EraseFiles=*/!compiled);
+    success &= compiled;
+
+    // The output is in its final place now; cache it from there.
+    if (diagRecorder && compiled) {
+      if (auto output = llvm::MemoryBuffer::getFile(
+              GetOutputPath(instance, input, extension))) {
+        compileCache->Store(cacheKey, (*output)->getBuffer(),
+                            diagRecorder->GetDiagnostics());
+      }
+    }
+    diagRecorder.reset();
+    if (isBatch && !compiled) {
+      instance.getDiagnostics().Reset(/*soft=*/true);
+    }
+  }
+  if (compileCache) {
+    compileCache->Prune();
+  }
+  if (instance.getFrontendOpts().ShowStats) {
+    passManager.PrintStats();
+    if (compileCache) {
+      compileCache->PrintStats();
+    }
+  }
+  return success;
+}
@@ -0,0 +1,278 @@
+#include "clang/Compile/CompileCache.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ChainedDiagnosticConsumer.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendOptions.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/BLAKE3.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+/// An entry file is the length of the encoded diagnostics as a little-endian
+/// 64-bit integer, the encoded diagnostics, and then the output.
+static constexpr size_t EntryHeaderSize = sizeof(uint64_t);
+
+/// The prefix of the entry files; llvm::pruneCache only looks at these.
+static constexpr llvm::StringLiteral EntryPrefix("llvmcache-");
+
+static void HashString(llvm::BLAKE3 &hasher, llvm::StringRef str) {
+  // The terminator keeps "ab","c" and "a","bc" apart.
+  hasher.update(str);
+  hasher.update(llvm::StringRef("\0", 1));
+}
+
+namespace {
+
+/// DiagnosticEncoder - Appends every diagnostic to a string, as a
+/// CompileCache::CachedDiagnostic in the form that DecodeDiagnostics reads:
+/// the level, ID, line and column as little-endian 32-bit integers, then the
+/// file name and the message, each prefixed by its length.
+class DiagnosticEncoder final : public DiagnosticConsumer {
+  std::string &encoded;
+
+  void Write32(uint32_t value) {
+    char bytes[sizeof(uint32_t)];
+    llvm::support::endian::write32le(bytes, value);
+    encoded.append(bytes, sizeof(bytes));
+  }
+
+  void WriteString(llvm::StringRef str) {
+    Write32(str.size());
+    encoded.append(str.begin(), str.end());
+  }
+
+public:
+  explicit DiagnosticEncoder(std::string &encoded) : encoded(encoded) {}
+
+  void HandleDiagnostic(DiagnosticsEngine::Level level,
+                        const Diagnostic &info) override {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+    llvm::SmallString<128> message;
+    info.FormatDiagnostic(message);
+
+    // Locations in macro expansions are kept as the place they were
+    // expanded at.
+    llvm::StringRef fileName;
+    unsigned line = 0;
+    unsigned column = 0;
+    if (info.getLocation().isValid() && info.hasSourceManager()) {
+      FullSourceLoc loc =
+          FullSourceLoc(info.getLocation(), info.getSourceManager())
+              .getFileLoc();
+      if (OptionalFileEntryRef file = loc.getFileEntryRef()) {
+        fileName = file->getName();
+        line = loc.getLineNumber();
+        column = loc.getColumnNumber();
+      }
+    }
+
+    Write32(level);
+    Write32(info.getID());
+    Write32(line);
+    Write32(column);
+    WriteString(fileName);
+    WriteString(message);
+  }
+};
+
+} // end anonymous namespace
+
+/// DecodeDiagnostics - Read the diagnostics that a DiagnosticEncoder wrote
+/// to \p data into \p diagnostics. A truncated or corrupt entry fails.
+static bool
+DecodeDiagnostics(llvm::StringRef data,
+                  std::vector<CompileCache::CachedDiagnostic> &diagnostics) {
+  auto read32 = [&](uint32_t &value) {
+    if (data.size() < sizeof(uint32_t)) {
+      return false;
+    }
+    value = llvm::support::endian::read32le(data.data());
+    data = data.drop_front(sizeof(uint32_t));
+    return true;
+  };
+  auto readString = [&](std::string &str) {
+    uint32_t size;
+    if (!read32(size) || size > data.size()) {
+      return false;
+    }
+    str = data.take_front(size).str();
+    data = data.drop_front(size);
+    return true;
+  };
+
+  while (!data.empty()) {
+    CompileCache::CachedDiagnostic &diagnostic = diagnostics.emplace_back();
+    uint32_t level;
+    if (!read32(level) || level > DiagnosticsEngine::Fatal ||
+        !read32(diagnostic.id) || !read32(diagnostic.line) ||
+        !read32(diagnostic.column) || !readString(diagnostic.fileName) ||
+        !readString(diagnostic.message)) {
+      return false;
+    }
+    diagnostic.level = DiagnosticsEngine::Level(level);
+  }
+  return true;
+}
+
+CompileCache::DiagnosticRecorder::DiagnosticRecorder(DiagnosticsEngine &diags)
+    : diags(diags), prevClient(diags.getClient()),
+      ownedPrevClient(diags.takeClient()) {
+  diags.setClient(
+      new ChainedDiagnosticConsumer(
+          prevClient, std::make_unique<DiagnosticEncoder>(encoded)),
+      /*ShouldOwnClient=*/true);
+}
+
+CompileCache::DiagnosticRecorder::~DiagnosticRecorder() {
+  bool ownsPrevClient = ownedPrevClient != nullptr;
+  diags.setClient(ownsPrevClient ? ownedPrevClient.release() : prevClient,
+                  ownsPrevClient);
+}
+
+CompileCache::CompileCache(llvm::StringRef cachePath, uint64_t maxSizeInBytes,
+                           const CompilerInvocation &invocation)
+    : cachePath(cachePath), maxSizeInBytes(maxSizeInBytes) {
+  // Leave out what names the inputs and outputs and how the cache itself is
+  // run; the same source compiled the same way is a hit wherever it goes.
+  CompilerInvocation keyInvocation(invocation);
+  FrontendOptions &frontendOpts = keyInvocation.getFrontendOpts();
+  frontendOpts.Inputs.clear();
+  frontendOpts.OutputFile.clear();
+  frontendOpts.BatchInputsFile.clear();
+  frontendOpts.BatchOutputFiles.clear();
+  frontendOpts.CompileCachePath.clear();
+  frontendOpts.CompileCacheSize = 0;
+  frontendOpts.TimeTracePath.clear();
+
+  llvm::BLAKE3 hasher;
+  // Relative paths in the invocation and the input names resolve against
+  // the working directory, and the diagnostic IDs that an entry stores are
+  // only meaningful to the compiler that wrote it.
+  llvm::SmallString<128> workingDir(
+      invocation.getFileSystemOpts().WorkingDir);
+  if (workingDir.empty()) {
+    llvm::sys::fs::current_path(workingDir);
+  } else {
+    llvm::sys::fs::make_absolute(workingDir);
+  }
+  HashString(hasher, workingDir);
+  HashString(hasher, getClangFullVersion());
+  keyInvocation.generateCC1CommandLine(
+      [&](const llvm::Twine &arg) { HashString(hasher, arg.str()); });
+  invocationHash = llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string CompileCache::GetEntryPath(llvm::StringRef key) const {
+  llvm::SmallString<128> path(cachePath);
+  llvm::sys::path::append(path, EntryPrefix + key);
+  return std::string(path);
+}
+
+std::string CompileCache::ComputeKey(const FrontendInputFile &input,
+                                     llvm::StringRef contents) const {
+  // The name of the input is part of the key since it ends up in the
+  // output, as the module's source file name and in debug info.
+  llvm::BLAKE3 hasher;
+  HashString(hasher, invocationHash);
+  HashString(hasher, input.getFile());
+  hasher.update(contents);
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::optional<CompileCache::Entry> CompileCache::Lookup(llvm::StringRef key) {
+  std::string entryPath = GetEntryPath(key);
+  // Reading an entry refreshes its access time, which is what Prune evicts
+  // by.
+  llvm::Expected<llvm::sys::fs::file_t> file =
+      llvm::sys::fs::openNativeFileForRead(entryPath,
+                                           llvm::sys::fs::OF_UpdateAtime);
+  if (!file) {
+    llvm::consumeError(file.takeError());
+    ++numMisses;
+    return std::nullopt;
+  }
+  auto buffer = llvm::MemoryBuffer::getOpenFile(
+      *file, entryPath, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  llvm::sys::fs::closeFile(*file);
+  if (!buffer || (*buffer)->getBufferSize() < EntryHeaderSize) {
+    ++numMisses;
+    return std::nullopt;
+  }
+
+  llvm::StringRef data = (*buffer)->getBuffer();
+  uint64_t diagnosticsSize = llvm::support::endian::read64le(data.data());
+  data = data.drop_front(EntryHeaderSize);
+  if (diagnosticsSize > data.size()) {
+    ++numMisses;
+    return std::nullopt;
+  }
+
+  Entry entry;
+  if (!DecodeDiagnostics(data.take_front(diagnosticsSize),
+                         entry.diagnostics)) {
+    ++numMisses;
+    return std::nullopt;
+  }
+  entry.output = data.drop_front(diagnosticsSize);
+  entry.buffer = std::move(*buffer);
+  ++numHits;
+  numBytesReplayed += entry.output.size();
+  return entry;
+}
+
+void CompileCache::Store(llvm::StringRef key, llvm::StringRef output,
+                         llvm::StringRef diagnostics) {
+  if (llvm::sys::fs::create_directories(cachePath)) {
+    return;
+  }
+
+  // Write under a name that Prune leaves alone and that no reader looks
+  // for, and then rename the entry into place in one step.
+  llvm::SmallString<128> tempModel(cachePath);
+  llvm::sys::path::append(tempModel, "tmp-%%%%%%%%%%%%");
+  int fd;
+  llvm::SmallString<128> tempPath;
+  if (llvm::sys::fs::createUniqueFile(tempModel, fd, tempPath)) {
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    char header[EntryHeaderSize];
+    llvm::support::endian::write64le(header, diagnostics.size());
+    os.write(header, EntryHeaderSize);
+    os << diagnostics << output;
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tempPath);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(tempPath, GetEntryPath(key))) {
+    llvm::sys::fs::remove(tempPath);
+    return;
+  }
+  ++numStores;
+}
+
+void CompileCache::Prune() {
+  llvm::CachePruningPolicy policy;
+  policy.Interval = std::chrono::seconds(0);
+  policy.MaxSizeBytes = maxSizeInBytes;
+  llvm::pruneCache(cachePath, policy);
+}
+
+void CompileCache::PrintStats() const {
+  llvm::errs() << "\n*** Compile Cache Stats:\n";
+  llvm::errs() << "  " << numHits << " hits, " << numMisses << " misses, "
+               << numStores << " stores.\n";
+  llvm::errs() << "  " << numBytesReplayed << " bytes replayed.\n";
+}
@@ -0,0 +1,359 @@
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ASTImporter.h"
+#include "clang/AST/ASTImporterSharedState.h"
+#include "clang/Basic/DiagnosticFrontend.h"
+#include "clang/Compile/Compile.h"
+#include "clang/Compile/Parser.h"
+#include "clang/Compile/StoredDiagnosticCollector.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Sema/Scope.h"
+#include "clang/Sema/Sema.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <numeric>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+
+/// FunBodySpan - The bytes of a fun body, from its '{' to just past its
+/// '}', in the file it was captured from.
+struct FunBodySpan final {
+  unsigned beginOffset = 0;
+  unsigned endOffset = 0;
+};
+
+/// One source file of a module, parsed on its own CompilerInstance. The
+/// instance (and with it the file's ASTContext) stays alive until the
+/// declarations have been merged into the module AST.
+///
+/// Only the declarations are parsed per file. A fun body may name what
+/// another file of the module declares, so it is captured by brace balance
+/// and parsed once the declarations of every file have been merged.
+struct ModuleFile final {
+  FrontendInputFile input;
+
+  /// The captured body of each fun that has one, keyed by the fun decl in
+  /// the file's own ASTContext.
+  llvm::DenseMap<const Decl *, FunBodySpan> funBodies;
+
+  /// Diagnostics of this file, stored so that they can be replayed in input
+  /// order once every file has been parsed. Their locations point into the
+  /// file's own SourceManager.
+  std::vector<StoredDiagnostic> diagnostics;
+
+  std::unique_ptr<CompilerInstance> instance;
+  std::unique_ptr<FrontendAction> action;
+  bool inSourceFile = false;
+  bool parsed = false;
+
+  explicit ModuleFile(const FrontendInputFile &input) : input(input) {}
+  ~ModuleFile() {
+    if (inSourceFile) {
+      action->EndSourceFile();
+    }
+  }
+
+  /// Parse the declarations of the file on a private Preprocessor/Parser/
+  /// Sema. Safe to call concurrently for distinct files.
+  void Parse(std::shared_ptr<CompilerInvocation> invocation,
+             std::shared_ptr<PCHContainerOperations> pchOps);
+
+  /// Report the stored diagnostics to \p client, through this file's
+  /// DiagnosticsEngine so that their locations resolve.
+  void ReplayDiagnostics(DiagnosticConsumer &client);
+};
+
+/// Parses the top-level decls of one module file, leaving every fun body
+/// unparsed and recording where it is.
+class ModuleFileParseAction final : public ASTFrontendAction {
+  ModuleFile &file;
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &instance,
+                                                 StringRef inFile) override {
+    return std::make_unique<ASTConsumer>();
+  }
+  void ExecuteAction() override;
+
+public:
+  explicit ModuleFileParseAction(ModuleFile &file) : file(file) {}
+};
+
+/// Merges the declarations of every module file into the module AST, parses
+/// the fun bodies against it, and feeds the result to the ASTConsumer of the
+/// wrapped action, in place of parsing the main file.
+class ModuleMergeAction final : public WrapperFrontendAction {
+  llvm::ArrayRef<std::unique_ptr<ModuleFile>> files;
+
+  /// PendingFunBody - A merged fun decl whose body is still to be parsed
+  /// from \p fileID of the module's SourceManager.
+  struct PendingFunBody final {
+    Decl *funDecl = nullptr;
+    FileID fileID;
+    FunBodySpan span;
+  };
+
+protected:
+  void ExecuteAction() override;
+
+public:
+  ModuleMergeAction(std::unique_ptr<FrontendAction> wrappedAction,
+                    llvm::ArrayRef<std::unique_ptr<ModuleFile>> files)
+      : WrapperFrontendAction(std::move(wrappedAction)), files(files) {}
+};
+
+} // namespace
+
+void ModuleFile::Parse(std::shared_ptr<CompilerInvocation> invocation,
+                       std::shared_ptr<PCHContainerOperations> pchOps) {
+  instance = std::make_unique<CompilerInstance>(std::move(pchOps));
+  instance->setInvocation(std::move(invocation));
+  instance->createDiagnostics(new StoredDiagnosticCollector(diagnostics),
+                              /*ShouldOwnClient=*/true);
+  if (!instance->createTarget()) {
+    return;
+  }
+  action = std::make_unique<ModuleFileParseAction>(*this);
+  if (!action->BeginSourceFile(*instance, input)) {
+    return;
+  }
+  inSourceFile = true;
+  if (llvm::Error err = action->Execute()) {
+    llvm::consumeError(std::move(err));
+    return;
+  }
+  parsed = !instance->getDiagnostics().hasErrorOccurred();
+}
+
+void ModuleFile::ReplayDiagnostics(DiagnosticConsumer &client) {
+  if (diagnostics.empty()) {
+    return;
+  }
+  DiagnosticsEngine &diags = instance->getDiagnostics();
+  // Keep the collector alive: EndSourceFile still talks to it.
+  std::unique_ptr<DiagnosticConsumer> collector = diags.takeClient();
+  diags.setClient(&client, /*ShouldOwnClient=*/false);
+
+  client.BeginSourceFile(instance->getLangOpts(),
+                         instance->hasPreprocessor()
+                             ? &instance->getPreprocessor()
+                             : nullptr);
+  for (const StoredDiagnostic &diagnostic : diagnostics) {
+    diags.Report(diagnostic);
+  }
+  client.EndSourceFile();
+
+  diags.setClient(collector.release(), /*ShouldOwnClient=*/true);
+}
+
+void ModuleFileParseAction::ExecuteAction() {
+  CompilerInstance &instance = getCompilerInstance();
+  if (!instance.hasSema()) {
+    instance.createSema(getTranslationUnitKind(),
+                        /*CompletionConsumer=*/nullptr);
+  }
+  Sema &sema = instance.getSema();
+  const FrontendOptions &frontendOpts = instance.getFrontendOpts();
+
+  ParserOptions parserOpts;
+  parserOpts.skipFunctionBodies = true;
+  parserOpts.preTokenize =
+      frontendOpts.PreTokenize || frontendOpts.PreTokenizeOnThread;
+  parserOpts.preTokenizeOnThread = frontendOpts.PreTokenizeOnThread;
+  parserOpts.recoverMalformedDecls = frontendOpts.RecoverMalformedDecls;
+
+  sema.getPreprocessor().EnterMainSourceFile();
+  SourceManager &sm = instance.getSourceManager();
+  Parser parser(sema, parserOpts);
+  parser.ParseTopLevelDecls([&](ParserResult<Decl> &topLevelDecl) {
+    const LateParsedFunBody *body =
+        parser.GetLateParsedFunBody(topLevelDecl.Get());
+    if (body) {
+      FunBodySpan &span = file.funBodies[topLevelDecl.Get()];
+      span.beginOffset = sm.getFileOffset(body->toks.front().getLocation());
+      span.endOffset = sm.getFileOffset(body->toks.back().getEndLoc());
+    }
+    return true;
+  });
+}
+
+void ModuleMergeAction::ExecuteAction() {
+  CompilerInstance &moduleInstance = getCompilerInstance();
+  ASTContext &moduleContext = moduleInstance.getASTContext();
+  DiagnosticsEngine &diags = moduleInstance.getDiagnostics();
+  ASTConsumer &consumer = moduleInstance.getASTConsumer();
+  if (!moduleInstance.hasSema()) {
+    moduleInstance.createSema(getTranslationUnitKind(),
+                              /*CompletionConsumer=*/nullptr);
+  }
+  Sema &sema = moduleInstance.getSema();
+
+  diags.getClient()->BeginSourceFile(moduleContext.getLangOpts());
+  sema.getPreprocessor().EnterMainSourceFile();
+  Scope tuScope(/*Parent=*/nullptr, Scope::DeclScope, diags);
+  sema.ActOnTranslationUnitScope(&tuScope);
+  sema.Initialize();
+
+  auto sharedState = std::make_shared<ASTImporterSharedState>(
+      *moduleContext.getTranslationUnitDecl());
+
+  // Merge the declarations in input order so that the module AST does not
+  // depend on which thread finished parsing first. Every one of them goes
+  // into the translation-unit scope, where the bodies look names up.
+  llvm::SmallVector<Decl *, 64> mergedDecls;
+  std::vector<PendingFunBody> pendingBodies;
+  for (const auto &file : files) {
+    CompilerInstance &fileInstance = *file->instance;
+    ASTImporter importer(moduleContext, moduleInstance.getFileManager(),
+                         fileInstance.getASTContext(),
+                         fileInstance.getFileManager(),
+                         /*MinimalImport=*/false, sharedState);
+
+    // The bodies are parsed from the FileID that the merged decls point
+    // into, so that a body and its decl share one file.
+    FileID fileID;
+    if (!file->funBodies.empty()) {
+      llvm::Expected<FileID> imported =
+          importer.Import(fileInstance.getSourceManager().getMainFileID());
+      if (!imported) {
+        diags.Report(diag::err_fe_module_merge_failed)
+            << file->input.getFile() << llvm::toString(imported.takeError());
+        continue;
+      }
+      fileID = *imported;
+    }
+
+    auto *fileUnit = fileInstance.getASTContext().getTranslationUnitDecl();
+    for (auto *decl : fileUnit->decls()) {
+      // Builtin typedefs and the like exist in every file.
+      if (decl->isImplicit()) {
+        continue;
+      }
+      llvm::Expected<Decl *> merged = importer.Import(decl);
+      if (!merged) {
+        diags.Report(diag::err_fe_module_merge_failed)
+            << file->input.getFile() << llvm::toString(merged.takeError());
+        continue;
+      }
+      if (auto *namedDecl = dyn_cast<NamedDecl>(*merged)) {
+        sema.PushOnScopeChains(namedDecl, &tuScope, /*AddToContext=*/false);
+      }
+      auto body = file->funBodies.find(decl);
+      if (body != file->funBodies.end()) {
+        pendingBodies.push_back({*merged, fileID, body->second});
+      }
+      mergedDecls.push_back(*merged);
+    }
+  }
+
+  // Semantic analysis of the bodies runs once, against the whole module.
+  const FrontendOptions &frontendOpts = moduleInstance.getFrontendOpts();
+  ParserOptions parserOpts;
+  parserOpts.recoverMalformedDecls = frontendOpts.RecoverMalformedDecls;
+  for (const PendingFunBody &pending : pendingBodies) {
+    Parser parser(sema, parserOpts, pending.fileID, pending.span.beginOffset,
+                  pending.span.endOffset, &tuScope);
+    parser.ParseFunBody(pending.funDecl);
+  }
+
+  for (Decl *merged : mergedDecls) {
+    if (!consumer.HandleTopLevelDecl(DeclGroupRef(merged))) {
+      break;
+    }
+  }
+  if (!diags.hasErrorOccurred()) {
+    consumer.HandleTranslationUnit(moduleContext);
+  }
+
+  sema.CurScope = nullptr;
+  sema.TUScope = nullptr;
+  diags.getClient()->EndSourceFile();
+}
+
+bool clang::CompileModule(CompilerInstance &moduleInstance) {
+  const FrontendOptions &frontendOpts = moduleInstance.getFrontendOpts();
+  if (frontendOpts.Inputs.empty()) {
+    return true;
+  }
+  if (!moduleInstance.createTarget()) {
+    return false;
+  }
+
+  llvm::SmallVector<std::unique_ptr<ModuleFile>, 16> files;
+  for (const FrontendInputFile &input : frontendOpts.Inputs) {
+    files.push_back(std::make_unique<ModuleFile>(input));
+  }
+
+  // Start with the largest files so that a long file does not end up as the
+  // last job while the other threads sit idle.
+  llvm::SmallVector<uint64_t, 16> fileSizes(files.size(), 0);
+  for (unsigned i = 0, e = files.size(); i != e; ++i) {
+    if (files[i]->input.isFile()) {
+      llvm::sys::fs::file_size(files[i]->input.getFile(), fileSizes[i]);
+    }
+  }
+  llvm::SmallVector<unsigned, 16> order(files.size());
+  std::iota(order.begin(), order.end(), 0);
+  llvm::stable_sort(order, [&](unsigned lhs, unsigned rhs) {
+    return fileSizes[lhs] > fileSizes[rhs];
+  });
+
+  {
+    llvm::ThreadPool pool(
+        llvm::hardware_concurrency(frontendOpts.CompileModuleJobs));
+    for (unsigned index : order) {
+      // Each file gets its own copy of the invocation, narrowed to that file.
+      auto invocation =
+          std::make_shared<CompilerInvocation>(moduleInstance.getInvocation());
+      FrontendOptions &fileOpts = invocation->getFrontendOpts();
+      fileOpts.Inputs = {files[index]->input};
+      fileOpts.ProgramAction = frontend::ParseSyntaxOnly;
+      fileOpts.OutputFile.clear();
+      fileOpts.CompileModule = false;
+
+      ModuleFile *file = files[index].get();
+      auto pchOps = moduleInstance.getPCHContainerOperations();
+      pool.async(
+          [file, invocation, pchOps] { file->Parse(invocation, pchOps); });
+    }
+    pool.wait();
+  }
+
+  // Replay in input order, through the module's consumer, so that error
+  // counts and -serialize-diagnostics see every file.
+  DiagnosticConsumer &client = moduleInstance.getDiagnosticClient();
+  bool parsed = true;
+  for (const auto &file : files) {
+    if (file->instance) {
+      file->ReplayDiagnostics(client);
+    }
+    parsed &= file->parsed;
+  }
+  if (!parsed) {
+    return false;
+  }
+
+  // The merged AST is anchored at the first input; its own tokens are never
+  // parsed, every declaration comes from the merge.
+  ModuleMergeAction mergeAction(clang::CreateFrontendAction(moduleInstance),
+                                files);
+  if (!mergeAction.BeginSourceFile(moduleInstance, frontendOpts.Inputs[0])) {
+    return false;
+  }
+  if (llvm::Error err = mergeAction.Execute()) {
+    llvm::consumeError(std::move(err));
+  }
+  mergeAction.EndSourceFile();
+  return !moduleInstance.getDiagnostics().hasErrorOccurred();
+}
@@ -0,0 +1,171 @@
+#include "clang/Compile/DependencyScanner.h"
+#include "clang/Basic/DiagnosticDriver.h"
+#include "clang/Basic/DiagnosticFrontend.h"
+#include "clang/Compile/ImportScanner.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Syntax/ModuleInterface.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+
+using namespace clang;
+
+std::optional<DependencyFormat>
+clang::ParseDependencyFormat(llvm::StringRef name) {
+  return llvm::StringSwitch<std::optional<DependencyFormat>>(name)
+      .Case("make", DependencyFormat::Make)
+      .Case("ninja", DependencyFormat::Ninja)
+      .Case("json", DependencyFormat::JSON)
+      .Default(std::nullopt);
+}
+
+void clang::ScanFileImports(llvm::MutableArrayRef<FileImports> files,
+                            unsigned numThreads) {
+  llvm::ThreadPool pool(llvm::hardware_concurrency(numThreads));
+  for (FileImports &file : files) {
+    pool.async([&file] {
+      auto buffer = llvm::MemoryBuffer::getFile(
+          file.inputFile, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+      if (!buffer) {
+        file.readError = buffer.getError().message();
+        return;
+      }
+      llvm::SmallVector<ScannedImport, 8> imports;
+      file.isWellFormed = ScanImports((*buffer)->getBuffer(), imports);
+      for (const ScannedImport &import : imports) {
+        file.importedModules.push_back(import.moduleName.str());
+      }
+    });
+  }
+  pool.wait();
+}
+
+static std::string GetInterfacePath(llvm::StringRef interfaceDir,
+                                    llvm::StringRef moduleName) {
+  llvm::SmallString<128> path(interfaceDir);
+  llvm::sys::path::append(
+      path, moduleName + "." + syn::module_interface::FileExtension);
+  return std::string(path);
+}
+
+/// Write \p path with the characters that make or ninja treat specially
+/// escaped.
+static void WriteEscapedPath(llvm::raw_ostream &os, llvm::StringRef path,
+                             DependencyFormat format) {
+  for (char c : path) {
+    if (c == '$') {
+      os << "$$";
+    } else if (format == DependencyFormat::Make && (c == ' ' || c == '#')) {
+      os << '\\' << c;
+    } else if (format == DependencyFormat::Ninja && (c == ' ' || c == ':')) {
+      os << '$' << c;
+    } else {
+      os << c;
+    }
+  }
+}
+
+void clang::WriteDependencies(llvm::raw_ostream &os, DependencyFormat format,
+                              llvm::ArrayRef<FileImports> files,
+                              llvm::StringRef interfaceDir) {
+  if (format == DependencyFormat::JSON) {
+    llvm::json::OStream json(os, /*IndentSize=*/2);
+    json.object([&] {
+      json.attribute("version", 1);
+      json.attributeArray("files", [&] {
+        for (const FileImports &file : files) {
+          json.object([&] {
+            json.attribute("input", file.inputFile);
+            json.attribute("output", file.outputFile);
+            json.attributeArray("imports", [&] {
+              for (const std::string &moduleName : file.importedModules) {
+                json.object([&] {
+                  json.attribute("module", moduleName);
+                  json.attribute("interface",
+                                 GetInterfacePath(interfaceDir, moduleName));
+                });
+              }
+            });
+          });
+        }
+      });
+    });
+    os << '\n';
+    return;
+  }
+
+  if (format == DependencyFormat::Ninja) {
+    os << "ninja_dyndep_version = 1\n";
+  }
+  for (const FileImports &file : files) {
+    if (format == DependencyFormat::Ninja) {
+      os << "build ";
+    }
+    WriteEscapedPath(os, file.outputFile, format);
+    os << (format == DependencyFormat::Ninja ? ": dyndep" : ":");
+    if (format == DependencyFormat::Ninja && !file.importedModules.empty()) {
+      os << " |";
+    }
+    for (const std::string &moduleName : file.importedModules) {
+      os << ' ';
+      WriteEscapedPath(os, GetInterfacePath(interfaceDir, moduleName), format);
+    }
+    os << '\n';
+  }
+}
+
+bool clang::ScanDependencies(CompilerInstance &instance) {
+  FrontendOptions &frontendOpts = instance.getFrontendOpts();
+  DiagnosticsEngine &diags = instance.getDiagnostics();
+  std::optional<DependencyFormat> format =
+      ParseDependencyFormat(frontendOpts.ScanImportsFormat);
+  if (!format) {
+    diags.Report(diag::err_drv_invalid_value)
+        << "-scan-imports-format=" << frontendOpts.ScanImportsFormat;
+    return false;
+  }
+
+  std::vector<FileImports> files(frontendOpts.Inputs.size());
+  for (unsigned i = 0, e = files.size(); i != e; ++i) {
+    files[i].inputFile = frontendOpts.Inputs[i].getFile().str();
+    if (i < frontendOpts.BatchOutputFiles.size() &&
+        !frontendOpts.BatchOutputFiles[i].empty()) {
+      files[i].outputFile = frontendOpts.BatchOutputFiles[i];
+      continue;
+    }
+    llvm::SmallString<128> outputFile(files[i].inputFile);
+    llvm::sys::path::replace_extension(outputFile, "o");
+    files[i].outputFile = std::string(outputFile);
+  }
+  ScanFileImports(files);
+
+  bool success = true;
+  unsigned malformedPreamble = diags.getCustomDiagID(
+      DiagnosticsEngine::Warning,
+      "malformed import decl in '%0'; the imports after it are not listed");
+  for (const FileImports &file : files) {
+    if (!file.readError.empty()) {
+      diags.Report(diag::err_fe_error_reading)
+          << file.inputFile << file.readError;
+      success = false;
+    } else if (!file.isWellFormed) {
+      diags.Report(malformedPreamble) << file.inputFile;
+    }
+  }
+
+  llvm::StringRef outputPath =
+      frontendOpts.OutputFile.empty() ? "-" : frontendOpts.OutputFile;
+  auto output = instance.createOutputFile(
+      outputPath, /*Binary=*/false, /*RemoveFileOnSignal=*/true,
+      frontendOpts.UseTemporary);
+  if (!output) {
+    return false;
+  }
+  WriteDependencies(*output, *format, files, frontendOpts.ModuleInterfaceDir);
+  instance.clearOutputFiles(/*EraseFiles=*/!success);
+  return success;
+}
@@ -0,0 +1,133 @@
+#include "clang/Compile/ImportScanner.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+using namespace clang;
+
+namespace {
+
+/// PreambleScanner - The tokenizer behind ScanImports.
+class PreambleScanner final {
+  llvm::StringRef source;
+  size_t pos = 0;
+
+public:
+  explicit PreambleScanner(llvm::StringRef source) : source(source) {}
+
+  size_t GetPos() const { return pos; }
+
+  /// Skip whitespace and comments. An unterminated block comment runs to
+  /// the end of the source.
+  void SkipTrivia() {
+    while (pos < source.size()) {
+      char c = source[pos];
+      if (llvm::isSpace(c)) {
+        ++pos;
+      } else if (source.substr(pos).starts_with("//")) {
+        pos = source.find('\n', pos);
+      } else if (source.substr(pos).starts_with("/*")) {
+        pos = source.find("*/", pos + 2);
+        pos = pos == llvm::StringRef::npos ? pos : pos + 2;
+      } else {
+        return;
+      }
+    }
+  }
+
+  /// Consume an identifier, or return "" if there is none here.
+  llvm::StringRef LexIdentifier() {
+    SkipTrivia();
+    size_t begin = pos;
+    if (pos < source.size() &&
+        (llvm::isAlpha(source[pos]) || source[pos] == '_')) {
+      ++pos;
+      while (pos < source.size() &&
+             (llvm::isAlnum(source[pos]) || source[pos] == '_')) {
+        ++pos;
+      }
+    }
+    return source.slice(begin, pos);
+  }
+
+  /// Consume \p c if it is the next token.
+  bool TryConsume(char c) {
+    SkipTrivia();
+    if (pos < source.size() && source[pos] == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  /// Consume a dotted name up to and including its ';', returning the name,
+  /// or "" if there is no well-formed one.
+  llvm::StringRef LexModuleNameAndSemi() {
+    SkipTrivia();
+    size_t begin = pos;
+    size_t end = pos;
+    do {
+      if (LexIdentifier().empty()) {
+        return "";
+      }
+      end = pos;
+    } while (TryConsume('.'));
+    if (!TryConsume(';')) {
+      return "";
+    }
+    return source.slice(begin, end);
+  }
+
+  /// Lookahead: the identifier at the current position, without
+  /// consuming it.
+  llvm::StringRef PeekIdentifier() {
+    size_t saved = pos;
+    llvm::StringRef identifier = LexIdentifier();
+    pos = saved;
+    return identifier;
+  }
+};
+
+} // namespace
+
+bool clang::ScanImports(llvm::StringRef source,
+                        llvm::SmallVectorImpl<ScannedImport> &imports) {
+  PreambleScanner scanner(source);
+  while (true) {
+    scanner.SkipTrivia();
+    unsigned offset = scanner.GetPos();
+    llvm::StringRef keyword = scanner.PeekIdentifier();
+    if (keyword == "module") {
+      scanner.LexIdentifier();
+      if (scanner.LexModuleNameAndSemi().empty()) {
+        return false;
+      }
+      continue;
+    }
+
+    bool isExported = false;
+    if (keyword == "export") {
+      scanner.LexIdentifier();
+      if (scanner.PeekIdentifier() != "import") {
+        // 'export' of something other than an import ends the preamble.
+        return true;
+      }
+      isExported = true;
+      scanner.SkipTrivia();
+      offset = scanner.GetPos();
+      keyword = "import";
+    }
+    if (keyword != "import") {
+      return true;
+    }
+
+    scanner.LexIdentifier();
+    llvm::StringRef moduleName = scanner.LexModuleNameAndSemi();
+    if (moduleName.empty()) {
+      return false;
+    }
+    ScannedImport &scanned = imports.emplace_back();
+    scanned.moduleName = moduleName;
+    scanned.offset = offset;
+    scanned.isExported = isExported;
+  }
+}
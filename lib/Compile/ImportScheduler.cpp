@@ -0,0 +1,204 @@
+#include "clang/Compile/ImportScheduler.h"
+#include "clang/Compile/ImportScanner.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+ImportScheduler::ImportScheduler(ModuleSourceLocator locateSource,
+                                 ModuleLoader loadModule, unsigned numThreads)
+    : locateSource(std::move(locateSource)), loadModule(std::move(loadModule)),
+      pool(llvm::hardware_concurrency(numThreads)) {}
+
+ImportScheduler::~ImportScheduler() {
+  // The loads still running point at the nodes.
+  pool.wait();
+}
+
+void ImportScheduler::Import(llvm::StringRef name) {
+  if (nodes.count(name)) {
+    ++numImportsDeduped;
+    return;
+  }
+  auto &slot = nodes[name];
+  slot = std::make_unique<ModuleNode>();
+  slot->name = name.str();
+  // Until discovery is done, each new node holds one extra pending import
+  // so that a finished load elsewhere cannot start it early.
+  slot->numPendingImports = 1;
+  std::vector<ModuleNode *> newNodes = Discover(slot.get());
+  BreakCycles(newNodes);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (ModuleNode *node : newNodes) {
+    if (--node->numPendingImports == 0) {
+      ScheduleLoad(node);
+    }
+  }
+}
+
+std::vector<ImportScheduler::ModuleNode *>
+ImportScheduler::Discover(ModuleNode *root) {
+  std::vector<ModuleNode *> newNodes = {root};
+  std::vector<ModuleNode *> level = {root};
+  while (!level.empty()) {
+    // Pre-scan the sources of this level in parallel.
+    std::vector<std::vector<std::string>> importsOf(level.size());
+    std::vector<std::shared_future<void>> scans;
+    for (unsigned i = 0, e = level.size(); i != e; ++i) {
+      scans.push_back(pool.async([this, &level, &importsOf, i] {
+        std::string path = locateSource(level[i]->name);
+        if (path.empty()) {
+          return;
+        }
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) {
+          return;
+        }
+        llvm::SmallVector<ScannedImport, 8> scanned;
+        ScanImports((*buffer)->getBuffer(), scanned);
+        for (const ScannedImport &import : scanned) {
+          importsOf[i].push_back(import.moduleName.str());
+        }
+      }));
+    }
+    for (auto &scan : scans) {
+      scan.wait();
+    }
+    numModulesScanned += level.size();
+
+    std::vector<ModuleNode *> nextLevel;
+    for (unsigned i = 0, e = level.size(); i != e; ++i) {
+      ModuleNode *importer = level[i];
+      for (const std::string &name : importsOf[i]) {
+        auto &slot = nodes[name];
+        if (!slot) {
+          slot = std::make_unique<ModuleNode>();
+          slot->name = name;
+          slot->numPendingImports = 1;
+          newNodes.push_back(slot.get());
+          nextLevel.push_back(slot.get());
+        } else {
+          ++numImportsDeduped;
+        }
+        ModuleNode *imported = slot.get();
+        if (llvm::is_contained(importer->imports, imported)) {
+          continue;
+        }
+        importer->imports.push_back(imported);
+
+        // A module loaded by an earlier Import is not waited for.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!imported->isLoaded) {
+          imported->importers.push_back(importer);
+          ++importer->numPendingImports;
+        }
+      }
+    }
+    level = std::move(nextLevel);
+  }
+  return newNodes;
+}
+
+void ImportScheduler::BreakCycles(llvm::ArrayRef<ModuleNode *> newNodes) {
+  // The modules known before this Import form no cycle and import none of
+  // the new ones, so only the new ones need a look.
+  llvm::SmallPtrSet<ModuleNode *, 16> isNew(newNodes.begin(), newNodes.end());
+  llvm::SmallPtrSet<ModuleNode *, 16> visited;
+  llvm::SmallPtrSet<ModuleNode *, 16> onStack;
+
+  // A new node may already import a module that is loading, whose Load
+  // decrements the node's numPendingImports on a pool thread.
+  std::lock_guard<std::mutex> lock(mutex);
+  std::function<void(ModuleNode *)> visit = [&](ModuleNode *node) {
+    visited.insert(node);
+    onStack.insert(node);
+    for (unsigned i = 0; i != node->imports.size();) {
+      ModuleNode *imported = node->imports[i];
+      if (!isNew.count(imported)) {
+        ++i;
+        continue;
+      }
+      if (onStack.count(imported)) {
+        // Drop the edge that closes the cycle; the importer fails.
+        node->imports.erase(node->imports.begin() + i);
+        llvm::erase(imported->importers, node);
+        --node->numPendingImports;
+        node->error = "import cycle through module '" + imported->name + "'";
+        continue;
+      }
+      if (!visited.count(imported)) {
+        visit(imported);
+      }
+      ++i;
+    }
+    onStack.erase(node);
+  };
+  for (ModuleNode *node : newNodes) {
+    if (!visited.count(node)) {
+      visit(node);
+    }
+  }
+}
+
+void ImportScheduler::ScheduleLoad(ModuleNode *node) {
+  pool.async([this, node] { Load(node); });
+}
+
+void ImportScheduler::Load(ModuleNode *node) {
+  std::string error = node->error;
+  for (ModuleNode *imported : node->imports) {
+    if (error.empty() && !imported->error.empty()) {
+      error = "imported module '" + imported->name + "' failed to load";
+    }
+  }
+  if (error.empty()) {
+    auto reader = loadModule(node->name);
+    if (reader) {
+      node->reader = std::move(*reader);
+    } else {
+      error = llvm::toString(reader.takeError());
+    }
+  }
+  node->error = std::move(error);
+
+  std::vector<ModuleNode *> unblocked;
+  {
+    // Discover reads isLoaded under the same lock, so an importer either
+    // is in importers now or does not wait for this load.
+    std::lock_guard<std::mutex> lock(mutex);
+    ++numModulesLoaded;
+    node->isLoaded = true;
+    for (ModuleNode *importer : node->importers) {
+      if (--importer->numPendingImports == 0) {
+        unblocked.push_back(importer);
+      }
+    }
+  }
+  node->loaded.set_value();
+  for (ModuleNode *importer : unblocked) {
+    ScheduleLoad(importer);
+  }
+}
+
+const syn::ModuleInterfaceReader *
+ImportScheduler::Wait(llvm::StringRef name, std::string *error) {
+  auto it = nodes.find(name);
+  assert(it != nodes.end() && "module was never imported");
+  ModuleNode *node = it->second.get();
+  node->ready.wait();
+  if (!node->reader && error) {
+    *error = node->error;
+  }
+  return node->reader.get();
+}
+
+void ImportScheduler::PrintStats() const {
+  llvm::errs() << "\n*** Import Scheduler Stats:\n";
+  llvm::errs() << "  " << nodes.size() << " modules, " << numModulesScanned
+               << " pre-scanned, " << numModulesLoaded << " loaded.\n";
+  llvm::errs() << "  " << numImportsDeduped << " imports deduplicated.\n";
+}
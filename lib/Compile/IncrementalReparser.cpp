@@ -0,0 +1,311 @@
+#include "clang/Compile/IncrementalReparser.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Compile/StoredDiagnosticCollector.h"
+#include "clang/Sema/Scope.h"
+#include "clang/Sema/Sema.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+using namespace clang;
+
+IncrementalReparser::IncrementalReparser(Sema &sema, const ParserOptions &opts)
+    : sema(sema), parserOpts(opts) {
+  parserOpts.recordTopLevelDeclSpans = true;
+  // Regions are short and each is lexed once; a token buffer buys nothing.
+  parserOpts.preTokenize = false;
+  parserOpts.preTokenizeOnThread = false;
+}
+
+IncrementalReparser::~IncrementalReparser() {
+  if (sema.TUScope == tuScope.get()) {
+    sema.TUScope = nullptr;
+  }
+  if (sema.CurScope == tuScope.get()) {
+    sema.CurScope = nullptr;
+  }
+}
+
+void IncrementalReparser::ParseRegion(unsigned beginOffset, unsigned endOffset,
+                                      std::vector<ParsedSpan> &newSpans) {
+  // Each region parses as though it were the whole file, so that errors
+  // elsewhere do not stop it; ReportDiagnostics counts them all afterwards.
+  DiagnosticsEngine &diags = sema.getDiagnostics();
+  diags.Reset(/*soft=*/true);
+
+  // Hold the diagnostics of the region back to keep them with their decls.
+  std::vector<StoredDiagnostic> pending;
+  StoredDiagnosticCollector collector(pending);
+  DiagnosticConsumer *client = diags.getClient();
+  std::unique_ptr<DiagnosticConsumer> ownedClient = diags.takeClient();
+  diags.setClient(&collector, /*ShouldOwnClient=*/false);
+
+  size_t firstNew = newSpans.size();
+  {
+    Parser parser(sema, parserOpts, fileID, beginOffset, endOffset,
+                  tuScope.get());
+
+    // The parser goes away with the region, so a fun body is parsed now or
+    // not at all.
+    bool parseFunBodies = !parser.GetParserOptions().skipFunctionBodies;
+    parser.ParseTopLevelDecls([&](ParserResult<Decl> &topLevelDecl) {
+      if (parseFunBodies) {
+        parser.ParseLateParsedFunBody(topLevelDecl.Get());
+      }
+      ParsedSpan &parsed = newSpans.emplace_back();
+      parsed.span = parser.GetTopLevelDeclSpans().back();
+      parsed.generation = generation;
+      parsed.diagnostics = std::move(pending);
+      pending.clear();
+      return true;
+    });
+  }
+
+  // What was reported after the last decl stays with the text after it.
+  if (!pending.empty()) {
+    unsigned tailBegin = newSpans.size() != firstNew
+                             ? newSpans.back().span.endOffset
+                             : beginOffset;
+    ParsedSpan &tail = newSpans.emplace_back();
+    tail.span.beginOffset = tailBegin;
+    tail.span.endOffset = endOffset;
+    tail.generation = generation;
+    tail.diagnostics = std::move(pending);
+  }
+
+  if (ownedClient) {
+    diags.setClient(ownedClient.release(), /*ShouldOwnClient=*/true);
+  } else {
+    diags.setClient(client, /*ShouldOwnClient=*/false);
+  }
+  numBytesParsed += endOffset - beginOffset;
+}
+
+void IncrementalReparser::RemoveDecl(Decl *decl) {
+  TranslationUnitDecl *tu = sema.getASTContext().getTranslationUnitDecl();
+  if (!tu->containsDecl(decl)) {
+    return;
+  }
+  tu->removeDecl(decl);
+
+  // Sema::PushOnScopeChains put it in both.
+  auto *namedDecl = dyn_cast<NamedDecl>(decl);
+  if (namedDecl && tuScope->isDeclScope(namedDecl)) {
+    tuScope->RemoveDecl(namedDecl);
+    sema.IdResolver.RemoveDecl(namedDecl);
+  }
+}
+
+void IncrementalReparser::WriteGeneration(unsigned gen) {
+  SourceManager &sm = sema.getSourceManager();
+  llvm::StringRef documentName =
+      sm.getBufferOrFake(sm.getMainFileID()).getBufferIdentifier();
+  Generation &buffer = generations[gen];
+
+  bool needsFileID = !buffer.file || text.size() > buffer.capacity;
+  std::string bufferName;
+  if (needsFileID) {
+    // Leave room to grow, so that one FileID serves many edits.
+    constexpr unsigned MinCapacity = 4096;
+    buffer.capacity = std::max<unsigned>(2 * text.size(), MinCapacity);
+    bufferName = (documentName + ".edit" + llvm::Twine(numFileIDs)).str();
+    buffer.file = sm.getFileManager().getVirtualFileRef(
+        bufferName, buffer.capacity, /*ModificationTime=*/0);
+  } else {
+    bufferName = buffer.file->getName().str();
+  }
+
+  // The text padded with spaces to the size of the FileID. Regions never
+  // reach past the text, so the padding is not lexed.
+  std::unique_ptr<llvm::WritableMemoryBuffer> contents =
+      llvm::WritableMemoryBuffer::getNewUninitMemBuffer(buffer.capacity,
+                                                        bufferName);
+  char *end = std::copy(text.begin(), text.end(), contents->getBufferStart());
+  std::fill(end, contents->getBufferEnd(), ' ');
+  sm.overrideFileContents(*buffer.file, std::move(contents));
+
+  if (needsFileID) {
+    buffer.fileID =
+        sm.createFileID(*buffer.file, SourceLocation(), SrcMgr::C_User);
+    // Diagnostics name the document rather than the buffer.
+    sm.AddLineNote(sm.getLocForStartOfFile(buffer.fileID), 1,
+                   sm.getLineTableFilenameID(documentName),
+                   /*IsFileEntry=*/false, /*IsFileExit=*/false,
+                   SrcMgr::C_User);
+    ++numFileIDs;
+  }
+  fileID = buffer.fileID;
+  generation = gen;
+}
+
+void IncrementalReparser::ReportDiagnostics() {
+  DiagnosticsEngine &diags = sema.getDiagnostics();
+  diags.Reset(/*soft=*/true);
+  for (const ParsedSpan &parsed : spans) {
+    for (const StoredDiagnostic &stored : parsed.diagnostics) {
+      diags.Report(stored, /*countErrors=*/true);
+    }
+  }
+}
+
+void IncrementalReparser::Parse() {
+  assert(!tuScope && "the document is already parsed");
+  SourceManager &sm = sema.getSourceManager();
+  sema.getPreprocessor().EnterMainSourceFile();
+  fileID = sm.getMainFileID();
+  generation = MainFileGeneration;
+  text = sm.getBufferData(fileID).str();
+
+  tuScope = std::make_unique<Scope>(nullptr, Scope::DeclScope,
+                                    sema.getDiagnostics());
+  sema.ActOnTranslationUnitScope(tuScope.get());
+  sema.Initialize();
+
+  spans.clear();
+  ParseRegion(0, text.size(), spans);
+  ReportDiagnostics();
+}
+
+void IncrementalReparser::Reparse(const TextEdit &edit,
+                                  llvm::SmallVectorImpl<Decl *> &newDecls) {
+  assert(tuScope && "Parse the document first");
+  assert(edit.offset + edit.removedLength <= text.size() &&
+         "edit past the end of the document");
+  unsigned editBegin = edit.offset;
+  unsigned editEnd = edit.offset + edit.removedLength;
+
+  // The spans that touch the edit are [lo, hi). An edit right at the
+  // boundary of two decls dirties both.
+  size_t lo = llvm::partition_point(spans, [&](const ParsedSpan &parsed) {
+                return parsed.span.endOffset < editBegin;
+              }) -
+              spans.begin();
+  size_t hi = std::partition_point(spans.begin() + lo, spans.end(),
+                                   [&](const ParsedSpan &parsed) {
+                                     return parsed.span.beginOffset <=
+                                            editEnd;
+                                   }) -
+              spans.begin();
+
+  // The new text goes into the next buffer in turn. Whatever was parsed
+  // from that buffer before is dirty as well, since its text is about to be
+  // overwritten.
+  unsigned gen = numReparses % NumGenerations;
+
+  // The dirty spans as runs [first, last). The edit is a run even when it
+  // touches no span, since new text between decls may hold new decls.
+  llvm::SmallVector<std::pair<size_t, size_t>, 4> runs;
+  for (size_t i = 0, e = spans.size(); i != e; ++i) {
+    if (spans[i].generation != gen) {
+      continue;
+    }
+    if (!runs.empty() && runs.back().second == i) {
+      runs.back().second = i + 1;
+    } else {
+      runs.emplace_back(i, i + 1);
+    }
+  }
+  runs.emplace_back(lo, hi);
+  llvm::sort(runs);
+  llvm::SmallVector<std::pair<size_t, size_t>, 4> dirty;
+  for (const std::pair<size_t, size_t> &run : runs) {
+    if (!dirty.empty() && run.first <= dirty.back().second) {
+      dirty.back().second = std::max(dirty.back().second, run.second);
+    } else {
+      dirty.push_back(run);
+    }
+  }
+
+  for (const std::pair<size_t, size_t> &run : dirty) {
+    for (size_t i = run.first; i != run.second; ++i) {
+      if (Decl *decl = spans[i].span.decl) {
+        RemoveDecl(decl);
+      }
+    }
+  }
+
+  text.replace(editBegin, edit.removedLength, edit.newText.data(),
+               edit.newText.size());
+  int delta = int(edit.newText.size()) - int(edit.removedLength);
+  // Every clean span ends before the edit or begins after it.
+  auto shift = [&](unsigned offset) {
+    return offset > editEnd ? offset + delta : offset;
+  };
+  WriteGeneration(gen);
+
+  TranslationUnitDecl *tu = sema.getASTContext().getTranslationUnitDecl();
+  std::vector<ParsedSpan> newSpans;
+  size_t next = 0;
+  auto reuse = [&](size_t end) {
+    for (; next != end; ++next) {
+      ParsedSpan &parsed = newSpans.emplace_back(std::move(spans[next]));
+      parsed.span.beginOffset = shift(parsed.span.beginOffset);
+      parsed.span.endOffset = shift(parsed.span.endOffset);
+      numDeclsReused += parsed.span.decl != nullptr;
+    }
+  };
+  for (const std::pair<size_t, size_t> &run : dirty) {
+    reuse(run.first);
+
+    // Reparse from the end of the clean span before the run to the start
+    // of the clean span after it. Both fall between tokens, and any
+    // comments or unparsed text in between are taken along.
+    unsigned regionBegin =
+        run.first == 0 ? 0 : shift(spans[run.first - 1].span.endOffset);
+    unsigned regionEnd = run.second == spans.size()
+                             ? text.size()
+                             : shift(spans[run.second].span.beginOffset);
+    size_t firstNew = newSpans.size();
+    ParseRegion(regionBegin, regionEnd, newSpans);
+    next = run.second;
+
+    // Sema added the new decls at the end of the translation unit; move
+    // them to where their text is, after the last decl before the run.
+    Decl *firstDecl = nullptr;
+    for (size_t i = firstNew, e = newSpans.size(); i != e; ++i) {
+      if (Decl *decl = newSpans[i].span.decl) {
+        firstDecl = firstDecl ? firstDecl : decl;
+        newDecls.push_back(decl);
+        ++numDeclsReparsed;
+      }
+    }
+    if (firstDecl) {
+      Decl *prevDecl = nullptr;
+      for (size_t i = firstNew; i != 0 && !prevDecl; --i) {
+        prevDecl = newSpans[i - 1].span.decl;
+      }
+      tu->moveTrailingDeclsAfter(firstDecl, prevDecl);
+    }
+  }
+  reuse(spans.size());
+
+  spans = std::move(newSpans);
+  ReportDiagnostics();
+  ++numReparses;
+}
+
+void IncrementalReparser::GetTopLevelDeclSpans(
+    llvm::SmallVectorImpl<TopLevelDeclSpan> &result) const {
+  for (const ParsedSpan &parsed : spans) {
+    if (parsed.span.decl) {
+      result.push_back(parsed.span);
+    }
+  }
+}
+
+void IncrementalReparser::PrintStats() const {
+  llvm::errs() << "\n*** Incremental Reparser Stats:\n";
+  llvm::errs() << "  " << numReparses << " reparses, " << numDeclsReparsed
+               << " decls reparsed, " << numDeclsReused
+               << " decls reused.\n";
+  llvm::errs() << "  " << numBytesParsed << " bytes parsed in "
+               << numFileIDs << " edit buffers.\n";
+}
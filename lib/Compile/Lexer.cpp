@@ -1,6 +1,665 @@
 #include "clang/Compile/Lexer.h"
+#include "clang/Basic/CharInfo.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 
 using namespace clang;
 
-Lexer::Lexer(const FileID bufferID, SourceManager &sm)
-    : bufferID(bufferID), sm(sm) {}
\ No newline at end of file
+namespace {
+
+struct LexerKeyword final {
+  llvm::StringLiteral spelling;
+  tok::TokenKind kind;
+};
+
+constexpr LexerKeyword lexerKeywords[] = {
+#define LEXER_KEYWORD(X) {llvm::StringLiteral(#X), tok::kw_##X},
+#include "clang/Compile/LexerKeywords.def"
+};
+
+constexpr unsigned NumLexerKeywords = std::size(lexerKeywords);
+
+/// The keywords, bucketed by length. A word is compared only against the
+/// few keywords of its own length, and most of those are rejected on the
+/// first character.
+class LexerKeywordTable final {
+  static constexpr unsigned MaxKeywordLength = 15;
+  llvm::SmallVector<uint8_t, 8> keywordsByLength[MaxKeywordLength + 1];
+
+public:
+  LexerKeywordTable() {
+    static_assert(NumLexerKeywords <= UINT8_MAX, "keyword index overflow");
+    for (unsigned i = 0; i != NumLexerKeywords; ++i) {
+      size_t length = lexerKeywords[i].spelling.size();
+      assert(length <= MaxKeywordLength && "keyword too long for the table");
+      keywordsByLength[length].push_back(i);
+    }
+  }
+
+  /// Find - Return the index of \p spelling in lexerKeywords, or -1.
+  int Find(llvm::StringRef spelling) const {
+    if (spelling.size() > MaxKeywordLength) {
+      return -1;
+    }
+    for (uint8_t index : keywordsByLength[spelling.size()]) {
+      llvm::StringRef keyword = lexerKeywords[index].spelling;
+      if (keyword[0] == spelling[0] && keyword == spelling) {
+        return index;
+      }
+    }
+    return -1;
+  }
+};
+
+const LexerKeywordTable &GetLexerKeywordTable() {
+  static const LexerKeywordTable table;
+  return table;
+}
+
+} // namespace
+
+lex::Lexer::Lexer(const FileID bufferID, SourceManager &sm,
+                  IdentifierTable &identifiers, DiagnosticsEngine &diags)
+    : bufferID(bufferID), sm(sm), identifiers(identifiers), diags(diags),
+      keywordIdentifiers(NumLexerKeywords, nullptr) {
+
+  llvm::MemoryBufferRef buffer = sm.getBufferOrFake(bufferID);
+  bufferStart = buffer.getBufferStart();
+  bufferEnd = buffer.getBufferEnd();
+  lexEnd = bufferEnd;
+  assert(*bufferEnd == '\0' && "expected a null terminated buffer");
+
+  fileLoc = sm.getLocForStartOfFile(bufferID);
+
+  // Skip a UTF-8 byte order mark.
+  bufferPtr = bufferStart;
+  if (buffer.getBuffer().starts_with("\xEF\xBB\xBF")) {
+    bufferPtr += 3;
+  }
+}
+
+lex::Lexer::~Lexer() {
+  if (lexThread.joinable()) {
+    lexThread.join();
+  }
+}
+
+void lex::Lexer::SetLexRange(unsigned beginOffset, unsigned endOffset) {
+  assert(numTokens == 0 && !IsPreTokenized() && "lexing has already begun");
+  assert(beginOffset <= endOffset &&
+         endOffset <= unsigned(bufferEnd - bufferStart) && "invalid range");
+  bufferPtr = std::max(bufferPtr, bufferStart + beginOffset);
+  lexEnd = bufferStart + endOffset;
+}
+
+tok::TokenKind lex::Lexer::GetKeywordKind(llvm::StringRef spelling) {
+  if (spelling.empty()) {
+    return tok::identifier;
+  }
+  int keyword = GetLexerKeywordTable().Find(spelling);
+  return keyword < 0 ? tok::identifier : lexerKeywords[keyword].kind;
+}
+
+void lex::Lexer::Lex(Token &result) {
+  if (pendingPos == pendingTokens.size()) {
+    if (!tokenBuffer) {
+      LexFromBuffer(result);
+      return;
+    }
+    // Stay on the eof token once it is reached.
+    FormBufferedToken(result, tokenIndex);
+    if (result.isNot(tok::eof)) {
+      ++tokenIndex;
+    } else if (lexThread.joinable()) {
+      lexThread.join();
+    }
+    return;
+  }
+  result = pendingTokens[pendingPos++];
+  if (pendingPos == pendingTokens.size()) {
+    pendingTokens.clear();
+    pendingPos = 0;
+  }
+}
+
+Token lex::Lexer::LookAhead(unsigned n) {
+  unsigned numPending = pendingTokens.size() - pendingPos;
+  if (tokenBuffer && n >= numPending) {
+    Token result;
+    FormBufferedToken(result, tokenIndex + (n - numPending));
+    return result;
+  }
+  while (pendingTokens.size() - pendingPos <= n) {
+    LexFromBuffer(pendingTokens.emplace_back());
+  }
+  return pendingTokens[pendingPos + n];
+}
+
+void lex::Lexer::EnterToken(const Token &tok) {
+  if (pendingPos != 0) {
+    pendingTokens[--pendingPos] = tok;
+    return;
+  }
+  pendingTokens.insert(pendingTokens.begin(), tok);
+}
+
+void lex::Lexer::EnterTokenStream(llvm::ArrayRef<Token> toks) {
+  pendingTokens.insert(pendingTokens.begin() + pendingPos, toks.begin(),
+                       toks.end());
+}
+
+void lex::Lexer::Seek(unsigned offset) {
+  pendingTokens.clear();
+  pendingPos = 0;
+  if (tokenBuffer) {
+    tokenIndex = tokenBuffer->FindFirstTokenAt(offset);
+    return;
+  }
+  bufferPtr = offset < unsigned(lexEnd - bufferStart) ? bufferStart + offset
+                                                      : lexEnd;
+}
+
+void lex::Lexer::ComputeTopLevelTokenOffsets(
+    llvm::ArrayRef<tok::TokenKind> kinds, std::vector<unsigned> &offsets) {
+  unsigned depth = 0;
+  auto visit = [&](tok::TokenKind kind, unsigned offset) {
+    if (kind == tok::l_brace) {
+      ++depth;
+    } else if (kind == tok::r_brace) {
+      depth -= depth != 0;
+    } else if (depth == 0 && llvm::is_contained(kinds, kind)) {
+      offsets.push_back(offset);
+    }
+  };
+
+  if (tokenBuffer) {
+    for (unsigned index = 0; tokenBuffer->WaitFor(index); ++index) {
+      visit(tokenBuffer->GetKind(index), tokenBuffer->GetOffset(index));
+    }
+    return;
+  }
+
+  // Lex the file again with diagnostics suppressed; this lexer reports the
+  // errors in it when it gets there.
+  bool suppressAll = diags.getSuppressAllDiagnostics();
+  diags.setSuppressAllDiagnostics(true);
+  Lexer scanner(bufferID, sm, identifiers, diags);
+  scanner.lexEnd = lexEnd;
+  Token tok;
+  do {
+    scanner.LexFromBuffer(tok);
+    visit(tok.getKind(), (scanner.bufferPtr - bufferStart) - tok.getLength());
+  } while (tok.isNot(tok::eof));
+  diags.setSuppressAllDiagnostics(suppressAll);
+}
+
+void lex::Lexer::PreTokenize(bool onThread) {
+  assert(!tokenBuffer && numTokens == 0 && "the file is already being lexed");
+  assert(lexEnd == bufferEnd && "cannot pre-tokenize a lex range");
+  tokenBuffer = std::make_unique<TokenBuffer>(bufferEnd - bufferStart);
+  if (onThread) {
+    lexThread = std::thread([this] { LexIntoTokenBuffer(); });
+    return;
+  }
+  LexIntoTokenBuffer();
+}
+
+void lex::Lexer::LexIntoTokenBuffer() {
+  // Publishing in batches keeps a waiting parser from being woken for every
+  // token.
+  constexpr unsigned PublishInterval = 256;
+
+  Token tok;
+  do {
+    LexFromBuffer(tok);
+    uint32_t length = tok.getLength();
+    uint32_t offset = (bufferPtr - bufferStart) - length;
+    tokenBuffer->Append(tok.getKind(), tok.getFlags(), offset, length);
+    if (tokenBuffer->GetNumTokens() % PublishInterval == 0) {
+      tokenBuffer->Publish();
+    }
+  } while (tok.isNot(tok::eof));
+  tokenBuffer->Finish();
+}
+
+void lex::Lexer::FormBufferedToken(Token &result, unsigned index) {
+  if (!tokenBuffer->WaitFor(index)) {
+    // Past the end; the last token is the eof.
+    index = tokenBuffer->GetNumPublished() - 1;
+  }
+
+  if (tokenBuffer->GetNumDeferredDiags() != numReportedDiags) {
+    llvm::SmallVector<TokenBuffer::DeferredDiag, 4> ready;
+    tokenBuffer->GetDeferredDiags(numReportedDiags, index, ready);
+    for (const TokenBuffer::DeferredDiag &diag : ready) {
+      DiagnosticBuilder builder = diags.Report(diag.loc, diag.diagID);
+      if (diag.arg >= 0) {
+        builder << diag.arg;
+      }
+    }
+    numReportedDiags += ready.size();
+  }
+
+  tok::TokenKind kind = tokenBuffer->GetKind(index);
+  uint32_t offset = tokenBuffer->GetOffset(index);
+  result.startToken();
+  result.setKind(kind);
+  result.setFlag(static_cast<Token::TokenFlags>(tokenBuffer->GetFlags(index)));
+  result.setLocation(fileLoc.getLocWithOffset(offset));
+  result.setLength(tokenBuffer->GetLength(index));
+
+  if (tok::isLiteral(kind)) {
+    result.setLiteralData(bufferStart + offset);
+    return;
+  }
+  // Identifiers are resolved here, on the parser's thread, because the
+  // IdentifierTable is not safe to share with the worker.
+  if (kind == tok::identifier) {
+    result.setIdentifierInfo(&identifiers.get(
+        llvm::StringRef(bufferStart + offset, result.getLength())));
+  } else if (tok::getKeywordSpelling(kind)) {
+    result.setIdentifierInfo(GetKeywordIdentifierInfo(
+        GetLexerKeywordTable().Find(tok::getKeywordSpelling(kind))));
+  }
+}
+
+IdentifierInfo *lex::Lexer::GetKeywordIdentifierInfo(int keyword) {
+  assert(keyword >= 0 && "not a Stone keyword");
+  IdentifierInfo *&keywordII = keywordIdentifiers[keyword];
+  if (!keywordII) {
+    keywordII = &identifiers.get(lexerKeywords[keyword].spelling);
+  }
+  return keywordII;
+}
+
+void lex::Lexer::Report(const char *loc, unsigned diagID, int arg) {
+  if (tokenBuffer) {
+    tokenBuffer->AddDeferredDiag(
+        {tokenBuffer->GetNumTokens(), GetSourceLocation(loc), diagID, arg});
+    return;
+  }
+  DiagnosticBuilder builder = diags.Report(GetSourceLocation(loc), diagID);
+  if (arg >= 0) {
+    builder << arg;
+  }
+}
+
+void lex::Lexer::FormToken(Token &result, const char *tokEnd,
+                           tok::TokenKind kind) {
+  result.setKind(kind);
+  result.setLocation(GetSourceLocation(bufferPtr));
+  result.setLength(tokEnd - bufferPtr);
+  if (tok::isLiteral(kind)) {
+    result.setLiteralData(bufferPtr);
+  }
+  bufferPtr = tokEnd;
+  ++numTokens;
+}
+
+const char *lex::Lexer::SkipLineComment(const char *curPtr) {
+  // The newline itself is left for the caller, which marks the next token as
+  // starting a line.
+  const void *eol = std::memchr(curPtr, '\n', bufferEnd - curPtr);
+  return eol ? static_cast<const char *>(eol) : bufferEnd;
+}
+
+const char *lex::Lexer::SkipBlockComment(Token &result, const char *curPtr) {
+  llvm::StringRef rest(curPtr + 2, bufferEnd - (curPtr + 2));
+  size_t end = rest.find("*/");
+  if (end == llvm::StringRef::npos) {
+    Report(curPtr, diag::err_unterminated_block_comment);
+    return bufferEnd;
+  }
+  if (rest.take_front(end).find_first_of("\r\n") != llvm::StringRef::npos) {
+    result.setFlag(Token::StartOfLine);
+  }
+  return rest.data() + end + 2;
+}
+
+void lex::Lexer::LexIdentifierOrKeyword(Token &result, const char *curPtr) {
+  while (isAsciiIdentifierContinue(*curPtr)) {
+    ++curPtr;
+  }
+  llvm::StringRef spelling(bufferPtr, curPtr - bufferPtr);
+
+  int keyword = GetLexerKeywordTable().Find(spelling);
+  if (keyword >= 0) {
+    FormToken(result, curPtr, lexerKeywords[keyword].kind);
+    ++numKeywords;
+  } else {
+    FormToken(result, curPtr, tok::identifier);
+    ++numIdentifiers;
+  }
+
+  // A token buffer resolves identifiers when the parser reads them.
+  if (tokenBuffer) {
+    return;
+  }
+  if (keyword >= 0) {
+    result.setIdentifierInfo(GetKeywordIdentifierInfo(keyword));
+    return;
+  }
+  result.setIdentifierInfo(&identifiers.get(spelling));
+}
+
+void lex::Lexer::LexNumericConstant(Token &result, const char *curPtr) {
+  // Take the whole pp-number; the literal parser sorts out what it means.
+  char prev = curPtr[-1];
+  while (true) {
+    char c = *curPtr;
+    bool isExponentSign = (c == '+' || c == '-') &&
+                          (prev == 'e' || prev == 'E' || prev == 'p' ||
+                           prev == 'P');
+    if (!isPreprocessingNumberBody(c) && !isExponentSign) {
+      break;
+    }
+    prev = c;
+    ++curPtr;
+  }
+  FormToken(result, curPtr, tok::numeric_constant);
+}
+
+void lex::Lexer::LexCharOrStringLiteral(Token &result, const char *curPtr,
+                                        char quote) {
+  // curPtr is past the opening quote.
+  while (true) {
+    char c = *curPtr++;
+    if (c == quote) {
+      break;
+    }
+    if (c == '\\' && curPtr != bufferEnd) {
+      ++curPtr;
+      continue;
+    }
+    if (c == '\n' || c == '\r' || (c == '\0' && curPtr - 1 == bufferEnd)) {
+      Report(bufferPtr, diag::ext_unterminated_char_or_string,
+             quote == '"');
+      FormToken(result, curPtr - 1, tok::unknown);
+      return;
+    }
+  }
+  if (quote == '\'' && curPtr - bufferPtr == 2) {
+    Report(bufferPtr, diag::ext_empty_character);
+  }
+  FormToken(result, curPtr,
+            quote == '"' ? tok::string_literal : tok::char_constant);
+}
+
+void lex::Lexer::LexFromBuffer(Token &result) {
+  result.startToken();
+  if (numTokens == 0) {
+    result.setFlag(Token::StartOfLine);
+  }
+
+  // Skip whitespace and comments, recording in the flags what was skipped.
+  const char *curPtr = bufferPtr;
+  while (true) {
+    unsigned char c = *curPtr;
+    if (isHorizontalWhitespace(c)) {
+      result.setFlag(Token::LeadingSpace);
+      ++curPtr;
+      continue;
+    }
+    if (isVerticalWhitespace(c)) {
+      result.setFlag(Token::StartOfLine);
+      result.clearFlag(Token::LeadingSpace);
+      ++curPtr;
+      continue;
+    }
+    if (c == '/' && curPtr[1] == '/') {
+      curPtr = SkipLineComment(curPtr);
+      result.setFlag(Token::LeadingSpace);
+      continue;
+    }
+    if (c == '/' && curPtr[1] == '*') {
+      curPtr = SkipBlockComment(result, curPtr);
+      result.setFlag(Token::LeadingSpace);
+      continue;
+    }
+    break;
+  }
+  bufferPtr = curPtr;
+  if (curPtr >= lexEnd) {
+    FormToken(result, curPtr, tok::eof);
+    return;
+  }
+
+  unsigned char c = *curPtr;
+  const char *tokEnd = curPtr + 1;
+  if (isAsciiIdentifierStart(c)) {
+    LexIdentifierOrKeyword(result, tokEnd);
+    return;
+  }
+  if (isDigit(c) || (c == '.' && isDigit(curPtr[1]))) {
+    LexNumericConstant(result, tokEnd);
+    return;
+  }
+
+  tok::TokenKind kind = tok::unknown;
+  switch (c) {
+  case '\0':
+    if (curPtr == bufferEnd) {
+      FormToken(result, curPtr, tok::eof);
+      return;
+    }
+    if (codeCompletionLoc.isValid() &&
+        GetSourceLocation(curPtr) == codeCompletionLoc) {
+      kind = tok::code_completion;
+    }
+    break;
+  case '"':
+  case '\'':
+    LexCharOrStringLiteral(result, tokEnd, c);
+    return;
+
+  case '(':
+    kind = tok::l_paren;
+    break;
+  case ')':
+    kind = tok::r_paren;
+    break;
+  case '[':
+    kind = tok::l_square;
+    break;
+  case ']':
+    kind = tok::r_square;
+    break;
+  case '{':
+    kind = tok::l_brace;
+    break;
+  case '}':
+    kind = tok::r_brace;
+    break;
+  case ';':
+    kind = tok::semi;
+    break;
+  case ',':
+    kind = tok::comma;
+    break;
+  case '~':
+    kind = tok::tilde;
+    break;
+  case '?':
+    kind = tok::question;
+    break;
+  case '@':
+    kind = tok::at;
+    break;
+  case '#':
+    kind = tok::hash;
+    if (*tokEnd == '#') {
+      kind = tok::hashhash;
+      ++tokEnd;
+    }
+    break;
+  case '.':
+    kind = tok::period;
+    if (tokEnd[0] == '.' && tokEnd[1] == '.') {
+      kind = tok::ellipsis;
+      tokEnd += 2;
+    } else if (*tokEnd == '*') {
+      kind = tok::periodstar;
+      ++tokEnd;
+    }
+    break;
+  case ':':
+    kind = tok::colon;
+    if (*tokEnd == ':') {
+      kind = tok::coloncolon;
+      ++tokEnd;
+    }
+    break;
+  case '+':
+    kind = tok::plus;
+    if (*tokEnd == '+') {
+      kind = tok::plusplus;
+      ++tokEnd;
+    } else if (*tokEnd == '=') {
+      kind = tok::plusequal;
+      ++tokEnd;
+    }
+    break;
+  case '-':
+    kind = tok::minus;
+    if (tokEnd[0] == '>' && tokEnd[1] == '*') {
+      kind = tok::arrowstar;
+      tokEnd += 2;
+    } else if (*tokEnd == '>') {
+      kind = tok::arrow;
+      ++tokEnd;
+    } else if (*tokEnd == '-') {
+      kind = tok::minusminus;
+      ++tokEnd;
+    } else if (*tokEnd == '=') {
+      kind = tok::minusequal;
+      ++tokEnd;
+    }
+    break;
+  case '*':
+    kind = tok::star;
+    if (*tokEnd == '=') {
+      kind = tok::starequal;
+      ++tokEnd;
+    }
+    break;
+  case '/':
+    kind = tok::slash;
+    if (*tokEnd == '=') {
+      kind = tok::slashequal;
+      ++tokEnd;
+    }
+    break;
+  case '%':
+    kind = tok::percent;
+    if (*tokEnd == '=') {
+      kind = tok::percentequal;
+      ++tokEnd;
+    }
+    break;
+  case '&':
+    kind = tok::amp;
+    if (*tokEnd == '&') {
+      kind = tok::ampamp;
+      ++tokEnd;
+    } else if (*tokEnd == '=') {
+      kind = tok::ampequal;
+      ++tokEnd;
+    }
+    break;
+  case '|':
+    kind = tok::pipe;
+    if (*tokEnd == '|') {
+      kind = tok::pipepipe;
+      ++tokEnd;
+    } else if (*tokEnd == '=') {
+      kind = tok::pipeequal;
+      ++tokEnd;
+    }
+    break;
+  case '^':
+    kind = tok::caret;
+    if (*tokEnd == '=') {
+      kind = tok::caretequal;
+      ++tokEnd;
+    }
+    break;
+  case '!':
+    kind = tok::exclaim;
+    if (*tokEnd == '=') {
+      kind = tok::exclaimequal;
+      ++tokEnd;
+    }
+    break;
+  case '=':
+    kind = tok::equal;
+    if (*tokEnd == '=') {
+      kind = tok::equalequal;
+      ++tokEnd;
+    }
+    break;
+  case '<':
+    kind = tok::less;
+    if (tokEnd[0] == '<' && tokEnd[1] == '=') {
+      kind = tok::lesslessequal;
+      tokEnd += 2;
+    } else if (*tokEnd == '<') {
+      kind = tok::lessless;
+      ++tokEnd;
+    } else if (tokEnd[0] == '=' && tokEnd[1] == '>') {
+      kind = tok::spaceship;
+      tokEnd += 2;
+    } else if (*tokEnd == '=') {
+      kind = tok::lessequal;
+      ++tokEnd;
+    }
+    break;
+  case '>':
+    kind = tok::greater;
+    if (tokEnd[0] == '>' && tokEnd[1] == '=') {
+      kind = tok::greatergreaterequal;
+      tokEnd += 2;
+    } else if (*tokEnd == '>') {
+      kind = tok::greatergreater;
+      ++tokEnd;
+    } else if (*tokEnd == '=') {
+      kind = tok::greaterequal;
+      ++tokEnd;
+    }
+    break;
+  default:
+    // A non-ASCII character is one stray token, not one per byte.
+    if (!isASCII(c)) {
+      while ((static_cast<unsigned char>(*tokEnd) & 0xC0) == 0x80) {
+        ++tokEnd;
+      }
+    }
+    break;
+  }
+  if (kind == tok::unknown) {
+    Report(curPtr, diag::err_stray_character);
+  }
+  FormToken(result, tokEnd, kind);
+}
+
+void lex::Lexer::PrintStats() const {
+  // The counters belong to the worker thread until it has finished.
+  if (tokenBuffer) {
+    tokenBuffer->WaitForFinish();
+  }
+  llvm::errs() << "\n*** Lexer Stats:\n";
+  llvm::errs() << "  " << numTokens << " tokens lexed: " << numKeywords
+               << " keywords, " << numIdentifiers << " identifiers.\n";
+  llvm::errs() << "  " << pendingTokens.size() - pendingPos
+               << " tokens pending.\n";
+  if (tokenBuffer) {
+    llvm::errs() << "  " << tokenBuffer->GetNumPublished()
+                 << " tokens buffered in " << tokenBuffer->GetMemorySize()
+                 << " bytes.\n";
+  }
+}
@@ -1,36 +1,140 @@
 #include "clang/Compile/Parser.h"
 #include "clang/Compile/Parsing.h"
 
+#include "llvm/ADT/STLExtras.h"
+
+#include <iterator>
+
 using namespace clang;
 
+/// The tokens that begin a top-level decl.
+static const tok::TokenKind topLevelDeclSpecKinds[] = {
+    tok::kw_fun,   tok::kw_enum,     tok::kw_struct, tok::kw_public,
+    tok::kw_class, tok::kw_interface};
+
 bool Parser::IsTopLevelDeclSpec() {
-  switch (Tok.getKind()) {
-  case tok::kw_fun:
-  case tok::kw_enum:
-  case tok::kw_public:
-  case tok::kw_class:
-  case tok::kw_interface:
-    return true;
-  default:
+  return llvm::is_contained(topLevelDeclSpecKinds, Tok.getKind());
+}
+
+llvm::ArrayRef<unsigned> Parser::GetResyncOffsets() {
+  if (!builtResyncOffsets) {
+    lexer.ComputeTopLevelTokenOffsets(topLevelDeclSpecKinds, resyncOffsets);
+    builtResyncOffsets = true;
+  }
+  return resyncOffsets;
+}
+
+bool Parser::IsAtResyncPoint() {
+  if (!IsTopLevelDeclSpec()) {
     return false;
   }
+  SourceManager &sm = pp.getSourceManager();
+  return llvm::binary_search(GetResyncOffsets(),
+                             sm.getFileOffset(Tok.getLocation()));
 }
 
-void Parser::ParseTopLevelDecls(
-    llvm::SmallVector<ParserResult<Decl>> &results) {
+void Parser::SkipMalformedDecl() {
+  ++numMalformedDeclsSkipped;
+  ParenCount = BracketCount = BraceCount = 0;
+  if (IsEOF()) {
+    return;
+  }
+
+  // Resume at the first resync point past the current token; there is
+  // none past the end of the file.
+  SourceManager &sm = pp.getSourceManager();
+  llvm::ArrayRef<unsigned> offsets = GetResyncOffsets();
+  auto next =
+      llvm::upper_bound(offsets, sm.getFileOffset(Tok.getLocation()));
+  lexer.Seek(next == offsets.end() ? ~0u : *next);
+  PrevTokLocation = Tok.getLocation();
+  lexer.Lex(Tok);
+}
+
+void Parser::SkipNominalTypeDecl() {
+  // The name and any base list come before the body; a decl without one
+  // ends at a ';' or the next top-level decl.
+  tok::TokenKind stopKinds[std::size(topLevelDeclSpecKinds) + 1];
+  llvm::copy(topLevelDeclSpecKinds, stopKinds);
+  stopKinds[std::size(topLevelDeclSpecKinds)] = tok::l_brace;
+  SkipUntil(stopKinds, StopAtSemi | StopBeforeMatch);
+  if (Tok.IsLBrace()) {
+    ConsumeBrace();
+    SkipUntil(tok::r_brace);
+  }
+  TryConsumeToken(tok::semi);
+}
 
-  auto Success = [&](ParserResult<Decl> &result) -> bool {
-    return (!result.IsError() && result.IsNonNull());
-  };
-  while (IsParsing() && IsTopLevelDeclSpec()) {
+bool Parser::ParseNextTopLevelDecl(ParserResult<Decl> &result) {
+  while (IsParsing()) {
+    if (!IsTopLevelDeclSpec()) {
+      if (!parserOpts.recoverMalformedDecls) {
+        return false;
+      }
+      Diag(Tok, diag::err_expected_external_declaration);
+      SkipMalformedDecl();
+      continue;
+    }
+
+    unsigned numErrors = diags.getNumErrors();
+    SourceLocation beginLoc = Tok.getLocation();
     ParsingDeclSpec spec(*this);
     spec.isTopLevelDecl = true;
-    auto result = ParseTopLevelDecl(spec);
-    if (!Success(result)) {
-      return;
+    result = ParseTopLevelDecl(spec);
+    if (!result.IsError() && result.IsNonNull()) {
+      return true;
+    }
+
+    // A decl that parsed cleanly to nothing, like the enum, struct and
+    // class decls that Sema does not build yet, is not malformed.
+    bool failed = result.IsError() || diags.getNumErrors() != numErrors;
+    if (!failed && Tok.getLocation() != beginLoc) {
+      continue;
+    }
+    if (!parserOpts.recoverMalformedDecls) {
+      return false;
+    }
+
+    // Every dropped decl gets an error, and the parse picks up at the next
+    // decl. The failed one may already have stopped there.
+    if (!failed) {
+      Diag(beginLoc, diag::err_expected_external_declaration);
+    }
+    if (Tok.getLocation() != beginLoc && IsAtResyncPoint()) {
+      continue;
+    }
+    SkipMalformedDecl();
+  }
+  return false;
+}
+
+bool Parser::ParseTopLevelDecls(TopLevelDeclConsumer consumer) {
+  SourceManager &sm = pp.getSourceManager();
+  ParserResult<Decl> result;
+  while (true) {
+    unsigned beginOffset = sm.getFileOffset(Tok.getLocation());
+    if (!ParseNextTopLevelDecl(result)) {
+      break;
+    }
+    if (parserOpts.recordTopLevelDeclSpans) {
+      TopLevelDeclSpan &span = topLevelDeclSpans.emplace_back();
+      span.decl = result.Get();
+      span.beginOffset = beginOffset;
+      span.endOffset = sm.getFileOffset(Tok.getLocation());
+    }
+    if (!consumer(result)) {
+      return false;
     }
-    results.push_back(result);
   }
+  return true;
+}
+
+void Parser::ParseTopLevelDecls(
+    llvm::SmallVector<ParserResult<Decl>> &results) {
+  ParseTopLevelDecls([&](ParserResult<Decl> &result) {
+    results.push_back(result);
+    return true;
+  });
 }
 
 ParserResult<Decl> Parser::ParseTopLevelDecl(ParsingDeclSpec &spec) {
@@ -68,6 +172,15 @@ ParserResult<Decl> Parser::ParseDecl(DeclaratorContext declaratorContext,
   ParsingDeclarator declarator(*this, spec, localAttrs, declaratorContext);
   ParseDeclarator(declarator);
 
+  // The nominal type decls take their name themselves.
+  if (spec.hasStructSpecifier()) {
+    return ParseStructDecl(declarator);
+  } else if (spec.hasEnumSpecifier()) {
+    return ParseEnumDecl(declarator);
+  } else if (spec.hasClassSpecifier()) {
+    return ParseClassDecl(declarator);
+  }
+
   // Bail out if the first declarator didn't seem well-formed.
   if (!declarator.hasName() && !declarator.mayOmitIdentifier()) {
     // SkipMalformedDecl();
@@ -78,30 +191,55 @@ ParserResult<Decl> Parser::ParseDecl(DeclaratorContext declaratorContext,
 
   if (spec.isFunSpecified()) {
     return ParseFunDecl(declarator);
-  } else if (spec.hasStructSpecifier()) {
-    return ParseStructDecl(declarator);
-  }
-
-  else if (spec.hasEnumSpecifier()) {
-    return ParseEnumDecl(declarator);
-  }
-
-  else if (spec.hasStructSpecifier()) {
-    return ParseClassDecl(declarator);
   }
 
   return ParserResult<Decl>();
 }
 
 ParserResult<Decl> Parser::ParseFunDecl(ParsingDeclarator &declarator) {
-  ParserResult<Decl> result;
-
   assert(declarator.getDeclSpec().isFunSpecified());
   assert(declarator.isFunctionDeclarator());
 
-  ParsingScope funDeclScope(this, Scope::FnScope | Scope::DeclScope);
+  Decl *funDecl = sema.ActOnDeclarator(GetCurScope(), declarator);
+  if (!funDecl) {
+    return MakeParserErrorResult<Decl>();
+  }
 
-  return result;
+  // A declaration without a body.
+  if (!Tok.IsLBrace()) {
+    if (ExpectAndConsume(tok::semi)) {
+      return MakeParserErrorResult(funDecl);
+    }
+    return MakeParserResult(funDecl);
+  }
+
+  // Capture the body by brace balance and leave it unparsed until someone
+  // asks for it; see ParseLateParsedFunBody.
+  auto lateParsed = std::make_unique<LateParsedFunBody>(funDecl);
+  if (!ConsumeAndStoreFunBody(lateParsed->toks)) {
+    return MakeParserErrorResult(funDecl);
+  }
+  lateParsedFunBodies[funDecl] = std::move(lateParsed);
+  ++numDelayedFunBodies;
+
+  return MakeParserResult(funDecl);
+}
+
+bool Parser::ConsumeAndStoreFunBody(CachedTokens &toks) {
+  assert(Tok.IsLBrace() && "expected the '{' of a fun body");
+
+  // The body ends at the '}' that brings BraceCount back to where it is now.
+  unsigned short outerBraceCount = BraceCount;
+  do {
+    if (IsEOF()) {
+      Diag(Tok, diag::err_expected) << tok::r_brace;
+      return false;
+    }
+    toks.push_back(Tok);
+    ConsumeAnyToken(/*consumeCodeCompletionTok=*/true);
+  } while (BraceCount != outerBraceCount);
+
+  return true;
 }
 
 ParserResult<Decl> Parser::ParseEnumDecl(ParsingDeclarator &declarator) {
@@ -112,6 +250,7 @@ ParserResult<Decl> Parser::ParseEnumDecl(ParsingDeclarator &declarator) {
   ParsingScope funDeclScope(this, Scope::EnumScope | Scope::DeclScope);
 
   // ParseFunctionDeclarator();
+  SkipNominalTypeDecl();
 
   return result;
 }
@@ -122,6 +261,7 @@ ParserResult<Decl> Parser::ParseStructDecl(ParsingDeclarator &declarator) {
   assert(declarator.getDeclSpec().hasStructSpecifier());
 
   ParsingScope structDeclScope(this, Scope::ClassScope | Scope::DeclScope);
+  SkipNominalTypeDecl();
 
   return result;
 }
@@ -145,6 +285,7 @@ ParserResult<Decl> Parser::ParseClassDecl(ParsingDeclarator &declarator) {
   assert(declarator.getDeclSpec().hasClassSpecifier());
 
   ParsingScope classDeclScope(this, Scope::ClassScope | Scope::DeclScope);
+  SkipNominalTypeDecl();
 
   return result;
 }
@@ -0,0 +1,390 @@
+#include "clang/Compile/Parser.h"
+#include "clang/Compile/Parsing.h"
+
+#include <array>
+
+using namespace clang;
+
+namespace {
+
+/// BinaryOperatorInfo - How a token binds when it follows an operand.
+struct BinaryOperatorInfo final {
+  prec::Level level = prec::Unknown;
+  bool isRightAssociative = false;
+};
+
+/// OperatorTable - The operator properties of every token kind.
+struct OperatorTable final {
+  std::array<BinaryOperatorInfo, tok::NUM_TOKENS> binary{};
+  std::array<bool, tok::NUM_TOKENS> isPrefix{};
+
+  constexpr void AddBinary(prec::Level level, bool isRightAssociative,
+                           std::initializer_list<tok::TokenKind> kinds) {
+    for (tok::TokenKind kind : kinds) {
+      binary[kind] = {level, isRightAssociative};
+    }
+  }
+};
+
+/// PendingOperator - An operator on the ParseBinaryExpr stack that is
+/// waiting for its right operand, or an open paren waiting for its ')'.
+struct PendingOperator final {
+  enum Kind : uint8_t { Binary, Conditional, Prefix, Paren };
+
+  Kind kind;
+  Token opTok;
+  prec::Level level = prec::Unknown;
+  bool isRightAssociative = false;
+  /// The left operand of a binary operator, or the condition of a '?:'.
+  Expr *lhs = nullptr;
+  /// The middle operand of a '?:'.
+  Expr *middle = nullptr;
+  SourceLocation colonLoc;
+  /// The GreaterThanIsOperator outside a paren.
+  bool prevGreaterThanIsOperator = true;
+};
+
+} // namespace
+
+/// operatorTable - Built at compile time, so that classifying a token is a
+/// single load rather than a switch or a call per precedence level.
+static constexpr OperatorTable operatorTable = [] {
+  OperatorTable table;
+  table.AddBinary(prec::Assignment, /*isRightAssociative=*/true,
+                  {tok::equal, tok::starequal, tok::slashequal,
+                   tok::percentequal, tok::plusequal, tok::minusequal,
+                   tok::lesslessequal, tok::greatergreaterequal,
+                   tok::ampequal, tok::caretequal, tok::pipeequal});
+  table.AddBinary(prec::Conditional, /*isRightAssociative=*/true,
+                  {tok::question});
+  table.AddBinary(prec::LogicalOr, false, {tok::pipepipe});
+  table.AddBinary(prec::LogicalAnd, false, {tok::ampamp});
+  table.AddBinary(prec::InclusiveOr, false, {tok::pipe});
+  table.AddBinary(prec::ExclusiveOr, false, {tok::caret});
+  table.AddBinary(prec::And, false, {tok::amp});
+  table.AddBinary(prec::Equality, false, {tok::equalequal, tok::exclaimequal});
+  table.AddBinary(prec::Relational, false,
+                  {tok::less, tok::greater, tok::lessequal, tok::greaterequal});
+  table.AddBinary(prec::Shift, false, {tok::lessless, tok::greatergreater});
+  table.AddBinary(prec::Additive, false, {tok::plus, tok::minus});
+  table.AddBinary(prec::Multiplicative, false,
+                  {tok::star, tok::slash, tok::percent});
+
+  for (tok::TokenKind kind :
+       {tok::plus, tok::minus, tok::exclaim, tok::tilde, tok::star, tok::amp,
+        tok::plusplus, tok::minusminus}) {
+    table.isPrefix[kind] = true;
+  }
+  return table;
+}();
+
+static_assert(operatorTable.binary[tok::star].level == prec::Multiplicative &&
+                  operatorTable.binary[tok::equal].isRightAssociative &&
+                  operatorTable.isPrefix[tok::exclaim],
+              "the operator table is built at compile time");
+
+static BinaryOperatorInfo GetBinaryOperatorInfo(tok::TokenKind kind,
+                                                bool greaterThanIsOperator) {
+  if (!greaterThanIsOperator &&
+      (kind == tok::greater || kind == tok::greatergreater)) {
+    return BinaryOperatorInfo();
+  }
+  return operatorTable.binary[kind];
+}
+
+static ParserResult<Expr> MakeExprResult(ExprResult result) {
+  if (result.isInvalid() || !result.get()) {
+    return MakeParserErrorResult<Expr>();
+  }
+  return MakeParserResult(result.get());
+}
+
+ParserResult<Expr> Parser::ParseExpr(TypeCastState typeCastState) {
+  // Stone has no comma operator; a ',' ends the expression.
+  return ParseBinaryExpr(prec::Assignment);
+}
+
+ParserResult<Expr> Parser::ParseBinaryExpr(prec::Level minLevel) {
+  llvm::SmallVector<PendingOperator, 16> stack;
+  unsigned numOpenParens = 0;
+
+  auto push = [&](const PendingOperator &op) {
+    stack.push_back(op);
+    maxExprStackDepth = std::max<unsigned>(maxExprStackDepth, stack.size());
+  };
+
+  // Give up on the expression, skipping to the ')' of each paren still open
+  // from the innermost out.
+  auto fail = [&]() {
+    bool skipping = true;
+    while (!stack.empty()) {
+      PendingOperator op = stack.pop_back_val();
+      if (op.kind != PendingOperator::Paren) {
+        continue;
+      }
+      GreaterThanIsOperator = op.prevGreaterThanIsOperator;
+      skipping = skipping && SkipUntil(tok::r_paren, StopAtSemi);
+    }
+    return MakeParserErrorResult<Expr>();
+  };
+
+  // Apply the operator on top of the stack to its right operand.
+  auto reduce = [&](const PendingOperator &op, Expr *rhs) {
+    SourceLocation opLoc = op.opTok.getLocation();
+    switch (op.kind) {
+    case PendingOperator::Prefix:
+      return sema.ActOnUnaryOp(GetCurScope(), opLoc, op.opTok.getKind(), rhs);
+    case PendingOperator::Conditional:
+      return sema.ActOnConditionalOp(opLoc, op.colonLoc, op.lhs, op.middle,
+                                     rhs);
+    case PendingOperator::Binary:
+      return sema.ActOnBinOp(GetCurScope(), opLoc, op.opTok.getKind(), op.lhs,
+                             rhs);
+    case PendingOperator::Paren:
+      break;
+    }
+    llvm_unreachable("a paren is closed, not reduced");
+  };
+
+  while (true) {
+    // An operand: prefix operators and open parens, and then a primary
+    // expression with its suffixes.
+    while (true) {
+      if (operatorTable.isPrefix[Tok.getKind()]) {
+        ++numExprOperators;
+        push({PendingOperator::Prefix, Tok});
+        ConsumeToken();
+        continue;
+      }
+      if (Tok.IsLParen()) {
+        if (ParenCount >= GetLangOpts().BracketDepth) {
+          Diag(Tok, diag::err_bracket_depth_exceeded)
+              << GetLangOpts().BracketDepth;
+          Diag(Tok, diag::note_bracket_depth);
+          CutOffParsing();
+          return fail();
+        }
+        PendingOperator paren{PendingOperator::Paren, Tok};
+        paren.prevGreaterThanIsOperator = GreaterThanIsOperator;
+        GreaterThanIsOperator = true;
+        push(paren);
+        ConsumeParen();
+        ++numOpenParens;
+        continue;
+      }
+      break;
+    }
+    bool isAddressOfOperand = !stack.empty() &&
+                              stack.back().kind == PendingOperator::Prefix &&
+                              stack.back().opTok.is(tok::amp);
+    ParserResult<Expr> primary = ParsePrimaryExpr(isAddressOfOperand);
+    if (primary.IsError()) {
+      return fail();
+    }
+    ParserResult<Expr> postfix = ParsePostfixExprSuffix(primary.Get());
+    if (postfix.IsError()) {
+      return fail();
+    }
+    Expr *operand = postfix.Get();
+
+    // An operator, a ')' or the end of the expression.
+    BinaryOperatorInfo next;
+    while (true) {
+      next = GetBinaryOperatorInfo(Tok.getKind(), GreaterThanIsOperator);
+      if (next.level < (numOpenParens ? prec::Assignment : minLevel)) {
+        next = BinaryOperatorInfo();
+      }
+      // Apply the pending operators that bind at least as tightly as next.
+      while (!stack.empty() && stack.back().kind != PendingOperator::Paren) {
+        const PendingOperator &top = stack.back();
+        if (top.kind != PendingOperator::Prefix &&
+            (top.level < next.level ||
+             (top.level == next.level && next.isRightAssociative))) {
+          break;
+        }
+        ExprResult result = reduce(top, operand);
+        stack.pop_back();
+        if (result.isInvalid()) {
+          return fail();
+        }
+        operand = result.get();
+      }
+      if (next.level != prec::Unknown) {
+        break;
+      }
+      if (stack.empty()) {
+        return MakeParserResult(operand);
+      }
+
+      // All that is left above the innermost paren is its operand.
+      PendingOperator paren = stack.pop_back_val();
+      --numOpenParens;
+      GreaterThanIsOperator = paren.prevGreaterThanIsOperator;
+      if (!Tok.IsRParen()) {
+        Diag(Tok, diag::err_expected) << tok::r_paren;
+        Diag(paren.opTok, diag::note_matching) << tok::l_paren;
+        return fail();
+      }
+      SourceLocation rParenLoc = ConsumeParen();
+      ParserResult<Expr> parenExpr = MakeExprResult(
+          sema.ActOnParenExpr(paren.opTok.getLocation(), rParenLoc, operand));
+      if (parenExpr.IsError()) {
+        return fail();
+      }
+      postfix = ParsePostfixExprSuffix(parenExpr.Get());
+      if (postfix.IsError()) {
+        return fail();
+      }
+      operand = postfix.Get();
+    }
+
+    ++numExprOperators;
+    PendingOperator op{PendingOperator::Binary, Tok, next.level,
+                       next.isRightAssociative, operand};
+    ConsumeToken();
+    if (op.opTok.is(tok::question)) {
+      op.kind = PendingOperator::Conditional;
+      GreaterThanIsOperatorScope greaterThanIsOperator(GreaterThanIsOperator,
+                                                       true);
+      ParserResult<Expr> middle = ParseExpr();
+      if (middle.IsError()) {
+        return fail();
+      }
+      op.middle = middle.Get();
+      if (!TryConsumeToken(tok::colon, op.colonLoc)) {
+        Diag(Tok, diag::err_expected) << tok::colon;
+        Diag(op.opTok, diag::note_matching) << tok::question;
+        return fail();
+      }
+    }
+    push(op);
+  }
+}
+
+ParserResult<Expr> Parser::ParsePrimaryExpr(bool isAddressOfOperand) {
+  tok::TokenKind kind = Tok.getKind();
+  switch (kind) {
+  case tok::identifier: {
+    UnqualifiedId name;
+    name.setIdentifier(Tok.getIdentifierInfo(), Tok.getLocation());
+    ConsumeToken();
+    CXXScopeSpec scopeSpec;
+    return MakeExprResult(sema.ActOnIdExpression(
+        GetCurScope(), scopeSpec, /*TemplateKWLoc=*/SourceLocation(), name,
+        /*HasTrailingLParen=*/Tok.IsLParen(), isAddressOfOperand));
+  }
+  case tok::numeric_constant: {
+    ExprResult result = sema.ActOnNumericConstant(Tok, GetCurScope());
+    ConsumeToken();
+    return MakeExprResult(result);
+  }
+  case tok::char_constant: {
+    ExprResult result = sema.ActOnCharacterConstant(Tok, GetCurScope());
+    ConsumeToken();
+    return MakeExprResult(result);
+  }
+  case tok::kw_true:
+  case tok::kw_false:
+    return MakeExprResult(sema.ActOnCXXBoolLiteral(ConsumeToken(), kind));
+  case tok::kw_nullptr:
+    return MakeExprResult(sema.ActOnCXXNullPtrLiteral(ConsumeToken()));
+  case tok::kw_this:
+    return MakeExprResult(sema.ActOnCXXThis(ConsumeToken()));
+  default:
+    break;
+  }
+
+  if (isTokenStringLiteral()) {
+    // Adjacent string literals are concatenated.
+    llvm::SmallVector<Token, 4> stringToks;
+    do {
+      stringToks.push_back(Tok);
+      ConsumeStringToken();
+    } while (isTokenStringLiteral());
+    return MakeExprResult(sema.ActOnStringLiteral(stringToks, GetCurScope()));
+  }
+
+  Diag(Tok, diag::err_expected_expression);
+  return MakeParserErrorResult<Expr>();
+}
+
+ParserResult<Expr> Parser::ParsePostfixExprSuffix(Expr *lhs) {
+  while (true) {
+    ExprResult result;
+    switch (Tok.getKind()) {
+    case tok::l_paren: {
+      BalancedDelimiterTracker parens(*this, tok::l_paren);
+      if (parens.consumeOpen()) {
+        return MakeParserErrorResult<Expr>();
+      }
+      llvm::SmallVector<Expr *, 4> args;
+      if (!Tok.IsRParen()) {
+        do {
+          ParserResult<Expr> arg = ParseExpr();
+          if (arg.IsError()) {
+            parens.skipToEnd();
+            return MakeParserErrorResult<Expr>();
+          }
+          args.push_back(arg.Get());
+        } while (TryConsumeToken(tok::comma));
+      }
+      if (parens.consumeClose()) {
+        return MakeParserErrorResult<Expr>();
+      }
+      result = sema.ActOnCallExpr(GetCurScope(), lhs, parens.getOpenLocation(),
+                                  args, parens.getCloseLocation());
+      break;
+    }
+    case tok::l_square: {
+      BalancedDelimiterTracker brackets(*this, tok::l_square);
+      if (brackets.consumeOpen()) {
+        return MakeParserErrorResult<Expr>();
+      }
+      ParserResult<Expr> index = ParseExpr();
+      if (index.IsError()) {
+        brackets.skipToEnd();
+        return MakeParserErrorResult<Expr>();
+      }
+      if (brackets.consumeClose()) {
+        return MakeParserErrorResult<Expr>();
+      }
+      Expr *indexExpr = index.Get();
+      result = sema.ActOnArraySubscriptExpr(
+          GetCurScope(), lhs, brackets.getOpenLocation(), indexExpr,
+          brackets.getCloseLocation());
+      break;
+    }
+    case tok::period:
+    case tok::arrow: {
+      tok::TokenKind opKind = Tok.getKind();
+      SourceLocation opLoc = ConsumeToken();
+      if (!Tok.IsIdentifier()) {
+        Diag(Tok, diag::err_expected) << tok::identifier;
+        return MakeParserErrorResult<Expr>();
+      }
+      UnqualifiedId member;
+      member.setIdentifier(Tok.getIdentifierInfo(), Tok.getLocation());
+      ConsumeToken();
+      CXXScopeSpec scopeSpec;
+      result = sema.ActOnMemberAccessExpr(
+          GetCurScope(), lhs, opLoc, opKind, scopeSpec,
+          /*TemplateKWLoc=*/SourceLocation(), member, /*ObjCImpDecl=*/nullptr);
+      break;
+    }
+    case tok::plusplus:
+    case tok::minusminus: {
+      tok::TokenKind opKind = Tok.getKind();
+      ++numExprOperators;
+      result = sema.ActOnPostfixUnaryOp(GetCurScope(), ConsumeToken(), opKind,
+                                        lhs);
+      break;
+    }
+    default:
+      return MakeParserResult(lhs);
+    }
+    if (result.isInvalid() || !result.get()) {
+      return MakeParserErrorResult<Expr>();
+    }
+    lhs = result.get();
+  }
+}
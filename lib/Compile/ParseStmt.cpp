@@ -0,0 +1,311 @@
+#include "clang/Compile/Parser.h"
+#include "clang/Compile/Parsing.h"
+
+using namespace clang;
+
+static ParserResult<Stmt> MakeStmtResult(StmtResult result) {
+  if (result.isInvalid() || !result.get()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+  return MakeParserResult(result.get());
+}
+
+ParserResult<Stmt> Parser::ParseFunBody(Decl *funDecl) {
+  assert(Tok.IsLBrace() && "expected the '{' of a fun body");
+
+  ParsingScope funBodyScope(this, Scope::FnScope | Scope::DeclScope |
+                                      Scope::CompoundStmtScope);
+  Decl *funDef = sema.ActOnStartOfFunctionDef(GetCurScope(), funDecl);
+
+  ParserResult<Stmt> body = ParseCompoundStmtBody();
+  sema.ActOnFinishFunctionBody(funDef, body.GetPtrOrNull());
+  return body;
+}
+
+ParserResult<Stmt> Parser::ParseStmt() {
+  switch (Tok.getKind()) {
+  case tok::l_brace:
+    return ParseCompoundStmt();
+  case tok::semi:
+    return MakeStmtResult(sema.ActOnNullStmt(ConsumeToken()));
+  case tok::kw_if:
+    return ParseIfStmt();
+  case tok::kw_while:
+    return ParseWhileStmt();
+  case tok::kw_do:
+    return ParseDoStmt();
+  case tok::kw_return:
+    return ParseReturnStmt();
+  case tok::kw_break: {
+    StmtResult result = sema.ActOnBreakStmt(ConsumeToken(), GetCurScope());
+    ExpectAndConsumeStmtSemi(diag::err_expected_semi_after_stmt, "break");
+    return MakeStmtResult(result);
+  }
+  case tok::kw_continue: {
+    StmtResult result =
+        sema.ActOnContinueStmt(ConsumeToken(), GetCurScope());
+    ExpectAndConsumeStmtSemi(diag::err_expected_semi_after_stmt, "continue");
+    return MakeStmtResult(result);
+  }
+  default:
+    return ParseExprStmt();
+  }
+}
+
+ParserResult<Stmt> Parser::ParseCompoundStmt() {
+  ParsingScope compoundScope(this, Scope::DeclScope | Scope::CompoundStmtScope);
+  return ParseCompoundStmtBody();
+}
+
+ParserResult<Stmt> Parser::ParseCompoundStmtBody() {
+  Sema::CompoundScopeRAII compoundScope(sema);
+
+  BalancedDelimiterTracker braces(*this, tok::l_brace);
+  if (braces.consumeOpen()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+
+  // A statement that fails to parse is dropped; the rest of the block is
+  // still parsed.
+  llvm::SmallVector<Stmt *, 16> stmts;
+  while (!Tok.IsRBrace() && !IsEOF()) {
+    ParserResult<Stmt> stmt = ParseStmt();
+    if (!stmt.IsError() && stmt.IsNonNull()) {
+      stmts.push_back(stmt.Get());
+    }
+  }
+  if (braces.consumeClose()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+  return MakeStmtResult(sema.ActOnCompoundStmt(braces.getOpenLocation(),
+                                               braces.getCloseLocation(),
+                                               stmts, /*isStmtExpr=*/false));
+}
+
+ParserResult<Stmt> Parser::ParseSubStmt() {
+  // A block enters its own scope.
+  ParsingScope subStmtScope(this, Scope::DeclScope, /*EnteredScope=*/true,
+                            /*BeforeCompoundStmt=*/Tok.IsLBrace());
+  return ParseStmt();
+}
+
+bool Parser::ParseParenCondExpr(Expr *&cond, SourceLocation &lParenLoc,
+                                SourceLocation &rParenLoc,
+                                StringRef stmtName) {
+  cond = nullptr;
+  if (!Tok.IsLParen()) {
+    Diag(Tok, diag::err_expected_lparen_after) << stmtName;
+    return true;
+  }
+  BalancedDelimiterTracker parens(*this, tok::l_paren);
+  if (parens.consumeOpen()) {
+    return true;
+  }
+  ParserResult<Expr> condExpr = ParseExpr();
+  if (condExpr.IsError()) {
+    parens.skipToEnd();
+    return true;
+  }
+  if (parens.consumeClose()) {
+    return true;
+  }
+  cond = condExpr.Get();
+  lParenLoc = parens.getOpenLocation();
+  rParenLoc = parens.getCloseLocation();
+  return false;
+}
+
+ParserResult<Stmt> Parser::ParseIfStmt() {
+  assert(Tok.is(tok::kw_if) && "expected 'if'");
+  SourceLocation ifLoc = ConsumeToken();
+
+  ParsingScope ifScope(this, Scope::DeclScope | Scope::ControlScope);
+
+  Expr *condExpr = nullptr;
+  SourceLocation lParenLoc, rParenLoc;
+  Sema::ConditionResult cond =
+      ParseParenCondExpr(condExpr, lParenLoc, rParenLoc, "if")
+          ? Sema::ConditionError()
+          : sema.ActOnCondition(GetCurScope(), ifLoc, condExpr,
+                                Sema::ConditionKind::Boolean);
+
+  ParserResult<Stmt> thenStmt = ParseSubStmt();
+  SourceLocation elseLoc;
+  ParserResult<Stmt> elseStmt;
+  if (TryConsumeToken(tok::kw_else, elseLoc)) {
+    elseStmt = ParseSubStmt();
+  }
+  ifScope.Exit();
+
+  if (cond.isInvalid() || thenStmt.IsError() || elseStmt.IsError()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+  return MakeStmtResult(sema.ActOnIfStmt(
+      ifLoc, IfStatementKind::Ordinary, lParenLoc, /*InitStmt=*/nullptr,
+      cond, rParenLoc, thenStmt.Get(), elseLoc, elseStmt.GetPtrOrNull()));
+}
+
+ParserResult<Stmt> Parser::ParseWhileStmt() {
+  assert(Tok.is(tok::kw_while) && "expected 'while'");
+  SourceLocation whileLoc = ConsumeToken();
+
+  ParsingScope whileScope(this, Scope::BreakScope | Scope::ContinueScope |
+                                    Scope::DeclScope | Scope::ControlScope);
+
+  Expr *condExpr = nullptr;
+  SourceLocation lParenLoc, rParenLoc;
+  Sema::ConditionResult cond =
+      ParseParenCondExpr(condExpr, lParenLoc, rParenLoc, "while")
+          ? Sema::ConditionError()
+          : sema.ActOnCondition(GetCurScope(), whileLoc, condExpr,
+                                Sema::ConditionKind::Boolean);
+
+  ParserResult<Stmt> body = ParseSubStmt();
+  whileScope.Exit();
+
+  if (cond.isInvalid() || body.IsError()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+  return MakeStmtResult(sema.ActOnWhileStmt(whileLoc, lParenLoc, cond,
+                                            rParenLoc, body.Get()));
+}
+
+ParserResult<Stmt> Parser::ParseDoStmt() {
+  assert(Tok.is(tok::kw_do) && "expected 'do'");
+  SourceLocation doLoc = ConsumeToken();
+
+  ParsingScope doScope(this, Scope::BreakScope | Scope::ContinueScope |
+                                 Scope::DeclScope);
+  ParserResult<Stmt> body = ParseSubStmt();
+
+  if (Tok.isNot(tok::kw_while)) {
+    if (!body.IsError()) {
+      Diag(Tok, diag::err_expected_while);
+      Diag(doLoc, diag::note_matching) << "'do'";
+    }
+    SkipToEndOfStmt();
+    return MakeParserErrorResult<Stmt>();
+  }
+  SourceLocation whileLoc = ConsumeToken();
+
+  // The condition is outside the body's scope but still in the loop's.
+  Expr *cond = nullptr;
+  SourceLocation lParenLoc, rParenLoc;
+  bool invalidCond =
+      ParseParenCondExpr(cond, lParenLoc, rParenLoc, "do/while");
+  doScope.Exit();
+  ExpectAndConsumeStmtSemi(diag::err_expected_semi_after_stmt, "do/while");
+
+  if (invalidCond || body.IsError()) {
+    return MakeParserErrorResult<Stmt>();
+  }
+  return MakeStmtResult(sema.ActOnDoStmt(doLoc, body.Get(), whileLoc,
+                                         lParenLoc, cond, rParenLoc));
+}
+
+ParserResult<Stmt> Parser::ParseReturnStmt() {
+  assert(Tok.is(tok::kw_return) && "expected 'return'");
+  SourceLocation returnLoc = ConsumeToken();
+
+  Expr *value = nullptr;
+  if (Tok.isNot(tok::semi)) {
+    ParserResult<Expr> result = ParseExpr();
+    if (result.IsError()) {
+      SkipToEndOfStmt();
+      return MakeParserErrorResult<Stmt>();
+    }
+    value = result.Get();
+  }
+  StmtResult result = sema.ActOnReturnStmt(returnLoc, value, GetCurScope());
+  ExpectAndConsumeStmtSemi(diag::err_expected_semi_after_stmt, "return");
+  return MakeStmtResult(result);
+}
+
+ParserResult<Stmt> Parser::ParseExprStmt() {
+  ParserResult<Expr> expr = ParseExpr();
+  if (expr.IsError()) {
+    SkipToEndOfStmt();
+    return MakeParserErrorResult<Stmt>();
+  }
+  StmtResult result = sema.ActOnExprStmt(expr.Get());
+  ExpectAndConsumeStmtSemi(diag::err_expected_semi_after_expr);
+  return MakeStmtResult(result);
+}
+
+void Parser::ExpectAndConsumeStmtSemi(unsigned diagID, StringRef stmtName) {
+  if (ExpectAndConsume(tok::semi, diagID, stmtName)) {
+    SkipToEndOfStmt();
+  }
+}
+
+void Parser::SkipToEndOfStmt() {
+  SkipUntil(tok::r_brace, StopAtSemi | StopBeforeMatch);
+  TryConsumeToken(tok::semi);
+}
+
+bool Parser::HasLateParsedFunBody(const Decl *funDecl) const {
+  return lateParsedFunBodies.count(const_cast<Decl *>(funDecl));
+}
+
+const LateParsedFunBody *
+Parser::GetLateParsedFunBody(const Decl *funDecl) const {
+  auto found = lateParsedFunBodies.find(const_cast<Decl *>(funDecl));
+  if (found == lateParsedFunBodies.end()) {
+    return nullptr;
+  }
+  return found->second.get();
+}
+
+bool Parser::ParseLateParsedFunBody(Decl *funDecl) {
+  auto found = lateParsedFunBodies.find(funDecl);
+  if (found == lateParsedFunBodies.end()) {
+    return false;
+  }
+  std::unique_ptr<LateParsedFunBody> lateParsed = std::move(found->second);
+  lateParsedFunBodies.erase(found);
+  ParseLateParsedFunBody(*lateParsed);
+  return true;
+}
+
+void Parser::ParseLateParsedFunBodies() {
+  auto pending = lateParsedFunBodies.takeVector();
+  for (auto &entry : pending) {
+    ParseLateParsedFunBody(*entry.second);
+  }
+}
+
+void Parser::ParseLateParsedFunBody(LateParsedFunBody &lateParsed) {
+  ++numLateParsedFunBodies;
+
+  // Terminate the body with an eof that names the decl, and put the current
+  // token after it so that parsing resumes where it left off.
+  CachedTokens &toks = lateParsed.toks;
+  Token bodyEnd;
+  bodyEnd.startToken();
+  bodyEnd.setKind(tok::eof);
+  bodyEnd.setLocation(toks.back().getEndLoc());
+  bodyEnd.setEofData(lateParsed.funDecl);
+  toks.push_back(bodyEnd);
+  toks.push_back(Tok);
+
+  // The current token is consumed here and again once it comes back after
+  // the body. Keep the delimiter counts from moving twice when it is a
+  // paren, bracket or brace.
+  llvm::SaveAndRestore<unsigned short> savedParenCount(ParenCount);
+  llvm::SaveAndRestore<unsigned short> savedBracketCount(BracketCount);
+  llvm::SaveAndRestore<unsigned short> savedBraceCount(BraceCount);
+
+  lexer.EnterTokenStream(toks);
+  // Drop the current token; it comes back after the body.
+  ConsumeAnyToken(/*consumeCodeCompletionTok=*/true);
+
+  ParseFunBody(lateParsed.funDecl);
+
+  // Skip whatever the body parser left behind, up to our eof.
+  while (Tok.isNot(tok::eof)) {
+    ConsumeAnyToken();
+  }
+  if (Tok.getEofData() == lateParsed.funDecl) {
+    ConsumeAnyToken();
+  }
+}
@@ -1,31 +1,78 @@
 #include "clang/Compile/Parser.h"
 #include "clang/Compile/Parsing.h"
+#include "clang/Sema/Scope.h"
+
+#include "llvm/Support/raw_ostream.h"
 
 using namespace clang;
 
-Parser::Parser(Sema &sema, bool skipFunctionBodies)
-    : lexer(sema.getPreprocessor()), sema(sema),
-      PreferredType(lexer.isCodeCompletionEnabled()),
-      diags(lexer.getDiagnostics()), GreaterThanIsOperator(true),
+Parser::Parser(Sema &sema, const ParserOptions &opts)
+    : Parser(sema, opts, sema.getSourceManager().getMainFileID(), 0,
+             sema.getSourceManager()
+                 .getBufferData(sema.getSourceManager().getMainFileID())
+                 .size()) {}
+
+Parser::Parser(Sema &sema, const ParserOptions &opts, FileID fileID,
+               unsigned beginOffset, unsigned endOffset, Scope *tuScope)
+    : pp(sema.getPreprocessor()),
+      lexer(fileID, pp.getSourceManager(), pp.getIdentifierTable(),
+            pp.getDiagnostics()),
+      sema(sema), PreferredType(pp.isCodeCompletionEnabled()),
+      diags(pp.getDiagnostics()), scopePool(diags), parserOpts(opts),
+      GreaterThanIsOperator(true),
       ColonIsSacred(false), TemplateParameterDepth(0),
       identifierInfoCache(*this) {
 
-  skipFunctionBodies = lexer.isCodeCompletionEnabled() || skipFunctionBodies;
+  parserOpts.skipFunctionBodies |= pp.isCodeCompletionEnabled();
 
   Tok.startToken();
   Tok.setKind(tok::eof);
-  lexer.setCodeCompletionHandler(*this);
+  pp.setCodeCompletionHandler(*this);
+  if (pp.isCodeCompletionEnabled()) {
+    lexer.SetCodeCompletionLoc(pp.getCodeCompletionLoc());
+  }
+  lexer.SetLexRange(beginOffset, endOffset);
+  if (parserOpts.preTokenize) {
+    lexer.PreTokenize(parserOpts.preTokenizeOnThread);
+  }
 
   sema.CurScope = nullptr;
   assert(GetCurScope() == nullptr && "A scope is already active?");
-  EnterScope(Scope::DeclScope);
-  sema.ActOnTranslationUnitScope(GetCurScope());
-  sema.Initialize();
+  if (tuScope) {
+    assert(sema.TUScope == tuScope && "not the translation unit's scope");
+    ownsTUScope = false;
+    PushCurScope(tuScope);
+  } else {
+    EnterScope(Scope::DeclScope);
+    sema.ActOnTranslationUnitScope(GetCurScope());
+    sema.Initialize();
+  }
 
   // Prime the lexer look-ahead.
   ConsumeToken();
 }
-Parser::~Parser() {}
+Parser::~Parser() {
+  // The scopes are owned by the scope pool, which goes away with the parser.
+  sema.CurScope = nullptr;
+  if (ownsTUScope) {
+    sema.TUScope = nullptr;
+  }
+}
+
+void Parser::PrintStats() const {
+  lexer.PrintStats();
+  llvm::errs() << "\n*** Parser Stats:\n";
+  scopePool.PrintStats();
+  llvm::errs() << "  " << numDelayedFunBodies << " fun bodies delayed.\n";
+  llvm::errs() << "  " << numLateParsedFunBodies
+               << " delayed fun bodies parsed.\n";
+  llvm::errs() << "  " << lateParsedFunBodies.size()
+               << " delayed fun bodies never parsed.\n";
+  llvm::errs() << "  " << numMalformedDeclsSkipped
+               << " malformed decls skipped.\n";
+  llvm::errs() << "  " << numExprOperators << " expression operators, "
+               << maxExprStackDepth << " deep at most.\n";
+}
 
 //===----------------------------------------------------------------------===//
 // Scope manipulation
@@ -60,10 +107,50 @@ void Parser::ExitScope() {
   sema.CurScope = oldScope->getParent();
 
   PopCurScope();
+  scopePool.Release(oldScope);
 }
 
 Scope *Parser::CreateScope(unsigned scopeFlags) {
-  return new (sema.getASTContext()) Scope(GetCurScope(), scopeFlags, diags);
+  return scopePool.Acquire(GetCurScope(), scopeFlags);
+}
+
+//===----------------------------------------------------------------------===//
+// ScopePool
+//===----------------------------------------------------------------------===//
+
+ScopePool::ScopePool(DiagnosticsEngine &diags) : diags(diags) {}
+
+ScopePool::~ScopePool() {}
+
+Scope *ScopePool::Acquire(Scope *parent, unsigned scopeFlags) {
+  Scope *scope = nullptr;
+  if (!freeScopes.empty()) {
+    scope = freeScopes.pop_back_val();
+    // Reset everything the previous user left behind.
+    scope->Init(parent, scopeFlags);
+    ++numReused;
+  } else {
+    scopes.push_back(std::make_unique<Scope>(parent, scopeFlags, diags));
+    scope = scopes.back().get();
+    ++numCreated;
+  }
+  maxLive = std::max(maxLive, ++numLive);
+  return scope;
+}
+
+void ScopePool::Release(Scope *scope) {
+  assert(scope && "Releasing a null scope?");
+  assert(numLive && "Scope pool imbalance!");
+  --numLive;
+  freeScopes.push_back(scope);
+}
+
+void ScopePool::PrintStats() const {
+  llvm::errs() << "  " << numCreated << " scopes created.\n";
+  llvm::errs() << "  " << numReused << " scopes reused.\n";
+  llvm::errs() << "  " << maxLive << " scopes live at peak.\n";
+  llvm::errs() << "  " << scopes.size() * sizeof(Scope)
+               << " bytes of scope objects.\n";
 }
 
 /// Set the flags for the current scope to ScopeFlags. If ManageFlags is false,
@@ -202,7 +289,7 @@ bool Parser::ExpectAndConsume(tok::TokenKind ExpectedTok, unsigned DiagID,
     return false;
   }
 
-  SourceLocation EndLoc = lexer.getLocForEndOfToken(PrevTokLocation);
+  SourceLocation EndLoc = pp.getLocForEndOfToken(PrevTokLocation);
   const char *Spelling = nullptr;
   if (EndLoc.isValid())
     Spelling = tok::getPunctuatorSpelling(ExpectedTok);
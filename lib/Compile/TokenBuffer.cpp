@@ -0,0 +1,125 @@
+#include "clang/Compile/TokenBuffer.h"
+
+#include <algorithm>
+
+using namespace clang;
+
+lex::TokenBuffer::TokenBuffer(size_t bufferSize) {
+  // Every token but eof takes at least one byte of the file.
+  size_t maxTokens = bufferSize + 1;
+  chunks.resize(maxTokens / ChunkSize + 1);
+}
+
+lex::TokenBuffer::~TokenBuffer() = default;
+
+void lex::TokenBuffer::Append(tok::TokenKind kind, unsigned short flags,
+                              uint32_t offset, uint32_t length) {
+  unsigned slot = numTokens % ChunkSize;
+  if (slot == 0) {
+    assert(numTokens / ChunkSize < chunks.size() && "token buffer overflow");
+    chunks[numTokens / ChunkSize] = std::make_unique<Chunk>();
+  }
+  assert(flags <= UINT8_MAX && "token flag does not fit the buffer");
+  Chunk &chunk = GetChunk(numTokens);
+  chunk.kinds[slot] = kind;
+  chunk.flags[slot] = flags;
+  chunk.offsets[slot] = offset;
+  if (length >= LongLength) {
+    std::lock_guard<std::mutex> lock(mutex);
+    longLengths.emplace_back(numTokens, length);
+    length = LongLength;
+  }
+  chunk.lengths[slot] = length;
+  ++numTokens;
+}
+
+void lex::TokenBuffer::AddDeferredDiag(const DeferredDiag &diag) {
+  std::lock_guard<std::mutex> lock(mutex);
+  deferredDiags.push_back(diag);
+  numDeferredDiags.store(deferredDiags.size(), std::memory_order_release);
+}
+
+void lex::TokenBuffer::Publish() {
+  {
+    // Stored under the lock so that a reader about to wait cannot miss it.
+    std::lock_guard<std::mutex> lock(mutex);
+    numPublished.store(numTokens, std::memory_order_release);
+  }
+  publishedCond.notify_all();
+}
+
+void lex::TokenBuffer::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    numPublished.store(numTokens, std::memory_order_release);
+    finished.store(true, std::memory_order_release);
+  }
+  publishedCond.notify_all();
+}
+
+bool lex::TokenBuffer::WaitFor(unsigned index) {
+  if (index < GetNumPublished()) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  publishedCond.wait(lock, [&] {
+    return index < numPublished.load(std::memory_order_acquire) ||
+           finished.load(std::memory_order_acquire);
+  });
+  return index < numPublished.load(std::memory_order_acquire);
+}
+
+unsigned lex::TokenBuffer::FindFirstTokenAt(uint32_t offset) {
+  // Wait until the token is published: the last one published is at or
+  // past offset, or there are no more.
+  unsigned numAvailable = GetNumPublished();
+  while ((numAvailable == 0 || GetOffset(numAvailable - 1) < offset) &&
+         WaitFor(numAvailable)) {
+    numAvailable = GetNumPublished();
+  }
+  assert(numAvailable != 0 && "a finished buffer ends with eof");
+
+  // Offsets only grow, so find the chunk by its first offset and then the
+  // token within the chunk.
+  unsigned numChunks = (numAvailable + ChunkSize - 1) / ChunkSize;
+  auto chunkIt = std::partition_point(
+      chunks.begin() + 1, chunks.begin() + numChunks,
+      [&](const std::unique_ptr<Chunk> &chunk) {
+        return chunk->offsets[0] < offset;
+      });
+  unsigned first = (chunkIt - chunks.begin() - 1) * ChunkSize;
+  const Chunk &chunk = GetChunk(first);
+  unsigned size = std::min(numAvailable - first, ChunkSize);
+  const uint32_t *slot =
+      std::lower_bound(chunk.offsets, chunk.offsets + size, offset);
+  return std::min<unsigned>(first + (slot - chunk.offsets), numAvailable - 1);
+}
+
+uint32_t lex::TokenBuffer::GetLongLength(unsigned index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = std::partition_point(
+      longLengths.begin(), longLengths.end(),
+      [&](const std::pair<unsigned, uint32_t> &entry) {
+        return entry.first < index;
+      });
+  assert(it != longLengths.end() && it->first == index &&
+         "no long length recorded for the token");
+  return it->second;
+}
+
+void lex::TokenBuffer::GetDeferredDiags(
+    unsigned first, unsigned index,
+    llvm::SmallVectorImpl<DeferredDiag> &result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (unsigned i = first, e = deferredDiags.size(); i != e; ++i) {
+    if (deferredDiags[i].tokenIndex > index) {
+      break;
+    }
+    result.push_back(deferredDiags[i]);
+  }
+}
+
+size_t lex::TokenBuffer::GetMemorySize() const {
+  size_t numChunks = (GetNumPublished() + ChunkSize - 1) / ChunkSize;
+  return numChunks * sizeof(Chunk) + chunks.capacity() * sizeof(chunks[0]);
+}
@@ -1,3 +1,374 @@
 #include "clang/Core/Diagnostics.h"
+#include "clang/Core/SourceManager.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
 
 using namespace clang;
+
+namespace {
+
+struct DiagInfo final {
+  diags::DiagLevel level;
+  llvm::StringLiteral format;
+};
+
+constexpr DiagInfo diagInfos[] = {
+#define DIAG(Id, Level, Format)                                                \
+  {diags::DiagLevel::Level, llvm::StringLiteral(Format)},
+#include "clang/Core/DiagnosticKinds.def"
+};
+
+static_assert(std::size(diagInfos) == unsigned(diags::DiagID::Count),
+              "DiagnosticKinds.def out of sync with DiagID");
+
+std::atomic<uint64_t> nextEngineID{1};
+
+/// The buffers this thread reports into, keyed by engine ID, most recently
+/// used first. An engine that is gone leaves its entry behind until it is
+/// pushed out; IDs are never reused, so the entry is never looked up again.
+struct ThreadBufferCache final {
+  static constexpr unsigned NumEntries = 8;
+
+  struct Entry final {
+    uint64_t engineID = 0;
+    diags::DiagnosticBuffer *buffer = nullptr;
+  };
+  Entry entries[NumEntries];
+
+  diags::DiagnosticBuffer *Lookup(uint64_t engineID) {
+    for (unsigned i = 0; i != NumEntries; ++i) {
+      if (entries[i].engineID == engineID) {
+        Entry found = entries[i];
+        std::move_backward(entries, entries + i, entries + i + 1);
+        entries[0] = found;
+        return found.buffer;
+      }
+    }
+    return nullptr;
+  }
+
+  void Insert(uint64_t engineID, diags::DiagnosticBuffer *buffer) {
+    std::move_backward(entries, entries + NumEntries - 1,
+                       entries + NumEntries);
+    entries[0] = {engineID, buffer};
+  }
+};
+
+thread_local ThreadBufferCache threadBufferCache;
+
+/// Return alternative \p choice of the '|'-separated \p alternatives,
+/// skipping over nested %select{...} groups.
+llvm::StringRef GetSelectAlternative(llvm::StringRef alternatives,
+                                     uint64_t choice) {
+  unsigned depth = 0;
+  size_t start = 0;
+  for (size_t i = 0, e = alternatives.size(); i != e; ++i) {
+    char c = alternatives[i];
+    if (c == '{') {
+      ++depth;
+    } else if (c == '}') {
+      --depth;
+    } else if (c == '|' && depth == 0) {
+      if (choice == 0) {
+        return alternatives.slice(start, i);
+      }
+      --choice;
+      start = i + 1;
+    }
+  }
+  assert(choice == 0 && "%select index out of range");
+  return alternatives.drop_front(start);
+}
+
+void FormatString(llvm::StringRef format,
+                  llvm::ArrayRef<diags::DiagnosticArgument> args,
+                  llvm::raw_ostream &os) {
+  while (!format.empty()) {
+    size_t percent = format.find('%');
+    os << format.take_front(percent);
+    if (percent == llvm::StringRef::npos) {
+      return;
+    }
+    format = format.drop_front(percent + 1);
+    if (format.consume_front("%")) {
+      os << '%';
+      continue;
+    }
+
+    llvm::StringRef alternatives;
+    bool isSelect = format.consume_front("select{");
+    if (isSelect) {
+      unsigned depth = 1;
+      size_t end = 0;
+      for (; end != format.size(); ++end) {
+        if (format[end] == '{') {
+          ++depth;
+        } else if (format[end] == '}' && --depth == 0) {
+          break;
+        }
+      }
+      alternatives = format.take_front(end);
+      format = format.drop_front(end + 1);
+    }
+
+    assert(!format.empty() && format[0] >= '0' && format[0] <= '9' &&
+           "expected an argument number");
+    unsigned argIndex = format[0] - '0';
+    format = format.drop_front();
+    assert(argIndex < args.size() && "missing diagnostic argument");
+    const diags::DiagnosticArgument &arg = args[argIndex];
+
+    if (isSelect) {
+      FormatString(GetSelectAlternative(alternatives, arg.GetSelectIndex()),
+                   args, os);
+      continue;
+    }
+    switch (arg.GetKind()) {
+    case diags::DiagnosticArgument::Kind::SInt:
+      os << arg.GetSInt();
+      break;
+    case diags::DiagnosticArgument::Kind::UInt:
+      os << arg.GetUInt();
+      break;
+    case diags::DiagnosticArgument::Kind::String:
+      os << arg.GetString();
+      break;
+    }
+  }
+}
+
+} // namespace
+
+uint64_t diags::DiagnosticArgument::GetSelectIndex() const {
+  switch (kind) {
+  case Kind::SInt:
+    assert(sintVal >= 0 && "negative %select index");
+    return sintVal;
+  case Kind::UInt:
+    return uintVal;
+  case Kind::String:
+    break;
+  }
+  llvm_unreachable("a string cannot pick a %select alternative");
+}
+
+diags::DiagnosticConsumer::~DiagnosticConsumer() = default;
+
+void diags::TextDiagnosticPrinter::HandleDiagnostic(
+    const Diagnostic &diag, const DiagnosticEngine &engine) {
+  auto print = [&](const Diagnostic &printed) {
+    if (printed.loc.IsValid()) {
+      engine.GetSourceManager().PrintLoc(printed.loc, os);
+      os << ": ";
+    }
+    llvm::SmallString<128> text;
+    DiagnosticEngine::FormatDiagnostic(printed, text);
+    os << DiagnosticEngine::GetLevelName(printed.level) << ": " << text
+       << '\n';
+  };
+  print(diag);
+  for (const Diagnostic &note : diag.notes) {
+    print(note);
+  }
+}
+
+diags::DiagnosticBuilder::DiagnosticBuilder(DiagnosticEngine *engine,
+                                            DiagnosticBuffer *buffer,
+                                            DiagID id, DiagLevel level,
+                                            src::SourceLocation loc)
+    : engine(engine), buffer(buffer) {
+  diag.id = id;
+  diag.level = level;
+  diag.loc = loc;
+}
+
+diags::DiagnosticBuilder::DiagnosticBuilder(DiagnosticBuilder &&other)
+    : engine(other.engine), buffer(other.buffer),
+      diag(std::move(other.diag)) {
+  other.engine = nullptr;
+}
+
+diags::DiagnosticBuilder::~DiagnosticBuilder() {
+  if (engine) {
+    engine->Commit(buffer, std::move(diag));
+  }
+}
+
+diags::DiagnosticBuilder &diags::DiagnosticBuilder::operator<<(int64_t val) {
+  if (engine) {
+    diag.args.emplace_back(val);
+  }
+  return *this;
+}
+
+diags::DiagnosticBuilder &diags::DiagnosticBuilder::operator<<(uint64_t val) {
+  if (engine) {
+    diag.args.emplace_back(val);
+  }
+  return *this;
+}
+
+diags::DiagnosticBuilder &
+diags::DiagnosticBuilder::operator<<(llvm::StringRef val) {
+  if (engine) {
+    // The caller's string may be gone by the time the text is built.
+    diag.args.emplace_back(buffer->strings.save(val));
+  }
+  return *this;
+}
+
+diags::DiagnosticEngine::DiagnosticEngine(const src::SourceManager &sm,
+                                          DiagnosticConsumer &consumer)
+    : sm(sm), consumer(consumer),
+      engineID(nextEngineID.fetch_add(1, std::memory_order_relaxed)) {
+  for (unsigned i = 0; i != unsigned(DiagID::Count); ++i) {
+    levels[i] = diagInfos[i].level;
+  }
+}
+
+diags::DiagnosticEngine::~DiagnosticEngine() {
+  DiagnosticBuffer *buffer = buffers.load(std::memory_order_acquire);
+  while (buffer) {
+    DiagnosticBuffer *next = buffer->next;
+    delete buffer;
+    buffer = next;
+  }
+}
+
+diags::DiagnosticBuffer *diags::DiagnosticEngine::GetThreadBuffer() {
+  ThreadBufferCache &cache = threadBufferCache;
+  if (DiagnosticBuffer *buffer = cache.Lookup(engineID)) {
+    return buffer;
+  }
+  // The cache may have pushed this engine out while the thread used others;
+  // its buffer is still on the list, and a second one would take the notes
+  // away from the diagnostic they belong to. Only buffers that were already
+  // pushed are walked, and their 'next' links never change.
+  std::thread::id self = std::this_thread::get_id();
+  for (DiagnosticBuffer *buffer = buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    if (buffer->owner == self) {
+      cache.Insert(engineID, buffer);
+      return buffer;
+    }
+  }
+  // First report from this thread: push a new buffer onto the list.
+  auto *buffer = new DiagnosticBuffer();
+  buffer->owner = self;
+  buffer->next = buffers.load(std::memory_order_relaxed);
+  while (!buffers.compare_exchange_weak(buffer->next, buffer,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+  }
+  cache.Insert(engineID, buffer);
+  return buffer;
+}
+
+diags::DiagLevel diags::DiagnosticEngine::GetLevel(DiagID id) const {
+  DiagLevel level = levels[unsigned(id)];
+  if (level == DiagLevel::Warning) {
+    if (ignoreAllWarnings) {
+      return DiagLevel::Ignored;
+    }
+    if (warningsAsErrors) {
+      return DiagLevel::Error;
+    }
+  }
+  return level;
+}
+
+diags::DiagnosticBuilder
+diags::DiagnosticEngine::Report(src::SourceLocation loc, DiagID id) {
+  DiagLevel level = GetLevel(id);
+  DiagnosticBuffer *buffer = GetThreadBuffer();
+  if (level == DiagLevel::Note) {
+    level = buffer->suppressNotes ? DiagLevel::Ignored : level;
+  } else {
+    buffer->suppressNotes = level == DiagLevel::Ignored;
+  }
+  if (level == DiagLevel::Ignored) {
+    return DiagnosticBuilder(nullptr, nullptr, id, level, loc);
+  }
+  return DiagnosticBuilder(this, buffer, id, level, loc);
+}
+
+void diags::DiagnosticEngine::Commit(DiagnosticBuffer *buffer,
+                                     Diagnostic &&diag) {
+  if (diag.level >= DiagLevel::Error) {
+    numErrors.fetch_add(1, std::memory_order_relaxed);
+  } else if (diag.level == DiagLevel::Warning) {
+    numWarnings.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (diag.level == DiagLevel::Note && !buffer->diagnostics.empty()) {
+    buffer->diagnostics.back().notes.push_back(std::move(diag));
+    return;
+  }
+  diag.sequence = buffer->nextSequence++;
+  buffer->diagnostics.push_back(std::move(diag));
+}
+
+void diags::DiagnosticEngine::Flush() {
+  std::vector<Diagnostic> merged;
+  for (DiagnosticBuffer *buffer = buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    std::move(buffer->diagnostics.begin(), buffer->diagnostics.end(),
+              std::back_inserter(merged));
+  }
+
+  // Which thread reported a diagnostic depends on scheduling; where it was
+  // reported does not.
+  llvm::stable_sort(merged, [](const Diagnostic &lhs, const Diagnostic &rhs) {
+    return std::make_tuple(lhs.loc.GetRawEncoding(), lhs.id, lhs.sequence) <
+           std::make_tuple(rhs.loc.GetRawEncoding(), rhs.id, rhs.sequence);
+  });
+  for (const Diagnostic &diag : merged) {
+    consumer.HandleDiagnostic(diag, *this);
+  }
+
+  // The string arguments live in the buffers' allocators; only now that the
+  // consumer is done can they go.
+  merged.clear();
+  for (DiagnosticBuffer *buffer = buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    buffer->diagnostics.clear();
+    buffer->nextSequence = 0;
+    buffer->suppressNotes = false;
+    buffer->allocator.Reset();
+  }
+}
+
+void diags::DiagnosticEngine::FormatDiagnostic(
+    const Diagnostic &diag, llvm::SmallVectorImpl<char> &result) {
+  llvm::raw_svector_ostream os(result);
+  FormatString(GetFormat(diag.id), diag.args, os);
+}
+
+llvm::StringRef diags::DiagnosticEngine::GetFormat(DiagID id) {
+  return diagInfos[unsigned(id)].format;
+}
+
+llvm::StringRef diags::DiagnosticEngine::GetLevelName(DiagLevel level) {
+  switch (level) {
+  case DiagLevel::Ignored:
+    return "ignored";
+  case DiagLevel::Note:
+    return "note";
+  case DiagLevel::Remark:
+    return "remark";
+  case DiagLevel::Warning:
+    return "warning";
+  case DiagLevel::Error:
+    return "error";
+  case DiagLevel::Fatal:
+    return "fatal error";
+  }
+  llvm_unreachable("invalid diagnostic level");
+}
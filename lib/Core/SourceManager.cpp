@@ -0,0 +1,233 @@
+#include "clang/Core/SourceManager.h"
+
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace clang;
+
+src::SourceManager::~SourceManager() = default;
+
+src::BufferID
+src::SourceManager::AddBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  uint64_t size = buffer->getBufferSize();
+  // The end of the buffer is a location too, hence the extra position.
+  if (nextBase + size + 1 > std::numeric_limits<uint32_t>::max()) {
+    llvm::report_fatal_error("ran out of source locations");
+  }
+  SrcBuffer &srcBuffer = buffers.emplace_back();
+  srcBuffer.buffer = std::move(buffer);
+  srcBuffer.base = nextBase;
+  nextBase += size + 1;
+  return buffers.size();
+}
+
+llvm::ErrorOr<src::BufferID> src::SourceManager::AddFile(llvm::StringRef path) {
+  auto bufferOrErr = llvm::MemoryBuffer::getFile(
+      path, /*IsText=*/false, /*RequiresNullTerminator=*/true);
+  if (!bufferOrErr) {
+    return bufferOrErr.getError();
+  }
+  return AddBuffer(std::move(*bufferOrErr));
+}
+
+src::BufferID src::SourceManager::FindBufferID(SourceLocation loc) const {
+  if (loc.IsInvalid()) {
+    return 0;
+  }
+  uint32_t offset = loc.offset;
+  if (lastLookupBufferID != 0 &&
+      GetBuffer(lastLookupBufferID).Contains(offset)) {
+    return lastLookupBufferID;
+  }
+  auto found = std::upper_bound(
+      buffers.begin(), buffers.end(), offset,
+      [](uint32_t offset, const SrcBuffer &buffer) {
+        return offset < buffer.base;
+      });
+  if (found == buffers.begin()) {
+    return 0;
+  }
+  --found;
+  if (!found->Contains(offset)) {
+    return 0;
+  }
+  lastLookupBufferID = (found - buffers.begin()) + 1;
+  return lastLookupBufferID;
+}
+
+src::SourceLocation
+src::SourceManager::GetLocForBufferStart(BufferID bufferID) const {
+  return SourceLocation(GetBuffer(bufferID).base);
+}
+
+src::SourceLocation
+src::SourceManager::GetLocForBufferEnd(BufferID bufferID) const {
+  const SrcBuffer &buffer = GetBuffer(bufferID);
+  return SourceLocation(buffer.base + buffer.GetSize());
+}
+
+src::SourceLocation src::SourceManager::GetLoc(BufferID bufferID,
+                                               uint32_t offset) const {
+  const SrcBuffer &buffer = GetBuffer(bufferID);
+  assert(offset <= buffer.GetSize() && "offset past the end of the buffer");
+  return SourceLocation(buffer.base + offset);
+}
+
+std::pair<src::BufferID, uint32_t>
+src::SourceManager::GetDecomposedLoc(SourceLocation loc) const {
+  BufferID bufferID = FindBufferID(loc);
+  if (bufferID == 0) {
+    return {0, 0};
+  }
+  return {bufferID, loc.offset - GetBuffer(bufferID).base};
+}
+
+llvm::StringRef src::SourceManager::GetBufferData(BufferID bufferID) const {
+  return GetBuffer(bufferID).buffer->getBuffer();
+}
+
+llvm::StringRef src::SourceManager::GetBufferName(BufferID bufferID) const {
+  return GetBuffer(bufferID).buffer->getBufferIdentifier();
+}
+
+const char *src::SourceManager::GetCharacterData(SourceLocation loc) const {
+  auto [bufferID, offset] = GetDecomposedLoc(loc);
+  if (bufferID == 0) {
+    return nullptr;
+  }
+  return GetBufferData(bufferID).data() + offset;
+}
+
+void src::SourceManager::ComputeLineOffsets(
+    llvm::StringRef data, std::vector<uint32_t> &lineOffsets) {
+  lineOffsets.clear();
+  lineOffsets.push_back(0);
+
+  const char *start = data.data();
+  const char *end = start + data.size();
+
+  // "\r\n" is one line break: the '\r' is skipped and the '\n' starts the
+  // next line. A lone '\r' is a line break of its own.
+  auto addLineBreak = [&](const char *lineBreak) {
+    if (*lineBreak == '\r' && lineBreak + 1 != end && lineBreak[1] == '\n') {
+      return;
+    }
+    lineOffsets.push_back(lineBreak + 1 - start);
+  };
+
+  const char *ptr = start;
+#if defined(__SSE2__)
+  // Compare 16 bytes at a time and visit only the bytes that matched.
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriageReturn = _mm_set1_epi8('\r');
+  for (; end - ptr >= 16; ptr += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, newline),
+                     _mm_cmpeq_epi8(chunk, carriageReturn)));
+    while (mask != 0) {
+      addLineBreak(ptr + llvm::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; ptr != end; ++ptr) {
+    if (*ptr == '\n' || *ptr == '\r') {
+      addLineBreak(ptr);
+    }
+  }
+}
+
+unsigned src::SourceManager::FindLineIndex(BufferID bufferID,
+                                           uint32_t offset) const {
+  const SrcBuffer &buffer = GetBuffer(bufferID);
+  if (buffer.lineOffsets.empty()) {
+    ComputeLineOffsets(buffer.buffer->getBuffer(), buffer.lineOffsets);
+  }
+  const std::vector<uint32_t> &lineOffsets = buffer.lineOffsets;
+  ++numLineQueries;
+
+  // Try the few lines from the last query on before searching.
+  if (bufferID == lastQueryBufferID &&
+      offset >= lineOffsets[lastQueryLine]) {
+    constexpr unsigned MaxForwardScan = 8;
+    unsigned line = lastQueryLine;
+    for (unsigned i = 0; i != MaxForwardScan; ++i, ++line) {
+      if (line + 1 == lineOffsets.size() || offset < lineOffsets[line + 1]) {
+        ++numLineCacheHits;
+        lastQueryLine = line;
+        return line;
+      }
+    }
+  }
+
+  auto found =
+      std::upper_bound(lineOffsets.begin(), lineOffsets.end(), offset);
+  unsigned line = (found - lineOffsets.begin()) - 1;
+  lastQueryBufferID = bufferID;
+  lastQueryLine = line;
+  return line;
+}
+
+unsigned src::SourceManager::GetLineNumber(SourceLocation loc) const {
+  return GetLineAndColumn(loc).first;
+}
+
+std::pair<unsigned, unsigned>
+src::SourceManager::GetLineAndColumn(SourceLocation loc) const {
+  auto [bufferID, offset] = GetDecomposedLoc(loc);
+  if (bufferID == 0) {
+    return {0, 0};
+  }
+  unsigned line = FindLineIndex(bufferID, offset);
+  unsigned column = offset - GetBuffer(bufferID).lineOffsets[line];
+  return {line + 1, column + 1};
+}
+
+llvm::StringRef src::SourceManager::GetLineText(SourceLocation loc) const {
+  auto [bufferID, offset] = GetDecomposedLoc(loc);
+  if (bufferID == 0) {
+    return llvm::StringRef();
+  }
+  unsigned line = FindLineIndex(bufferID, offset);
+  const std::vector<uint32_t> &lineOffsets =
+      GetBuffer(bufferID).lineOffsets;
+  llvm::StringRef data = GetBufferData(bufferID);
+  uint32_t lineEnd = line + 1 == lineOffsets.size() ? data.size()
+                                                    : lineOffsets[line + 1];
+  return data.slice(lineOffsets[line], lineEnd).rtrim("\r\n");
+}
+
+void src::SourceManager::PrintLoc(SourceLocation loc,
+                                  llvm::raw_ostream &os) const {
+  BufferID bufferID = FindBufferID(loc);
+  if (bufferID == 0) {
+    os << "<invalid loc>";
+    return;
+  }
+  auto [line, column] = GetLineAndColumn(loc);
+  os << GetBufferName(bufferID) << ':' << line << ':' << column;
+}
+
+void src::SourceManager::PrintStats() const {
+  size_t numBytes = 0;
+  unsigned numLineTables = 0;
+  for (const SrcBuffer &buffer : buffers) {
+    numBytes += buffer.GetSize();
+    numLineTables += !buffer.lineOffsets.empty();
+  }
+  llvm::errs() << "\n*** Source Manager Stats:\n";
+  llvm::errs() << "  " << buffers.size() << " buffers, " << numBytes
+               << " bytes, " << nextBase << " locations used.\n";
+  llvm::errs() << "  " << numLineTables << " line tables built.\n";
+  llvm::errs() << "  " << numLineQueries << " line queries, "
+               << numLineCacheHits << " answered near the last one.\n";
+}
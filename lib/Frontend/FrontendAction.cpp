@@ -1179,8 +1179,14 @@ void ASTFrontendAction::ExecuteAction() {
   if (!CI.hasSema())
     CI.createSema(getTranslationUnitKind(), CompletionConsumer);
 
-  clang::ParseAST(CI.getSema(), CI.getFrontendOpts().ShowStats,
-                  CI.getFrontendOpts().SkipFunctionBodies);
+  const FrontendOptions &FrontendOpts = CI.getFrontendOpts();
+  ParserOptions ParserOpts;
+  ParserOpts.skipFunctionBodies = FrontendOpts.SkipFunctionBodies;
+  ParserOpts.preTokenize =
+      FrontendOpts.PreTokenize || FrontendOpts.PreTokenizeOnThread;
+  ParserOpts.preTokenizeOnThread = FrontendOpts.PreTokenizeOnThread;
+  ParserOpts.recoverMalformedDecls = FrontendOpts.RecoverMalformedDecls;
+  clang::ParseAST(CI.getSema(), ParserOpts, FrontendOpts.ShowStats);
 }
 
 void PluginASTAction::anchor() {}
@@ -3,7 +3,7 @@
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/ExternalASTSource.h"
 #include "clang/AST/Stmt.h"
-#include "clang/Parse/Parser.h"
+#include "clang/Compile/Parser.h"
 #include "clang/Sema/CodeCompleteConsumer.h"
 #include "clang/Sema/EnterExpressionEvaluationContext.h"
 #include "clang/Sema/Sema.h"
@@ -33,6 +33,13 @@ void clang::ParseAST(Preprocessor &lexer, ASTConsumer *astConsumer,
 }
 
 void clang::ParseAST(Sema &sema, bool printStats, bool skipFunctionBodies) {
+  ParserOptions parserOpts;
+  parserOpts.skipFunctionBodies = skipFunctionBodies;
+  clang::ParseAST(sema, parserOpts, printStats);
+}
+
+void clang::ParseAST(Sema &sema, const ParserOptions &parserOpts,
+                     bool printStats) {
 
   // Collect global stats on Decls/Stmts (until we have a module streamer).
   if (printStats) {
@@ -44,27 +51,36 @@ void clang::ParseAST(Sema &sema, bool printStats, bool skipFunctionBodies) {
   bool OldCollectStats = printStats;
   std::swap(OldCollectStats, sema.CollectStats);
 
+  // The Parser lexes the main file itself; entering it here only sets up the
+  // state that Sema and code completion read from the Preprocessor.
   sema.getPreprocessor().EnterMainSourceFile();
   assert(sema.getPreprocessor().getCurrentLexer());
 
-  Parser parser(sema, skipFunctionBodies);
-
-  llvm::SmallVector<ParserResult<Decl>> topLevelDecls;
-  parser.ParseTopLevelDecls(topLevelDecls);
+  Parser parser(sema, parserOpts);
 
+  // Hand each top-level decl to the consumer as soon as it is parsed so that
+  // code generation overlaps with parsing. Fun bodies are captured unparsed;
+  // one is parsed just before its decl reaches the consumer, unless bodies are
+  // being skipped altogether.
   auto astConsumer = &sema.getASTConsumer();
-  for (auto topLevelDecl : topLevelDecls) {
-    if (topLevelDecl.IsNull()) {
-      return;
-    }
-    astConsumer->HandleTopLevelDecl(
-        sema.ConvertDeclToDeclGroup(topLevelDecl.Get()).get());
+  bool parseFunBodies = !parser.GetParserOptions().skipFunctionBodies;
+  bool parsedAll =
+      parser.ParseTopLevelDecls([&](ParserResult<Decl> &topLevelDecl) {
+        if (parseFunBodies) {
+          parser.ParseLateParsedFunBody(topLevelDecl.Get());
+        }
+        return astConsumer->HandleTopLevelDecl(
+            sema.ConvertDeclToDeclGroup(topLevelDecl.Get()).get());
+      });
+  if (!parsedAll) {
+    return;
   }
   astConsumer->HandleTranslationUnit(sema.getASTContext());
 
   std::swap(OldCollectStats, sema.CollectStats);
   if (printStats) {
     llvm::errs() << "\nSTATISTICS:\n";
+    parser.PrintStats();
     parser.GetSema().PrintStats();
     parser.GetSema().getASTContext().PrintStats();
 
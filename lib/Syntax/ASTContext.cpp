@@ -1,13 +1,78 @@
 #include "clang/Syntax/ASTContext.h"
 #include "clang/Basic/LangOptions.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/Support/raw_ostream.h"
+
 using namespace clang;
 
 void *syn::ASTContextAllocateMem(size_t bytes, const syn::ASTContext &ctx,
-                                 AllocationArena arena, unsigned alignment) {}
+                                 AllocationArena arena, unsigned alignment) {
+  return ctx.Allocate(bytes, alignment, arena);
+}
+
+llvm::BumpPtrAllocator &
+syn::ASTContext::GetAllocator(AllocationArena arena) const {
+  switch (arena) {
+  case AllocationArena::Permanent:
+    return permanentAllocator;
+  case AllocationArena::Temporary:
+    assert(temporaryArena &&
+           "Temporary allocation outside of a constraint solver arena");
+    return temporaryArena->allocator;
+  }
+  llvm_unreachable("Unhandled AllocationArena in switch.");
+}
+
+void *syn::ASTContext::Allocate(size_t bytes, unsigned alignment,
+                                AllocationArena arena) const {
+  if (bytes == 0) {
+    return nullptr;
+  }
+  auto &stats = arenaStats[static_cast<unsigned>(arena)];
+  stats.bytesAllocated += bytes;
+  ++stats.numAllocations;
+  return GetAllocator(arena).Allocate(bytes, llvm::Align(alignment));
+}
+
+void syn::ASTContext::PrintStats() const {
+  auto printArena = [](StringRef name, const AllocationArenaStats &stats) {
+    llvm::errs() << "  " << name << " arena: " << stats.numAllocations
+                 << " allocations, " << stats.bytesAllocated << " bytes";
+    if (stats.numArenas) {
+      llvm::errs() << ", " << stats.numArenas << " arenas, "
+                   << stats.bytesReleased << " bytes released";
+    }
+    llvm::errs() << "\n";
+  };
+  llvm::errs() << "\n*** Syntax ASTContext Stats:\n";
+  printArena("Permanent", GetArenaStats(AllocationArena::Permanent));
+  printArena("Temporary", GetArenaStats(AllocationArena::Temporary));
+  llvm::errs() << "  " << permanentAllocator.getTotalMemory()
+               << " bytes held by the permanent arena.\n";
+}
+
+syn::TemporaryArenaRAII::TemporaryArenaRAII(ASTContext &ctx) : ctx(ctx) {
+  arena.prev = ctx.temporaryArena;
+  ctx.temporaryArena = &arena;
+  ++ctx.arenaStats[static_cast<unsigned>(AllocationArena::Temporary)]
+        .numArenas;
+}
+
+syn::TemporaryArenaRAII::~TemporaryArenaRAII() {
+  assert(ctx.temporaryArena == &arena &&
+         "Temporary arenas released out of order");
+  ctx.arenaStats[static_cast<unsigned>(AllocationArena::Temporary)]
+      .bytesReleased += arena.allocator.getTotalMemory();
+  ctx.temporaryArena = arena.prev;
+}
 
 syn::ASTContext::ASTContext(const LangOptions &langOpts)
     : langOpts(langOpts), identifiers(langOpts) {
 
+#define BUILTIN_TYPE(Id) CreateBuiltinType(TypeKind::Id);
+#include "clang/Syntax/BuiltinType.def"
+
   AddBuiltinType(BuiltinFloat16Type, TypeKind::Float16);
   AddBuiltinType(BuiltinFloat32Type, TypeKind::Float32);
   AddBuiltinType(BuiltinFloat64Type, TypeKind::Float64);
@@ -19,7 +84,258 @@ syn::ASTContext::ASTContext(const LangOptions &langOpts)
   AddBuiltinType(BuiltinInt64Type, TypeKind::Int64);
   AddBuiltinType(BuiltinInt128Type, TypeKind::Int128);
   AddBuiltinType(BuiltinIntType, TypeKind::Int);
+
+  AddBuiltinType(BuiltinUInt8Type, TypeKind::UInt8);
+  AddBuiltinType(BuiltinUInt16Type, TypeKind::UInt16);
+  AddBuiltinType(BuiltinUInt32Type, TypeKind::UInt32);
+  AddBuiltinType(BuiltinUInt64Type, TypeKind::UInt64);
+  AddBuiltinType(BuiltinUInt128Type, TypeKind::UInt128);
+  AddBuiltinType(BuiltinUIntType, TypeKind::UInt);
+
+  AddBuiltinType(BuiltinVoidType, TypeKind::Void);
+  AddBuiltinType(BuiltinNullType, TypeKind::Null);
+  AddBuiltinType(BuiltinBoolType, TypeKind::Bool);
+}
+
+void syn::ASTContext::CreateBuiltinType(TypeKind kind) {
+  auto &builtinType = BuiltinTypes[static_cast<unsigned>(kind)];
+  assert(!builtinType && "Builtin type already created");
+  builtinType = AddType(new (*this) BuiltinType(kind));
+}
+
+void syn::ASTContext::AddBuiltinType(CanType<Type> &canType, TypeKind kind) {
+  canType = GetBuiltinType(kind);
+}
+
+/// The arena for a type built from \p componentTypes: the innermost
+/// temporary arena if any of them is temporary, and the permanent arena
+/// otherwise.
+static syn::AllocationArena
+GetArenaFor(llvm::ArrayRef<syn::QualType> componentTypes) {
+  for (syn::QualType componentType : componentTypes) {
+    if (!componentType.IsNull() &&
+        componentType.GetTypePtr()->IsTemporary()) {
+      return syn::AllocationArena::Temporary;
+    }
+  }
+  return syn::AllocationArena::Permanent;
+}
+
+syn::ASTContext::TypeTables &
+syn::ASTContext::GetTypeTables(AllocationArena arena) const {
+  switch (arena) {
+  case AllocationArena::Permanent:
+    return permanentTypeTables;
+  case AllocationArena::Temporary:
+    assert(temporaryArena &&
+           "Temporary type outside of a constraint solver arena");
+    return temporaryArena->typeTables;
+  }
+  llvm_unreachable("Unhandled AllocationArena in switch.");
+}
+
+size_t syn::ASTContext::GetNumTypes() const {
+  size_t numTypes = permanentTypeTables.types.size();
+  for (TemporaryArena *arena = temporaryArena; arena; arena = arena->prev) {
+    numTypes += arena->typeTables.types.size();
+  }
+  return numTypes;
+}
+
+QualType syn::ASTContext::CreateTypeVariable() const {
+  assert(temporaryArena &&
+         "Type variables only exist inside a constraint solver arena");
+  auto *typeVariable =
+      new (*this, AllocationArena::Temporary)
+          TypeVariableType(temporaryArena->numTypeVariables++);
+  return QualType(AddType(typeVariable, AllocationArena::Temporary), 0);
+}
+
+QualType syn::ASTContext::GetPointerType(QualType pointeeType) const {
+  llvm::FoldingSetNodeID ID;
+  PointerType::Profile(ID, pointeeType);
+
+  AllocationArena arena = GetArenaFor(pointeeType);
+  void *insertPos = nullptr;
+  if (auto *pointerType =
+          FindType(&TypeTables::pointerTypes, ID, arena, insertPos)) {
+    return QualType(pointerType, 0);
+  }
+
+  // If the pointee type isn't canonical, build the canonical pointer first.
+  QualType canType;
+  if (!pointeeType.IsCanonical()) {
+    canType = GetPointerType(pointeeType.GetCanType());
+    // The recursive call may have invalidated the insert position.
+    auto *newPointerType =
+        FindType(&TypeTables::pointerTypes, ID, arena, insertPos);
+    assert(!newPointerType && "Shouldn't be in the map!");
+    (void)newPointerType;
+  }
+  auto *pointerType =
+      AddType(new (*this, arena) PointerType(pointeeType, canType), arena);
+  GetTypeTables(arena).pointerTypes.InsertNode(pointerType, insertPos);
+  return QualType(pointerType, 0);
+}
+
+QualType syn::ASTContext::GetLValueReferenceType(QualType pointeeType) const {
+  llvm::FoldingSetNodeID ID;
+  LValueReferenceType::Profile(ID, pointeeType);
+
+  AllocationArena arena = GetArenaFor(pointeeType);
+  void *insertPos = nullptr;
+  if (auto *referenceType = FindType(&TypeTables::lValueReferenceTypes, ID,
+                                     arena, insertPos)) {
+    return QualType(referenceType, 0);
+  }
+
+  QualType canType;
+  if (!pointeeType.IsCanonical()) {
+    canType = GetLValueReferenceType(pointeeType.GetCanType());
+    auto *newReferenceType = FindType(&TypeTables::lValueReferenceTypes, ID,
+                                      arena, insertPos);
+    assert(!newReferenceType && "Shouldn't be in the map!");
+    (void)newReferenceType;
+  }
+  auto *referenceType = AddType(
+      new (*this, arena) LValueReferenceType(pointeeType, canType), arena);
+  GetTypeTables(arena).lValueReferenceTypes.InsertNode(referenceType,
+                                                       insertPos);
+  return QualType(referenceType, 0);
 }
 
-void syn::ASTContext::AddBuiltinType(const CanType<Type> &canType,
-                                     TypeKind kind) {}
\ No newline at end of file
+QualType syn::ASTContext::GetRValueReferenceType(QualType pointeeType) const {
+  llvm::FoldingSetNodeID ID;
+  RValueReferenceType::Profile(ID, pointeeType);
+
+  AllocationArena arena = GetArenaFor(pointeeType);
+  void *insertPos = nullptr;
+  if (auto *referenceType = FindType(&TypeTables::rValueReferenceTypes, ID,
+                                     arena, insertPos)) {
+    return QualType(referenceType, 0);
+  }
+
+  QualType canType;
+  if (!pointeeType.IsCanonical()) {
+    canType = GetRValueReferenceType(pointeeType.GetCanType());
+    auto *newReferenceType = FindType(&TypeTables::rValueReferenceTypes, ID,
+                                      arena, insertPos);
+    assert(!newReferenceType && "Shouldn't be in the map!");
+    (void)newReferenceType;
+  }
+  auto *referenceType = AddType(
+      new (*this, arena) RValueReferenceType(pointeeType, canType), arena);
+  GetTypeTables(arena).rValueReferenceTypes.InsertNode(referenceType,
+                                                       insertPos);
+  return QualType(referenceType, 0);
+}
+
+QualType
+syn::ASTContext::GetFunType(QualType resultType,
+                            llvm::ArrayRef<QualType> paramTypes) const {
+  llvm::FoldingSetNodeID ID;
+  FunType::Profile(ID, resultType, paramTypes);
+
+  AllocationArena arena = GetArenaFor(resultType);
+  if (arena == AllocationArena::Permanent) {
+    arena = GetArenaFor(paramTypes);
+  }
+  void *insertPos = nullptr;
+  if (auto *funType = FindType(&TypeTables::funTypes, ID, arena, insertPos)) {
+    return QualType(funType, 0);
+  }
+
+  // The fun type is canonical only if the result and all the parameter
+  // types are.
+  bool isCanonical = resultType.IsCanonical() &&
+                     llvm::all_of(paramTypes, [](QualType paramType) {
+                       return paramType.IsCanonical();
+                     });
+  QualType canType;
+  if (!isCanonical) {
+    llvm::SmallVector<QualType, 8> canParamTypes;
+    canParamTypes.reserve(paramTypes.size());
+    for (QualType paramType : paramTypes) {
+      canParamTypes.push_back(paramType.GetCanType());
+    }
+    canType = GetFunType(resultType.GetCanType(), canParamTypes);
+    auto *newFunType = FindType(&TypeTables::funTypes, ID, arena, insertPos);
+    assert(!newFunType && "Shouldn't be in the map!");
+    (void)newFunType;
+  }
+
+  void *mem = Allocate(FunType::totalSizeToAlloc<QualType>(paramTypes.size()),
+                       alignof(FunType), arena);
+  auto *funType =
+      AddType(new (mem) FunType(resultType, paramTypes, canType), arena);
+  GetTypeTables(arena).funTypes.InsertNode(funType, insertPos);
+  return QualType(funType, 0);
+}
+
+QualType syn::ASTContext::GetNominalType(NominalTypeDecl *decl) const {
+  assert(decl && "Passed null for decl");
+  switch (decl->GetKind()) {
+  case DeclKind::Enum:
+    return GetEnumType(static_cast<EnumDecl *>(decl));
+  case DeclKind::Struct:
+    return GetStructType(static_cast<StructDecl *>(decl));
+  case DeclKind::Interface:
+    return GetInterfaceType(static_cast<InterfaceDecl *>(decl));
+  default:
+    llvm_unreachable("Nominal decl without a nominal type node");
+  }
+}
+
+QualType syn::ASTContext::GetEnumType(EnumDecl *decl) const {
+  if (!decl->typeForDecl) {
+    decl->typeForDecl = AddType(new (*this) EnumType(decl));
+  }
+  return QualType(decl->typeForDecl, 0);
+}
+
+QualType syn::ASTContext::GetStructType(StructDecl *decl) const {
+  if (!decl->typeForDecl) {
+    decl->typeForDecl = AddType(new (*this) StructType(decl));
+  }
+  return QualType(decl->typeForDecl, 0);
+}
+
+QualType syn::ASTContext::GetInterfaceType(InterfaceDecl *decl) const {
+  if (!decl->typeForDecl) {
+    decl->typeForDecl = AddType(new (*this) InterfaceType(decl));
+  }
+  return QualType(decl->typeForDecl, 0);
+}
+
+QualType syn::ASTContext::GetAliasType(AliasDecl *decl,
+                                       QualType underlyingType) const {
+  if (!decl->typeForDecl) {
+    // The type is cached on the decl, which outlives any solver.
+    assert(!underlyingType.GetTypePtr()->IsTemporary() &&
+           "alias of a type variable");
+    decl->typeForDecl = AddType(new (*this) AliasType(
+        decl, underlyingType, underlyingType.GetCanType()));
+  }
+  return QualType(decl->typeForDecl, 0);
+}
+
+QualType syn::ASTContext::GetAutoType(QualType deducedType) const {
+  llvm::FoldingSetNodeID ID;
+  AutoType::Profile(ID, deducedType);
+
+  AllocationArena arena = GetArenaFor(deducedType);
+  void *insertPos = nullptr;
+  if (auto *autoType = FindType(&TypeTables::autoTypes, ID, arena, insertPos)) {
+    return QualType(autoType, 0);
+  }
+
+  // A deduced 'auto' is sugar for the type it was deduced as.
+  QualType canType;
+  if (!deducedType.IsNull()) {
+    canType = deducedType.GetCanType();
+  }
+  auto *autoType =
+      AddType(new (*this, arena) AutoType(deducedType, canType), arena);
+  GetTypeTables(arena).autoTypes.InsertNode(autoType, insertPos);
+  return QualType(autoType, 0);
+}
@@ -1 +1,15 @@
-#include "clang/Syntax/Decl.h"
\ No newline at end of file
+#include "clang/Syntax/Decl.h"
+
+using namespace clang;
+
+// Size budgets, in bytes on a 64-bit host. A field that would push a class
+// past its budget belongs in Decl::Bits if it is small enough.
+static_assert(FitsSizeBudget<syn::Decl>(24), "Decl is too big");
+static_assert(FitsSizeBudget<syn::DeclContext>(48), "DeclContext is too big");
+static_assert(FitsSizeBudget<syn::NamedDecl>(32), "NamedDecl is too big");
+static_assert(FitsSizeBudget<syn::ValueDecl>(40), "ValueDecl is too big");
+static_assert(FitsSizeBudget<syn::FunctionDecl>(88),
+              "FunctionDecl is too big");
+static_assert(FitsSizeBudget<syn::TypeDecl>(48), "TypeDecl is too big");
+static_assert(FitsSizeBudget<syn::NominalTypeDecl>(96),
+              "NominalTypeDecl is too big");
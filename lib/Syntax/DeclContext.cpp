@@ -0,0 +1,96 @@
+#include "clang/Syntax/DeclContext.h"
+#include "clang/Syntax/ASTContext.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+using namespace clang;
+
+static unsigned GetLookupHash(DeclarationName name) {
+  return llvm::DenseMapInfo<DeclarationName>::getHashValue(name);
+}
+
+void syn::DeclContext::AddDecl(Decl *decl) {
+  assert(!decl->GetNextDeclInContext() && decl != lastDecl &&
+         "decl is already a member of a context");
+  if (firstDecl) {
+    lastDecl->NextInContextAndBits.setPointer(decl);
+  } else {
+    firstDecl = decl;
+  }
+  lastDecl = decl;
+  ++numDecls;
+
+  auto *namedDecl = llvm::dyn_cast<NamedDecl>(decl);
+  if (!lookupBuckets || !namedDecl || namedDecl->GetName().isEmpty()) {
+    return;
+  }
+  // Keep the load factor at or below 3/4.
+  if ((numLookupEntries + 1) * 4 > numLookupBuckets * 3) {
+    BuildLookupTable(numLookupBuckets * 2);
+    return;
+  }
+  InsertIntoLookupTable(namedDecl);
+}
+
+void syn::DeclContext::Lookup(
+    DeclarationName name, llvm::SmallVectorImpl<NamedDecl *> &results) const {
+  assert(!name.isEmpty() && "looking up an empty name");
+  if (!lookupBuckets && numDecls > LookupTableThreshold) {
+    BuildLookupTable(
+        std::max(16u, unsigned(llvm::NextPowerOf2(numDecls * 4 / 3))));
+  }
+
+  if (!lookupBuckets) {
+    for (Decl *decl : GetDecls()) {
+      auto *namedDecl = llvm::dyn_cast<NamedDecl>(decl);
+      if (namedDecl && namedDecl->GetName() == name) {
+        results.push_back(namedDecl);
+      }
+    }
+    return;
+  }
+
+  unsigned mask = numLookupBuckets - 1;
+  for (unsigned bucket = GetLookupHash(name) & mask;;
+       bucket = (bucket + 1) & mask) {
+    const LookupEntry &entry = lookupBuckets[bucket];
+    if (!entry.decl) {
+      return;
+    }
+    if (entry.name == name) {
+      results.push_back(entry.decl);
+    }
+  }
+}
+
+void syn::DeclContext::BuildLookupTable(unsigned numBuckets) const {
+  assert(llvm::isPowerOf2_32(numBuckets) && "bucket count not a power of 2");
+  lookupBuckets = astContext.Allocate<LookupEntry>(numBuckets);
+  std::uninitialized_fill_n(lookupBuckets, numBuckets, LookupEntry());
+  numLookupBuckets = numBuckets;
+  numLookupEntries = 0;
+
+  // Inserting in member order keeps same-named members in declaration
+  // order along their probe sequence.
+  for (Decl *decl : GetDecls()) {
+    auto *namedDecl = llvm::dyn_cast<NamedDecl>(decl);
+    if (namedDecl && !namedDecl->GetName().isEmpty()) {
+      InsertIntoLookupTable(namedDecl);
+    }
+  }
+}
+
+void syn::DeclContext::InsertIntoLookupTable(NamedDecl *decl) const {
+  assert(numLookupEntries < numLookupBuckets && "lookup table is full");
+  unsigned mask = numLookupBuckets - 1;
+  unsigned bucket = GetLookupHash(decl->GetName()) & mask;
+  while (lookupBuckets[bucket].decl) {
+    bucket = (bucket + 1) & mask;
+  }
+  lookupBuckets[bucket].name = decl->GetName();
+  lookupBuckets[bucket].decl = decl;
+  ++numLookupEntries;
+}
@@ -0,0 +1,335 @@
+#include "clang/Syntax/ModuleInterface.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/DJB.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/OnDiskHashTable.h"
+
+#include <cstring>
+
+using namespace clang;
+using namespace llvm::support;
+
+namespace {
+
+/// NameTableWriterInfo - Emits the name table: each key is a name and its
+/// data the offsets of the records with that name.
+class NameTableWriterInfo final {
+public:
+  using key_type = llvm::StringRef;
+  using key_type_ref = llvm::StringRef;
+  using data_type = llvm::SmallVector<uint32_t, 1>;
+  using data_type_ref = const data_type &;
+  using hash_value_type = uint32_t;
+  using offset_type = uint32_t;
+
+  static hash_value_type ComputeHash(key_type_ref key) {
+    return llvm::djbHash(key);
+  }
+
+  std::pair<offset_type, offset_type>
+  EmitKeyDataLength(llvm::raw_ostream &out, key_type_ref key,
+                    data_type_ref data) {
+    offset_type keyLength = key.size();
+    offset_type dataLength = data.size() * sizeof(uint32_t);
+    assert(keyLength <= UINT16_MAX && dataLength <= UINT16_MAX &&
+           "name table entry too long");
+    endian::Writer writer(out, llvm::endianness::little);
+    writer.write<uint16_t>(keyLength);
+    writer.write<uint16_t>(dataLength);
+    return {keyLength, dataLength};
+  }
+
+  void EmitKey(llvm::raw_ostream &out, key_type_ref key, offset_type) {
+    out << key;
+  }
+
+  void EmitData(llvm::raw_ostream &out, key_type_ref, data_type_ref data,
+                offset_type) {
+    endian::Writer writer(out, llvm::endianness::little);
+    for (uint32_t offset : data) {
+      writer.write<uint32_t>(offset);
+    }
+  }
+};
+
+/// NameTableReaderInfo - Probes the name table in place. The data of a name
+/// is left encoded, as a pointer to its offsets and their count.
+class NameTableReaderInfo final {
+public:
+  using internal_key_type = llvm::StringRef;
+  using external_key_type = llvm::StringRef;
+  using data_type = std::pair<const unsigned char *, unsigned>;
+  using hash_value_type = uint32_t;
+  using offset_type = uint32_t;
+
+  static bool EqualKey(internal_key_type lhs, internal_key_type rhs) {
+    return lhs == rhs;
+  }
+  static internal_key_type GetInternalKey(external_key_type key) {
+    return key;
+  }
+  static hash_value_type ComputeHash(internal_key_type key) {
+    return llvm::djbHash(key);
+  }
+
+  static std::pair<offset_type, offset_type>
+  ReadKeyDataLength(const unsigned char *&data) {
+    offset_type keyLength =
+        endian::readNext<uint16_t, llvm::endianness::little>(data);
+    offset_type dataLength =
+        endian::readNext<uint16_t, llvm::endianness::little>(data);
+    return {keyLength, dataLength};
+  }
+  static internal_key_type ReadKey(const unsigned char *data,
+                                   offset_type length) {
+    return llvm::StringRef(reinterpret_cast<const char *>(data), length);
+  }
+  static data_type ReadData(internal_key_type, const unsigned char *data,
+                            offset_type length) {
+    return {data, unsigned(length / sizeof(uint32_t))};
+  }
+};
+
+llvm::Error MakeInterfaceError(const llvm::MemoryBuffer &buffer,
+                               llvm::StringRef problem) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "'%s' is not a Stone module interface: %s",
+                                 buffer.getBufferIdentifier().str().c_str(),
+                                 problem.str().c_str());
+}
+
+/// Walk every chain of the name table in \p data once, checking that each
+/// lies within [\p chainsBegin, \p tableOffset). OnDiskChainedHashTable
+/// follows the bucket offsets and the key and data lengths as they are.
+bool IsNameTableValid(llvm::StringRef data, uint32_t chainsBegin,
+                      uint32_t tableOffset, uint32_t numBuckets) {
+  const char *buckets = data.data() + tableOffset + 2 * sizeof(uint32_t);
+  for (uint32_t i = 0; i != numBuckets; ++i) {
+    uint32_t bucketOffset = endian::read32le(buckets + i * sizeof(uint32_t));
+    if (bucketOffset == 0) {
+      continue;
+    }
+    if (bucketOffset < chainsBegin || bucketOffset >= tableOffset) {
+      return false;
+    }
+    // A chain is its item count, then each item's hash, key and data
+    // lengths, key and data.
+    llvm::StringRef chain = data.slice(bucketOffset, tableOffset);
+    if (chain.size() < sizeof(uint16_t)) {
+      return false;
+    }
+    unsigned numItems = endian::read16le(chain.data());
+    chain = chain.drop_front(sizeof(uint16_t));
+    for (unsigned j = 0; j != numItems; ++j) {
+      constexpr unsigned ItemHeaderSize =
+          sizeof(uint32_t) + 2 * sizeof(uint16_t);
+      if (chain.size() < ItemHeaderSize) {
+        return false;
+      }
+      unsigned keyLength = endian::read16le(chain.data() + sizeof(uint32_t));
+      unsigned dataLength =
+          endian::read16le(chain.data() + sizeof(uint32_t) + sizeof(uint16_t));
+      chain = chain.drop_front(ItemHeaderSize);
+      if (dataLength % sizeof(uint32_t) != 0 ||
+          keyLength + dataLength > chain.size()) {
+        return false;
+      }
+      chain = chain.drop_front(keyLength + dataLength);
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+class syn::ModuleInterfaceReader::NameTable final {
+public:
+  std::unique_ptr<llvm::OnDiskChainedHashTable<NameTableReaderInfo>> table;
+};
+
+void syn::ModuleInterfaceWriter::AddDecl(DeclKind kind, llvm::StringRef name,
+                                         llvm::StringRef payload) {
+  records.push_back({kind, strings.save(name), strings.save(payload)});
+}
+
+void syn::ModuleInterfaceWriter::AddDecl(const NamedDecl *decl,
+                                         llvm::StringRef payload) {
+  AddDecl(decl->GetKind(), decl->GetName().getAsString(), payload);
+}
+
+void syn::ModuleInterfaceWriter::Emit(llvm::raw_ostream &os) const {
+  // Build the file in memory; the header is patched once the offsets are
+  // known.
+  llvm::SmallString<0> data;
+  llvm::raw_svector_ostream out(data);
+  endian::Writer writer(out, llvm::endianness::little);
+  out.write(module_interface::Magic, sizeof(module_interface::Magic));
+  writer.write<uint32_t>(module_interface::Version);
+  writer.write<uint32_t>(records.size());
+  writer.write<uint32_t>(0);
+  writer.write<uint32_t>(0);
+  assert(data.size() == module_interface::HeaderSize && "header size");
+
+  writer.write<uint32_t>(moduleName.size());
+  out << moduleName;
+
+  uint32_t recordsOffset = data.size();
+  llvm::MapVector<llvm::StringRef, NameTableWriterInfo::data_type>
+      offsetsByName;
+  for (const Record &record : records) {
+    offsetsByName[record.name].push_back(data.size());
+    writer.write<uint8_t>(static_cast<uint8_t>(record.kind));
+    writer.write<uint32_t>(record.name.size());
+    out << record.name;
+    writer.write<uint32_t>(record.payload.size());
+    out << record.payload;
+  }
+
+  llvm::OnDiskChainedHashTableGenerator<NameTableWriterInfo> generator;
+  for (auto &entry : offsetsByName) {
+    generator.insert(entry.first, entry.second);
+  }
+  NameTableWriterInfo info;
+  uint32_t tableOffset = generator.Emit(out, info);
+
+  endian::write32le(&data[12], recordsOffset);
+  endian::write32le(&data[16], tableOffset);
+  os << data;
+}
+
+syn::ModuleInterfaceReader::ModuleInterfaceReader(
+    std::unique_ptr<llvm::MemoryBuffer> buffer)
+    : buffer(std::move(buffer)), nameTable(std::make_unique<NameTable>()) {}
+
+syn::ModuleInterfaceReader::~ModuleInterfaceReader() = default;
+
+llvm::Expected<std::unique_ptr<syn::ModuleInterfaceReader>>
+syn::ModuleInterfaceReader::Open(llvm::StringRef path) {
+  // Large interfaces are mapped rather than read.
+  auto buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    return llvm::createStringError(buffer.getError(),
+                                   "cannot open module interface '%s'",
+                                   path.str().c_str());
+  }
+  return Create(std::move(*buffer));
+}
+
+llvm::Expected<std::unique_ptr<syn::ModuleInterfaceReader>>
+syn::ModuleInterfaceReader::Create(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  llvm::StringRef data = buffer->getBuffer();
+  if (data.size() < module_interface::HeaderSize ||
+      std::memcmp(data.data(), module_interface::Magic,
+                  sizeof(module_interface::Magic)) != 0) {
+    return MakeInterfaceError(*buffer, "bad magic");
+  }
+  const char *header = data.data();
+  if (endian::read32le(header + 4) != module_interface::Version) {
+    return MakeInterfaceError(*buffer, "unsupported version");
+  }
+  uint32_t numDecls = endian::read32le(header + 8);
+  uint32_t recordsOffset = endian::read32le(header + 12);
+  uint32_t tableOffset = endian::read32le(header + 16);
+  // The table starts with its bucket and entry counts. Compare against
+  // what is left of the buffer, since tableOffset + 8 may wrap.
+  constexpr unsigned TableHeaderSize = 2 * sizeof(uint32_t);
+  constexpr unsigned NameOffset = module_interface::HeaderSize;
+  if (recordsOffset < NameOffset + sizeof(uint32_t) ||
+      recordsOffset > tableOffset ||
+      tableOffset > data.size() - TableHeaderSize ||
+      tableOffset % sizeof(uint32_t) != 0) {
+    return MakeInterfaceError(*buffer, "bad offsets");
+  }
+  uint32_t nameLength = endian::read32le(header + NameOffset);
+  if (nameLength > recordsOffset - NameOffset - sizeof(uint32_t)) {
+    return MakeInterfaceError(*buffer, "bad module name");
+  }
+  // OnDiskChainedHashTable masks hashes with the bucket count and reads the
+  // buckets and their chains without checking them. The chains are written
+  // after the records, ahead of the table.
+  uint32_t numBuckets = endian::read32le(header + tableOffset);
+  if (!llvm::isPowerOf2_32(numBuckets) ||
+      numBuckets > (data.size() - tableOffset - TableHeaderSize) /
+                       sizeof(uint32_t) ||
+      !IsNameTableValid(data, recordsOffset, tableOffset, numBuckets)) {
+    return MakeInterfaceError(*buffer, "bad name table");
+  }
+
+  auto *base = reinterpret_cast<const unsigned char *>(data.data());
+  std::unique_ptr<ModuleInterfaceReader> reader(
+      new ModuleInterfaceReader(std::move(buffer)));
+  reader->numDecls = numDecls;
+  reader->recordsOffset = recordsOffset;
+  reader->tableOffset = tableOffset;
+  reader->moduleName = data.substr(NameOffset + sizeof(uint32_t), nameLength);
+  reader->nameTable->table.reset(
+      llvm::OnDiskChainedHashTable<NameTableReaderInfo>::Create(
+          base + tableOffset, base));
+  return std::move(reader);
+}
+
+llvm::Expected<syn::ModuleInterfaceDecl>
+syn::ModuleInterfaceReader::ReadDecl(uint32_t offset) const {
+  // A record is its kind, then the length and bytes of its name and of its
+  // payload. Every length is checked against what is left of the records
+  // before it is used.
+  if (offset < recordsOffset || offset >= tableOffset) {
+    return MakeInterfaceError(*buffer, "record offset out of range");
+  }
+  llvm::StringRef record = buffer->getBuffer().slice(offset, tableOffset);
+  auto readString = [&](llvm::StringRef &str) {
+    if (record.size() < sizeof(uint32_t)) {
+      return false;
+    }
+    uint32_t length = endian::read32le(record.data());
+    record = record.drop_front(sizeof(uint32_t));
+    if (length > record.size()) {
+      return false;
+    }
+    str = record.take_front(length);
+    record = record.drop_front(length);
+    return true;
+  };
+
+  ModuleInterfaceDecl decl;
+  decl.kind = static_cast<DeclKind>(record.front());
+  record = record.drop_front();
+  if (!readString(decl.name) || !readString(decl.payload)) {
+    return MakeInterfaceError(*buffer, "truncated record");
+  }
+  return decl;
+}
+
+llvm::Error syn::ModuleInterfaceReader::Lookup(
+    llvm::StringRef name,
+    llvm::SmallVectorImpl<ModuleInterfaceDecl> &results) const {
+  ++numLookups;
+  auto it = nameTable->table->find(name);
+  if (it == nameTable->table->end()) {
+    return llvm::Error::success();
+  }
+  auto [offsets, numOffsets] = *it;
+  for (unsigned i = 0; i != numOffsets; ++i) {
+    llvm::Expected<ModuleInterfaceDecl> decl = ReadDecl(
+        endian::readNext<uint32_t, llvm::endianness::little>(offsets));
+    if (!decl) {
+      return decl.takeError();
+    }
+    results.push_back(*decl);
+    ++numDeclsRead;
+  }
+  return llvm::Error::success();
+}
+
+void syn::ModuleInterfaceReader::PrintStats() const {
+  llvm::errs() << "\n*** Module Interface Stats for '" << moduleName
+               << "':\n";
+  llvm::errs() << "  " << numDecls << " decls exported, " << numDeclsRead
+               << " read by " << numLookups << " lookups.\n";
+}
@@ -1 +1,21 @@
-#include "clang/Syntax/Type.h"
\ No newline at end of file
+#include "clang/Syntax/Type.h"
+
+using namespace clang;
+
+// Size budgets, in bytes on a 64-bit host. A type is the Bits word and its
+// canonical type plus the pointers of its subclass; a field that would push
+// a class past its budget belongs in Type::Bits.
+static_assert(FitsSizeBudget<syn::Type>(16), "Type is too big");
+static_assert(FitsSizeBudget<syn::BuiltinType>(16), "BuiltinType is too big");
+static_assert(FitsSizeBudget<syn::FunctionType>(24),
+              "FunctionType is too big");
+static_assert(FitsSizeBudget<syn::FunType>(32), "FunType is too big");
+static_assert(FitsSizeBudget<syn::PointerType>(32), "PointerType is too big");
+static_assert(FitsSizeBudget<syn::ReferenceType>(32),
+              "ReferenceType is too big");
+static_assert(FitsSizeBudget<syn::NominalType>(24), "NominalType is too big");
+static_assert(FitsSizeBudget<syn::AliasType>(32), "AliasType is too big");
+static_assert(FitsSizeBudget<syn::DeducedType>(24), "DeducedType is too big");
+static_assert(FitsSizeBudget<syn::AutoType>(32), "AutoType is too big");
+static_assert(FitsSizeBudget<syn::TypeVariableType>(16),
+              "TypeVariableType is too big");
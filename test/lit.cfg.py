@@ -0,0 +1,52 @@
+# -*- Python -*-
+
+import os
+
+import lit.formats
+
+from lit.llvm import llvm_config
+
+# Configuration file for the 'lit' test runner.
+
+# name: The name of this test suite.
+config.name = "Clang"
+
+# testFormat: The test format to use to interpret tests.
+config.test_format = lit.formats.ShTest(not llvm_config.use_lit_shell)
+
+# suffixes: A list of file extensions to treat as test files. Stone sources
+# are .stone files.
+config.suffixes = [".stone", ".test"]
+
+# excludes: A list of directories to exclude from the testsuite. The 'Inputs'
+# subdirectories contain auxiliary inputs for various tests in their parent
+# directories.
+config.excludes = ["Inputs", "CMakeLists.txt", "README.txt", "LICENSE.txt"]
+
+# test_source_root: The root path where tests are located.
+config.test_source_root = os.path.dirname(__file__)
+
+# test_exec_root: The root path where tests should be run.
+config.test_exec_root = os.path.join(config.clang_obj_root, "test")
+
+llvm_config.use_default_substitutions()
+
+llvm_config.use_clang()
+
+config.substitutions.append(("%PATH%", config.environment["PATH"]))
+
+
+# Set available features we allow tests to conditionalize on.
+def calculate_arch_features(arch_string):
+    features = []
+    for arch in arch_string.split():
+        features.append(arch.lower() + "-registered-target")
+    return features
+
+
+llvm_config.feature_config(
+    [
+        ("--assertion-mode", {"ON": "asserts"}),
+        ("--targets-built", calculate_arch_features),
+    ]
+)
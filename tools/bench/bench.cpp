@@ -0,0 +1,544 @@
+/// clang-bench - Measures the throughput of the Stone front-end.
+///
+/// It generates a synthetic Stone corpus of a given shape and size, or takes
+/// existing files, and times lexing, CollectDeclSpec, ParseTopLevelDecls and
+/// Sema separately over each. Every phase runs in a compiler instance of its
+/// own, so that no phase pays for or reuses the state of another. The report
+/// is JSON, one object per corpus, so that a regression shows up as a number
+/// in a diff.
+///
+/// The parser does not build 'enum', 'struct' or 'class' decls yet; it skips
+/// them whole. They are still lexed and their decl specs collected, but the
+/// ParseTopLevelDecls and Sema phases only time the skipping. A corpus
+/// reports how many decls were skipped, and leaves those two phases out when
+/// it built no decl at all.
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Compile/Lexer.h"
+#include "clang/Compile/Parser.h"
+#include "clang/Compile/Parsing.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Sema/Sema.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace clang;
+
+namespace cl = llvm::cl;
+
+enum class CorpusShape {
+  SmallFuns,
+  DeepNesting,
+  LargeEnums,
+  LongMembers,
+  Mixed
+};
+
+static cl::OptionCategory benchCategory("clang-bench options");
+
+static cl::list<std::string>
+    inputFiles(cl::Positional,
+               cl::desc("[<input.stone>...] (default: a generated corpus)"),
+               cl::cat(benchCategory));
+
+static cl::opt<CorpusShape> corpusShape(
+    "shape", cl::desc("The shape of the generated corpus"),
+    cl::values(
+        clEnumValN(CorpusShape::SmallFuns, "small-funs",
+                   "Many small 'fun' decls"),
+        clEnumValN(CorpusShape::DeepNesting, "deep-nesting",
+                   "'fun' bodies with deeply nested blocks and parens"),
+        clEnumValN(CorpusShape::LargeEnums, "large-enums",
+                   "'enum' decls with many enumerators (lexed and "
+                   "collected only; the parser skips them)"),
+        clEnumValN(CorpusShape::LongMembers, "long-members",
+                   "'class' and 'struct' decls with many members (lexed and "
+                   "collected only; the parser skips them)"),
+        clEnumValN(CorpusShape::Mixed, "mixed", "All of the above in turn")),
+    cl::init(CorpusShape::Mixed), cl::cat(benchCategory));
+
+static cl::opt<unsigned>
+    numDecls("decls", cl::desc("Top-level decls in the generated corpus"),
+             cl::init(10000), cl::cat(benchCategory));
+
+static cl::opt<unsigned> declSize(
+    "decl-size",
+    cl::desc("Nesting depth, enumerators or members of each generated decl"),
+    cl::init(32), cl::cat(benchCategory));
+
+static cl::opt<unsigned>
+    numRepeats("repeat",
+               cl::desc("Runs per corpus; each phase reports its fastest"),
+               cl::init(5), cl::cat(benchCategory));
+
+static cl::opt<std::string> outputFile("o", cl::desc("Write the report here"),
+                                       cl::value_desc("file"), cl::init("-"),
+                                       cl::cat(benchCategory));
+
+static cl::opt<std::string>
+    corpusOutputFile("emit-corpus",
+                     cl::desc("Also write the generated corpus here"),
+                     cl::value_desc("file"), cl::cat(benchCategory));
+
+static llvm::StringRef GetShapeName(CorpusShape shape) {
+  switch (shape) {
+  case CorpusShape::SmallFuns:
+    return "small-funs";
+  case CorpusShape::DeepNesting:
+    return "deep-nesting";
+  case CorpusShape::LargeEnums:
+    return "large-enums";
+  case CorpusShape::LongMembers:
+    return "long-members";
+  case CorpusShape::Mixed:
+    return "mixed";
+  }
+  llvm_unreachable("unknown corpus shape");
+}
+
+//===----------------------------------------------------------------------===//
+// Corpus generation
+//===----------------------------------------------------------------------===//
+
+static void GenerateSmallFun(llvm::raw_ostream &os, unsigned i) {
+  os << "fun Small" << i << "(int a, int b) -> int {\n"
+     << "  return a * " << i << " + b;\n"
+     << "}\n\n";
+}
+
+static void GenerateDeepNesting(llvm::raw_ostream &os, unsigned i,
+                                unsigned depth) {
+  os << "fun Nested" << i << "(int x) -> int {\n";
+  for (unsigned d = 0; d != depth; ++d) {
+    os.indent(2 * (d + 1)) << "if (x > " << d << ") {\n";
+  }
+  os.indent(2 * (depth + 1)) << "return ";
+  for (unsigned d = 0; d != depth; ++d) {
+    os << '(';
+  }
+  os << 'x';
+  for (unsigned d = 0; d != depth; ++d) {
+    os << " + " << d << ')';
+  }
+  os << ";\n";
+  for (unsigned d = depth; d != 0; --d) {
+    os.indent(2 * d) << "}\n";
+  }
+  os << "  return 0;\n}\n\n";
+}
+
+static void GenerateLargeEnum(llvm::raw_ostream &os, unsigned i,
+                              unsigned numEnumerators) {
+  os << "enum Enum" << i << " {\n";
+  for (unsigned e = 0; e != numEnumerators; ++e) {
+    os << "  Value" << e << " = " << e << ",\n";
+  }
+  os << "}\n\n";
+}
+
+static void GenerateLongMembers(llvm::raw_ostream &os, unsigned i,
+                                unsigned numMembers) {
+  // Alternate plain-data structs and classes with methods.
+  if (i % 2 == 0) {
+    os << "public struct Struct" << i << " {\n";
+    for (unsigned m = 0; m != numMembers; ++m) {
+      os << "  int field" << m << ";\n";
+    }
+  } else {
+    os << "class Class" << i << " {\n";
+    for (unsigned m = 0; m != numMembers; ++m) {
+      if (m % 2 == 0) {
+        os << "  public int field" << m << ";\n";
+      } else {
+        os << "  public fun Get" << m << "() -> int { return field" << m - 1
+           << "; }\n";
+      }
+    }
+  }
+  os << "}\n\n";
+}
+
+static void GenerateCorpus(llvm::raw_ostream &os, CorpusShape shape,
+                           unsigned count, unsigned size) {
+  static constexpr CorpusShape mixedShapes[] = {
+      CorpusShape::SmallFuns, CorpusShape::DeepNesting,
+      CorpusShape::LargeEnums, CorpusShape::LongMembers};
+
+  for (unsigned i = 0; i != count; ++i) {
+    CorpusShape declShape =
+        shape == CorpusShape::Mixed ? mixedShapes[i % 4] : shape;
+    switch (declShape) {
+    case CorpusShape::SmallFuns:
+      GenerateSmallFun(os, i);
+      break;
+    case CorpusShape::DeepNesting:
+      GenerateDeepNesting(os, i, size);
+      break;
+    case CorpusShape::LargeEnums:
+      GenerateLargeEnum(os, i, size);
+      break;
+    case CorpusShape::LongMembers:
+      GenerateLongMembers(os, i, size);
+      break;
+    case CorpusShape::Mixed:
+      llvm_unreachable("mixed is not the shape of a single decl");
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Phases
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+enum Phase : unsigned {
+  LexPhase,
+  CollectDeclSpecPhase,
+  ParseTopLevelDeclsPhase,
+  SemaPhase,
+  NumPhases
+};
+
+constexpr llvm::StringLiteral phaseNames[NumPhases] = {
+    "lex", "collect-decl-spec", "parse-top-level-decls", "sema"};
+
+/// CorpusResult - What the runs over one corpus measured.
+struct CorpusResult final {
+  /// The fastest time of each phase over all runs, in seconds.
+  double seconds[NumPhases];
+  uint64_t numBytes = 0;
+  unsigned numTokens = 0;
+  /// The top-level decl specs that CollectDeclSpec found.
+  unsigned numDecls = 0;
+  /// The decls that ParseTopLevelDecls built; the others were skipped.
+  unsigned numDeclsParsed = 0;
+  unsigned numFunBodies = 0;
+  unsigned numErrors = 0;
+
+  CorpusResult() {
+    std::fill(std::begin(seconds), std::end(seconds),
+              std::numeric_limits<double>::infinity());
+  }
+};
+
+/// PhaseTimer - Records the wall time of its scope as a run of \p phase,
+/// keeping the fastest run.
+class PhaseTimer final {
+  double &seconds;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  PhaseTimer(CorpusResult &result, Phase phase)
+      : seconds(result.seconds[phase]),
+        start(std::chrono::steady_clock::now()) {}
+
+  ~PhaseTimer() {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    seconds = std::min(seconds, elapsed.count());
+  }
+};
+
+/// BenchAction - Runs one phase over the main file. A phase that needs
+/// what an earlier one produces redoes that work untimed.
+class BenchAction final : public ASTFrontendAction {
+  CorpusResult &result;
+  Phase phase;
+
+  void RunLex();
+  void RunCollectDeclSpec(Parser &parser);
+  void RunParseTopLevelDecls(Parser &parser);
+  void RunSema(Parser &parser);
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &,
+                                                 llvm::StringRef) override {
+    return std::make_unique<ASTConsumer>();
+  }
+
+  void ExecuteAction() override;
+
+public:
+  BenchAction(CorpusResult &result, Phase phase)
+      : result(result), phase(phase) {}
+};
+
+} // namespace
+
+void BenchAction::RunLex() {
+  CompilerInstance &instance = getCompilerInstance();
+  Preprocessor &pp = instance.getPreprocessor();
+  SourceManager &sm = instance.getSourceManager();
+  lex::Lexer lexer(sm.getMainFileID(), sm, pp.getIdentifierTable(),
+                   pp.getDiagnostics());
+  unsigned numTokens = 0;
+  PhaseTimer timer(result, LexPhase);
+  Token tok;
+  for (lexer.Lex(tok); tok.isNot(tok::eof); lexer.Lex(tok)) {
+    ++numTokens;
+  }
+  result.numTokens = numTokens;
+}
+
+void BenchAction::RunCollectDeclSpec(Parser &parser) {
+  // Collect the decl spec of each top-level decl and skip the rest of the
+  // decl, the way that the parser resyncs after a malformed one.
+  unsigned numDecls = 0;
+  PhaseTimer timer(result, CollectDeclSpecPhase);
+  while (!parser.IsEOF()) {
+    if (parser.IsTopLevelDeclSpec()) {
+      ParsingDeclSpec spec(parser);
+      parser.CollectDeclSpec(spec);
+      ++numDecls;
+    }
+    parser.SkipMalformedDecl();
+  }
+  result.numDecls = numDecls;
+}
+
+void BenchAction::RunParseTopLevelDecls(Parser &parser) {
+  unsigned numDeclsParsed = 0;
+  unsigned numFunBodies = 0;
+  PhaseTimer timer(result, ParseTopLevelDeclsPhase);
+  parser.ParseTopLevelDecls([&](ParserResult<Decl> &topLevelDecl) {
+    ++numDeclsParsed;
+    numFunBodies += parser.HasLateParsedFunBody(topLevelDecl.Get());
+    return true;
+  });
+  result.numDeclsParsed = numDeclsParsed;
+  result.numFunBodies = numFunBodies;
+}
+
+void BenchAction::RunSema(Parser &parser) {
+  // Fun bodies are only captured by ParseTopLevelDecls; parsing them is
+  // what hands them to Sema, so it is timed with Sema.
+  parser.ParseTopLevelDecls([](ParserResult<Decl> &) { return true; });
+  PhaseTimer timer(result, SemaPhase);
+  parser.ParseLateParsedFunBodies();
+  getCompilerInstance().getSema().ActOnEndOfTranslationUnit();
+}
+
+void BenchAction::ExecuteAction() {
+  CompilerInstance &instance = getCompilerInstance();
+  SourceManager &sm = instance.getSourceManager();
+  instance.getPreprocessor().EnterMainSourceFile();
+  result.numBytes = sm.getBufferData(sm.getMainFileID()).size();
+  if (phase == LexPhase) {
+    RunLex();
+    return;
+  }
+
+  instance.createSema(getTranslationUnitKind(), nullptr);
+  ParserOptions parserOpts;
+  parserOpts.recoverMalformedDecls = true;
+  Parser parser(instance.getSema(), parserOpts);
+  switch (phase) {
+  case CollectDeclSpecPhase:
+    RunCollectDeclSpec(parser);
+    break;
+  case ParseTopLevelDeclsPhase:
+    RunParseTopLevelDecls(parser);
+    break;
+  case SemaPhase:
+    RunSema(parser);
+    // The whole file has been through the front-end only now.
+    result.numErrors = instance.getDiagnostics().getNumErrors();
+    break;
+  default:
+    llvm_unreachable("not a phase that parses");
+  }
+}
+
+/// GetPeakRSS - The peak resident set size of this process, in bytes, or 0
+/// where that is not known.
+static uint64_t GetPeakRSS() {
+#if LLVM_ON_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+/// RunPhase - Run \p phase over \p fileName once, in a compiler instance
+/// of its own, reading its contents from \p contents instead of the disk
+/// when given.
+static bool RunPhase(llvm::StringRef fileName,
+                     const llvm::MemoryBuffer *contents, Phase phase,
+                     CorpusResult &result) {
+  CompilerInstance instance;
+  instance.createDiagnostics(new IgnoringDiagConsumer(),
+                             /*ShouldOwnClient=*/true);
+  const char *args[] = {"-fsyntax-only", "-x", "c++", fileName.data()};
+  if (!CompilerInvocation::CreateFromArgs(instance.getInvocation(), args,
+                                          instance.getDiagnostics())) {
+    return false;
+  }
+  if (contents) {
+    PreprocessorOptions &ppOpts = instance.getPreprocessorOpts();
+    ppOpts.addRemappedFile(fileName,
+                           const_cast<llvm::MemoryBuffer *>(contents));
+    ppOpts.RetainRemappedFileBuffers = true;
+  }
+  if (!instance.createTarget()) {
+    return false;
+  }
+
+  BenchAction action(result, phase);
+  const FrontendInputFile &input = instance.getFrontendOpts().Inputs[0];
+  if (!action.BeginSourceFile(instance, input)) {
+    return false;
+  }
+  if (llvm::Error err = action.Execute()) {
+    llvm::consumeError(std::move(err));
+    return false;
+  }
+  action.EndSourceFile();
+  return true;
+}
+
+/// RunCorpus - Run every phase over \p fileName once.
+static bool RunCorpus(llvm::StringRef fileName,
+                      const llvm::MemoryBuffer *contents,
+                      CorpusResult &result) {
+  for (unsigned phase = 0; phase != NumPhases; ++phase) {
+    if (!RunPhase(fileName, contents, Phase(phase), result)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void WriteCorpusResult(llvm::json::OStream &json, llvm::StringRef name,
+                              const CorpusResult &result) {
+  json.object([&] {
+    json.attribute("corpus", name);
+    if (inputFiles.empty()) {
+      json.attribute("shape", GetShapeName(corpusShape));
+      json.attribute("decl_size", int64_t(declSize));
+    }
+    json.attribute("bytes", int64_t(result.numBytes));
+    json.attribute("tokens", int64_t(result.numTokens));
+    json.attribute("decls", int64_t(result.numDecls));
+    json.attribute("decls_parsed", int64_t(result.numDeclsParsed));
+    json.attribute("decls_skipped",
+                   int64_t(result.numDecls) - int64_t(result.numDeclsParsed));
+    json.attribute("fun_bodies", int64_t(result.numFunBodies));
+    json.attribute("errors", int64_t(result.numErrors));
+    json.attribute("runs", int64_t(numRepeats));
+    json.attributeArray("phases", [&] {
+      for (unsigned phase = 0; phase != NumPhases; ++phase) {
+        // With no decl built, parsing and Sema timed only the skipping of
+        // the decls the parser does not handle yet.
+        bool parsesDecls =
+            phase == ParseTopLevelDeclsPhase || phase == SemaPhase;
+        if (parsesDecls && result.numDeclsParsed == 0) {
+          continue;
+        }
+        double seconds = result.seconds[phase];
+        unsigned numPhaseDecls =
+            parsesDecls ? result.numDeclsParsed : result.numDecls;
+        json.object([&] {
+          json.attribute("phase", phaseNames[phase]);
+          json.attribute("seconds", seconds);
+          json.attribute("tokens_per_sec",
+                         seconds > 0 ? result.numTokens / seconds : 0.0);
+          json.attribute("decls_per_sec",
+                         seconds > 0 ? numPhaseDecls / seconds : 0.0);
+        });
+      }
+    });
+    // The peak is process wide, so it covers the corpora before this one.
+    json.attribute("peak_rss_bytes", int64_t(GetPeakRSS()));
+  });
+}
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM initLLVM(argc, argv);
+  cl::HideUnrelatedOptions(benchCategory);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Stone front-end throughput benchmark\n");
+
+  // The corpora: the input files, or one generated in memory.
+  std::vector<std::string> corpusNames(inputFiles.begin(), inputFiles.end());
+  std::unique_ptr<llvm::MemoryBuffer> generated;
+  if (corpusNames.empty()) {
+    std::string name = (GetShapeName(corpusShape) + ".stone").str();
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    GenerateCorpus(os, corpusShape, numDecls, declSize);
+    generated = llvm::MemoryBuffer::getMemBufferCopy(text, name);
+    corpusNames.push_back(name);
+
+    if (!corpusOutputFile.empty()) {
+      std::error_code ec;
+      llvm::raw_fd_ostream corpusOS(corpusOutputFile, ec);
+      if (ec) {
+        llvm::errs() << "error: cannot write '" << corpusOutputFile
+                     << "': " << ec.message() << '\n';
+        return 1;
+      }
+      corpusOS << text;
+    }
+  }
+
+  std::error_code ec;
+  llvm::ToolOutputFile output(outputFile, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "error: cannot write '" << outputFile
+                 << "': " << ec.message() << '\n';
+    return 1;
+  }
+
+  bool success = true;
+  llvm::json::OStream json(output.os(), /*IndentSize=*/2);
+  json.object([&] {
+    json.attribute("version", 1);
+    json.attributeArray("results", [&] {
+      for (const std::string &name : corpusNames) {
+        CorpusResult result;
+        unsigned numRuns = std::max(1u, unsigned(numRepeats));
+        bool ran = true;
+        for (unsigned run = 0; ran && run != numRuns; ++run) {
+          ran = RunCorpus(name, generated.get(), result);
+        }
+        if (!ran) {
+          llvm::errs() << "error: cannot run the front-end over '" << name
+                       << "'\n";
+          success = false;
+          continue;
+        }
+        WriteCorpusResult(json, name, result);
+      }
+    });
+  });
+  output.os() << '\n';
+  output.keep();
+  return success ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include "clang/CodeGeneration/CodeGeneration.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Syntax/ASTContext.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/LLVMContext.h"
+
+#include "gtest/gtest.h"
+
+using namespace clang;
+
+namespace {
+
+class CodeGenTypesTest : public ::testing::Test {
+protected:
+  LangOptions langOpts;
+  syn::ASTContext astContext{langOpts};
+  llvm::LLVMContext llvmContext;
+  /// A 64-bit target, so that 'int' is an i64.
+  llvm::DataLayout dataLayout{"e-m:e-p:64:64-i64:64-n8:16:32:64-S128"};
+  codegen::CodeGenTypes types{llvmContext, dataLayout};
+
+  syn::QualType GetBuiltinType(syn::TypeKind kind) {
+    return astContext.GetBuiltinType(kind);
+  }
+
+  llvm::Type *Convert(syn::TypeKind kind) {
+    return types.ConvertType(GetBuiltinType(kind));
+  }
+
+  syn::EnumDecl *CreateEnum(llvm::StringRef name) {
+    return new (astContext) syn::EnumDecl(astContext, /*dc=*/nullptr,
+                                          SourceLocation(),
+                                          astContext.GetIdentifier(name));
+  }
+
+  syn::StructDecl *CreateStruct(llvm::StringRef name) {
+    return new (astContext) syn::StructDecl(astContext, /*dc=*/nullptr,
+                                            SourceLocation(),
+                                            astContext.GetIdentifier(name));
+  }
+
+  const syn::NominalType *GetNominalType(syn::QualType ty) {
+    return llvm::cast<syn::NominalType>(ty.GetTypePtr());
+  }
+};
+
+TEST_F(CodeGenTypesTest, BuiltinsLowerToTheirWidth) {
+  EXPECT_EQ(llvm::Type::getVoidTy(llvmContext), Convert(syn::TypeKind::Void));
+  EXPECT_EQ(llvm::Type::getInt1Ty(llvmContext), Convert(syn::TypeKind::Bool));
+
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext), Convert(syn::TypeKind::Int8));
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext),
+            Convert(syn::TypeKind::UInt8));
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext),
+            Convert(syn::TypeKind::Char8));
+  EXPECT_EQ(llvm::Type::getInt16Ty(llvmContext),
+            Convert(syn::TypeKind::Int16));
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext),
+            Convert(syn::TypeKind::Int32));
+  EXPECT_EQ(llvm::Type::getInt64Ty(llvmContext),
+            Convert(syn::TypeKind::UInt64));
+  EXPECT_EQ(llvm::Type::getInt128Ty(llvmContext),
+            Convert(syn::TypeKind::Int128));
+
+  // 'int' and 'uint' are pointer-sized, and 'char' is a unicode scalar.
+  EXPECT_EQ(llvm::Type::getInt64Ty(llvmContext), Convert(syn::TypeKind::Int));
+  EXPECT_EQ(llvm::Type::getInt64Ty(llvmContext),
+            Convert(syn::TypeKind::UInt));
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext), Convert(syn::TypeKind::Char));
+
+  EXPECT_EQ(llvm::Type::getHalfTy(llvmContext),
+            Convert(syn::TypeKind::Float16));
+  EXPECT_EQ(llvm::Type::getFloatTy(llvmContext),
+            Convert(syn::TypeKind::Float32));
+  EXPECT_EQ(llvm::Type::getDoubleTy(llvmContext),
+            Convert(syn::TypeKind::Float));
+  EXPECT_EQ(llvm::Type::getDoubleTy(llvmContext),
+            Convert(syn::TypeKind::Float64));
+  EXPECT_EQ(llvm::StructType::get(llvm::Type::getDoubleTy(llvmContext),
+                                  llvm::Type::getDoubleTy(llvmContext)),
+            Convert(syn::TypeKind::Complex64));
+
+  EXPECT_EQ(llvm::PointerType::getUnqual(llvmContext),
+            Convert(syn::TypeKind::Null));
+}
+
+TEST_F(CodeGenTypesTest, PointersAndFunsLowerThroughTheirParts) {
+  syn::QualType int32Type = GetBuiltinType(syn::TypeKind::Int32);
+  syn::QualType boolType = GetBuiltinType(syn::TypeKind::Bool);
+  syn::QualType pointerType = astContext.GetPointerType(int32Type);
+
+  // Every pointer is the one opaque pointer type.
+  llvm::Type *ptrType = types.ConvertType(pointerType);
+  EXPECT_EQ(llvm::PointerType::getUnqual(llvmContext), ptrType);
+  EXPECT_EQ(ptrType,
+            types.ConvertType(astContext.GetLValueReferenceType(boolType)));
+
+  syn::QualType funType =
+      astContext.GetFunType(int32Type, {boolType, pointerType});
+  llvm::FunctionType *llvmFunType = types.ConvertFunType(
+      llvm::cast<syn::FunType>(funType.GetTypePtr()));
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext), llvmFunType->getReturnType());
+  ASSERT_EQ(2u, llvmFunType->getNumParams());
+  // A parameter is a value, so a 'bool' one is an i1.
+  EXPECT_EQ(llvm::Type::getInt1Ty(llvmContext), llvmFunType->getParamType(0));
+  EXPECT_EQ(ptrType, llvmFunType->getParamType(1));
+  EXPECT_FALSE(llvmFunType->isVarArg());
+
+  // The lowering is memoized.
+  EXPECT_EQ(llvmFunType, types.ConvertType(funType));
+}
+
+TEST_F(CodeGenTypesTest, BoolIsStoredAsAByte) {
+  syn::QualType boolType = GetBuiltinType(syn::TypeKind::Bool);
+  syn::QualType int32Type = GetBuiltinType(syn::TypeKind::Int32);
+  EXPECT_EQ(llvm::Type::getInt1Ty(llvmContext), types.ConvertType(boolType));
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext),
+            types.ConvertTypeForMem(boolType));
+  // Nothing else changes in memory.
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext),
+            types.ConvertTypeForMem(int32Type));
+
+  // Members are laid out as they are stored.
+  syn::QualType flagsType = astContext.GetStructType(CreateStruct("Flags"));
+  types.CompleteNominalType(GetNominalType(flagsType), {boolType, int32Type});
+  auto *flagsStruct =
+      llvm::cast<llvm::StructType>(types.ConvertType(flagsType));
+  ASSERT_EQ(2u, flagsStruct->getNumElements());
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext), flagsStruct->getElementType(0));
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext),
+            flagsStruct->getElementType(1));
+}
+
+TEST_F(CodeGenTypesTest, EnumsLowerThroughTheirIntegerType) {
+  syn::EnumDecl *byteEnum = CreateEnum("Byte");
+  byteEnum->SetIntegerType(GetBuiltinType(syn::TypeKind::UInt8));
+  EXPECT_EQ(llvm::Type::getInt8Ty(llvmContext),
+            types.ConvertType(astContext.GetEnumType(byteEnum)));
+
+  syn::EnumDecl *wideEnum = CreateEnum("Wide");
+  wideEnum->SetIntegerType(GetBuiltinType(syn::TypeKind::Int64));
+  EXPECT_EQ(llvm::Type::getInt64Ty(llvmContext),
+            types.ConvertType(astContext.GetEnumType(wideEnum)));
+
+  // Without a ': type' clause an enum is an int32.
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext),
+            types.ConvertType(astContext.GetEnumType(CreateEnum("Plain"))));
+}
+
+TEST_F(CodeGenTypesTest, SelfReferentialStructUsesItsPlaceholder) {
+  syn::QualType nodeType = astContext.GetStructType(CreateStruct("Node"));
+  const syn::NominalType *node = GetNominalType(nodeType);
+
+  // Until its members are given, a struct is an opaque named type.
+  auto *nodeStruct = llvm::cast<llvm::StructType>(types.ConvertType(nodeType));
+  EXPECT_TRUE(nodeStruct->isOpaque());
+  EXPECT_EQ("struct.Node", nodeStruct->getName());
+
+  // struct Node { int32 value; Node *next; }
+  syn::QualType int32Type = GetBuiltinType(syn::TypeKind::Int32);
+  types.CompleteNominalType(node,
+                            {int32Type, astContext.GetPointerType(nodeType)});
+  EXPECT_EQ(nodeStruct, types.ConvertType(nodeType));
+  EXPECT_FALSE(nodeStruct->isOpaque());
+  ASSERT_EQ(2u, nodeStruct->getNumElements());
+  EXPECT_EQ(llvm::Type::getInt32Ty(llvmContext), nodeStruct->getElementType(0));
+  EXPECT_EQ(llvm::PointerType::getUnqual(llvmContext),
+            nodeStruct->getElementType(1));
+
+  // Completing it again leaves it as it is.
+  types.CompleteNominalType(node, {int32Type});
+  EXPECT_EQ(2u, nodeStruct->getNumElements());
+
+  // A struct that holds a Node by value holds the same named type.
+  syn::QualType listType = astContext.GetStructType(CreateStruct("List"));
+  types.CompleteNominalType(GetNominalType(listType), {nodeType});
+  auto *listStruct = llvm::cast<llvm::StructType>(types.ConvertType(listType));
+  ASSERT_EQ(1u, listStruct->getNumElements());
+  EXPECT_EQ(nodeStruct, listStruct->getElementType(0));
+}
+
+} // namespace
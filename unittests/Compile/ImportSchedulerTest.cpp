@@ -0,0 +1,223 @@
+#include "clang/Compile/ImportScheduler.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+
+class ImportSchedulerTest : public ::testing::Test {
+protected:
+  llvm::SmallString<128> sourceDir;
+
+  /// The modules that have no source, and those whose load fails.
+  llvm::StringSet<> prebuilt;
+  llvm::StringSet<> broken;
+
+  /// The modules in the order they were loaded.
+  std::mutex mutex;
+  std::vector<std::string> loadOrder;
+
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("import-scheduler",
+                                                      sourceDir));
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(sourceDir); }
+
+  std::string GetSourcePath(llvm::StringRef name) {
+    llvm::SmallString<128> path(sourceDir);
+    llvm::sys::path::append(path, name + ".stone");
+    return std::string(path);
+  }
+
+  /// Write the source of module \p name, which imports \p imports.
+  void AddModule(llvm::StringRef name,
+                 llvm::ArrayRef<llvm::StringRef> imports = {}) {
+    std::error_code error;
+    llvm::raw_fd_ostream os(GetSourcePath(name), error);
+    ASSERT_FALSE(error);
+    for (llvm::StringRef import : imports) {
+      os << "import " << import << ";\n";
+    }
+    os << "fun " << name << "() -> int {\n  return 0;\n}\n";
+  }
+
+  ImportScheduler::ModuleSourceLocator GetLocator() {
+    return [this](llvm::StringRef name) -> std::string {
+      if (prebuilt.count(name)) {
+        return "";
+      }
+      return GetSourcePath(name);
+    };
+  }
+
+  /// A loader that gives each module an empty interface of its own name.
+  ImportScheduler::ModuleLoader GetLoader() {
+    return [this](llvm::StringRef name)
+               -> llvm::Expected<std::unique_ptr<syn::ModuleInterfaceReader>> {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        loadOrder.push_back(name.str());
+      }
+      if (broken.count(name)) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "cannot build module '%s'",
+                                       name.str().c_str());
+      }
+      std::string data;
+      llvm::raw_string_ostream os(data);
+      syn::ModuleInterfaceWriter(name).Emit(os);
+      os.flush();
+      return syn::ModuleInterfaceReader::Create(
+          llvm::MemoryBuffer::getMemBufferCopy(data, name));
+    };
+  }
+
+  /// The position of \p name in loadOrder, or loadOrder.size() if it was
+  /// not loaded.
+  size_t GetLoadIndex(llvm::StringRef name) {
+    return llvm::find(loadOrder, name) - loadOrder.begin();
+  }
+
+  /// The number of times \p name was loaded.
+  size_t GetNumLoads(llvm::StringRef name) {
+    return llvm::count(loadOrder, name);
+  }
+};
+
+TEST_F(ImportSchedulerTest, LoadsImportsBeforeImporters) {
+  // A diamond: a imports b and c, which both import d.
+  AddModule("a", {"b", "c"});
+  AddModule("b", {"d"});
+  AddModule("c", {"d"});
+  AddModule("d");
+
+  ImportScheduler scheduler(GetLocator(), GetLoader(), /*numThreads=*/4);
+  scheduler.Import("a");
+  std::string error;
+  const syn::ModuleInterfaceReader *reader = scheduler.Wait("a", &error);
+  ASSERT_NE(nullptr, reader) << error;
+  EXPECT_EQ("a", reader->GetModuleName());
+
+  ASSERT_EQ(4u, loadOrder.size());
+  for (llvm::StringRef name : {"a", "b", "c", "d"}) {
+    EXPECT_EQ(1u, GetNumLoads(name)) << name.str();
+  }
+  EXPECT_LT(GetLoadIndex("d"), GetLoadIndex("b"));
+  EXPECT_LT(GetLoadIndex("d"), GetLoadIndex("c"));
+  EXPECT_LT(GetLoadIndex("b"), GetLoadIndex("a"));
+  EXPECT_LT(GetLoadIndex("c"), GetLoadIndex("a"));
+
+  // Every module below an Import can be waited for.
+  for (llvm::StringRef name : {"b", "c", "d"}) {
+    reader = scheduler.Wait(name);
+    ASSERT_NE(nullptr, reader) << name.str();
+    EXPECT_EQ(name, reader->GetModuleName());
+  }
+}
+
+TEST_F(ImportSchedulerTest, ImportsOfPrebuiltModulesAreNotFollowed) {
+  AddModule("a", {"prebuilt"});
+  // Its source would import a module that does not exist.
+  AddModule("prebuilt", {"missing"});
+  prebuilt.insert("prebuilt");
+
+  ImportScheduler scheduler(GetLocator(), GetLoader());
+  scheduler.Import("a");
+  std::string error;
+  EXPECT_NE(nullptr, scheduler.Wait("a", &error)) << error;
+  EXPECT_NE(nullptr, scheduler.Wait("prebuilt", &error)) << error;
+  EXPECT_EQ(0u, GetNumLoads("missing"));
+}
+
+TEST_F(ImportSchedulerTest, FailedLoadFailsItsImporters) {
+  AddModule("a", {"b"});
+  AddModule("b", {"c"});
+  AddModule("c");
+  AddModule("other");
+  broken.insert("c");
+
+  ImportScheduler scheduler(GetLocator(), GetLoader());
+  scheduler.Import("a");
+  scheduler.Import("other");
+
+  std::string error;
+  EXPECT_EQ(nullptr, scheduler.Wait("c", &error));
+  EXPECT_EQ("cannot build module 'c'", error);
+  EXPECT_EQ(nullptr, scheduler.Wait("b", &error));
+  EXPECT_EQ("imported module 'c' failed to load", error);
+  EXPECT_EQ(nullptr, scheduler.Wait("a", &error));
+  EXPECT_EQ("imported module 'b' failed to load", error);
+
+  // Unrelated modules load anyway, and the importers fail without being
+  // loaded.
+  EXPECT_NE(nullptr, scheduler.Wait("other"));
+  EXPECT_EQ(0u, GetNumLoads("a"));
+  EXPECT_EQ(0u, GetNumLoads("b"));
+}
+
+TEST_F(ImportSchedulerTest, ImportCycleFailsInsteadOfHanging) {
+  AddModule("a", {"b"});
+  AddModule("b", {"a"});
+
+  ImportScheduler scheduler(GetLocator(), GetLoader());
+  scheduler.Import("a");
+  std::string error;
+  EXPECT_EQ(nullptr, scheduler.Wait("b", &error));
+  EXPECT_EQ("import cycle through module 'a'", error);
+  EXPECT_EQ(nullptr, scheduler.Wait("a", &error));
+  EXPECT_EQ("imported module 'b' failed to load", error);
+}
+
+TEST_F(ImportSchedulerTest, LaterImportsReuseLoadedModules) {
+  AddModule("a", {"shared"});
+  AddModule("b", {"shared"});
+  AddModule("shared");
+
+  ImportScheduler scheduler(GetLocator(), GetLoader());
+  scheduler.Import("a");
+  ASSERT_NE(nullptr, scheduler.Wait("a"));
+
+  // Importing a known module again does nothing, and a new importer of a
+  // loaded module does not wait for it to load again.
+  scheduler.Import("a");
+  scheduler.Import("shared");
+  scheduler.Import("b");
+  ASSERT_NE(nullptr, scheduler.Wait("b"));
+  EXPECT_EQ(1u, GetNumLoads("a"));
+  EXPECT_EQ(1u, GetNumLoads("shared"));
+  EXPECT_EQ(1u, GetNumLoads("b"));
+}
+
+TEST_F(ImportSchedulerTest, SingleThread) {
+  // A chain deeper than the pool is wide.
+  AddModule("m0");
+  for (unsigned i = 1; i != 10; ++i) {
+    std::string import = "m" + std::to_string(i - 1);
+    AddModule("m" + std::to_string(i), {import});
+  }
+
+  ImportScheduler scheduler(GetLocator(), GetLoader(), /*numThreads=*/1);
+  scheduler.Import("m9");
+  std::string error;
+  ASSERT_NE(nullptr, scheduler.Wait("m9", &error)) << error;
+  ASSERT_EQ(10u, loadOrder.size());
+  for (unsigned i = 0; i != 10; ++i) {
+    EXPECT_EQ("m" + std::to_string(i), loadOrder[i]);
+  }
+}
+
+} // namespace
@@ -0,0 +1,317 @@
+#include "clang/Compile/IncrementalReparser.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Sema/Sema.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+
+/// CollectingConsumer - Records each diagnostic as "file:line: message", at
+/// the document position that it is reported at.
+class CollectingConsumer final : public DiagnosticConsumer {
+public:
+  std::vector<std::string> handled;
+
+  void HandleDiagnostic(DiagnosticsEngine::Level level,
+                        const Diagnostic &info) override {
+    DiagnosticConsumer::HandleDiagnostic(level, info);
+    llvm::SmallString<64> message;
+    info.FormatDiagnostic(message);
+    PresumedLoc loc =
+        info.getSourceManager().getPresumedLoc(info.getLocation());
+    handled.push_back((llvm::Twine(loc.getFilename()) + ":" +
+                       llvm::Twine(loc.getLine()) + ": " + message)
+                          .str());
+  }
+};
+
+/// SetUpAction - Sets the compiler up for the document and parses nothing;
+/// the reparser does the parsing.
+class SetUpAction final : public ASTFrontendAction {
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &instance,
+                                                 StringRef inFile) override {
+    return std::make_unique<ASTConsumer>();
+  }
+  void ExecuteAction() override {}
+};
+
+/// Three funs, each three lines long.
+constexpr llvm::StringLiteral ThreeFuns = "fun A() -> int {\n"
+                                          "  return 1;\n"
+                                          "}\n"
+                                          "fun B() -> int {\n"
+                                          "  return 2;\n"
+                                          "}\n"
+                                          "fun C() -> int {\n"
+                                          "  return 3;\n"
+                                          "}\n";
+
+class IncrementalReparserTest : public ::testing::Test {
+protected:
+  CollectingConsumer diagnostics;
+  std::string code;
+  CompilerInstance compiler;
+  SetUpAction action;
+  std::unique_ptr<IncrementalReparser> reparser;
+
+  void TearDown() override {
+    if (reparser) {
+      reparser.reset();
+      action.EndSourceFile();
+    }
+  }
+
+  /// Parse \p document as the main file "test.stone".
+  void Parse(llvm::StringRef document) {
+    code = document.str();
+    auto invocation = std::make_shared<CompilerInvocation>();
+    IntrusiveRefCntPtr<DiagnosticsEngine> argDiags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions());
+    const char *args[] = {"-x", "c++", "test.stone"};
+    ASSERT_TRUE(CompilerInvocation::CreateFromArgs(*invocation, args,
+                                                   *argDiags));
+    FrontendInputFile input(llvm::MemoryBufferRef(code, "test.stone"),
+                            invocation->getFrontendOpts().Inputs[0].getKind());
+    invocation->getFrontendOpts().Inputs = {input};
+
+    compiler.setInvocation(std::move(invocation));
+    compiler.createDiagnostics(&diagnostics, /*ShouldOwnClient=*/false);
+    ASSERT_TRUE(compiler.createTarget());
+    ASSERT_TRUE(action.BeginSourceFile(compiler, input));
+    compiler.createSema(TU_Complete, /*CompletionConsumer=*/nullptr);
+
+    reparser = std::make_unique<IncrementalReparser>(compiler.getSema(),
+                                                     ParserOptions());
+    reparser->Parse();
+  }
+
+  /// Replace the first \p oldText of the document with \p newText, and
+  /// return the names of the decls that were parsed again.
+  std::vector<std::string> Replace(llvm::StringRef oldText,
+                                   llvm::StringRef newText) {
+    size_t offset = reparser->GetText().find(oldText);
+    EXPECT_NE(llvm::StringRef::npos, offset) << oldText;
+    return Edit({unsigned(offset), unsigned(oldText.size()), newText});
+  }
+
+  std::vector<std::string> Edit(const TextEdit &edit) {
+    llvm::SmallVector<Decl *, 4> newDecls;
+    reparser->Reparse(edit, newDecls);
+    return GetNames(newDecls);
+  }
+
+  TranslationUnitDecl *GetTranslationUnit() {
+    return compiler.getASTContext().getTranslationUnitDecl();
+  }
+
+  /// The decls of the translation unit that the document declares, in
+  /// order.
+  std::vector<Decl *> GetDecls() {
+    std::vector<Decl *> decls;
+    for (Decl *decl : GetTranslationUnit()->decls()) {
+      if (!decl->isImplicit()) {
+        decls.push_back(decl);
+      }
+    }
+    return decls;
+  }
+
+  static std::vector<std::string> GetNames(llvm::ArrayRef<Decl *> decls) {
+    std::vector<std::string> names;
+    for (Decl *decl : decls) {
+      auto *namedDecl = dyn_cast<NamedDecl>(decl);
+      names.push_back(namedDecl ? namedDecl->getNameAsString() : "");
+    }
+    return names;
+  }
+
+  std::vector<std::string> GetDeclNames() { return GetNames(GetDecls()); }
+
+  /// The spans of the current decls, which must name the translation
+  /// unit's decls in order and tile the document.
+  llvm::SmallVector<TopLevelDeclSpan, 4> GetSpans() {
+    llvm::SmallVector<TopLevelDeclSpan, 4> spans;
+    reparser->GetTopLevelDeclSpans(spans);
+    std::vector<Decl *> decls = GetDecls();
+    EXPECT_EQ(decls.size(), spans.size());
+    for (size_t i = 0, e = std::min(decls.size(), spans.size()); i != e;
+         ++i) {
+      EXPECT_EQ(decls[i], spans[i].decl) << i;
+      if (i + 1 != e) {
+        EXPECT_EQ(spans[i].endOffset, spans[i + 1].beginOffset) << i;
+      }
+    }
+    return spans;
+  }
+};
+
+TEST_F(IncrementalReparserTest, EditInsideOneDecl) {
+  Parse(ThreeFuns);
+  std::vector<Decl *> before = GetDecls();
+  llvm::SmallVector<TopLevelDeclSpan, 4> spansBefore = GetSpans();
+
+  EXPECT_EQ(std::vector<std::string>{"B"}, Replace("return 2;", "return 20;"));
+  EXPECT_NE(std::string::npos, reparser->GetText().find("return 20;"));
+
+  // The other decls are kept as they are, and the one after the edit moves
+  // by its length.
+  std::vector<Decl *> after = GetDecls();
+  ASSERT_EQ(3u, after.size());
+  EXPECT_EQ(before[0], after[0]);
+  EXPECT_NE(before[1], after[1]);
+  EXPECT_EQ(before[2], after[2]);
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "C"}), GetDeclNames());
+
+  llvm::SmallVector<TopLevelDeclSpan, 4> spans = GetSpans();
+  ASSERT_EQ(3u, spans.size());
+  EXPECT_EQ(spansBefore[0].endOffset, spans[0].endOffset);
+  EXPECT_EQ(spansBefore[2].beginOffset + 1, spans[2].beginOffset);
+  EXPECT_EQ(reparser->GetText().size(), spans[2].endOffset);
+}
+
+TEST_F(IncrementalReparserTest, EditOnABoundaryDirtiesBothDecls) {
+  Parse(ThreeFuns);
+  std::vector<Decl *> before = GetDecls();
+  llvm::SmallVector<TopLevelDeclSpan, 4> spans = GetSpans();
+
+  // The spans tile the document, so the start of B is the end of A.
+  EXPECT_EQ((std::vector<std::string>{"A", "B"}),
+            Edit({spans[1].beginOffset, 0, "\n"}));
+  std::vector<Decl *> after = GetDecls();
+  ASSERT_EQ(3u, after.size());
+  EXPECT_NE(before[0], after[0]);
+  EXPECT_NE(before[1], after[1]);
+  EXPECT_EQ(before[2], after[2]);
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "C"}), GetDeclNames());
+  GetSpans();
+}
+
+TEST_F(IncrementalReparserTest, InsertedTextAddsADecl) {
+  Parse(ThreeFuns);
+  std::vector<Decl *> before = GetDecls();
+  llvm::SmallVector<TopLevelDeclSpan, 4> spans = GetSpans();
+
+  EXPECT_EQ((std::vector<std::string>{"B", "N", "C"}),
+            Edit({spans[2].beginOffset, 0, "fun N() -> int {\n"
+                                           "  return 9;\n"
+                                           "}\n"}));
+
+  // The new decl goes where its text is, not at the end of the translation
+  // unit.
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "N", "C"}), GetDeclNames());
+  EXPECT_EQ(before[0], GetDecls()[0]);
+  EXPECT_EQ(4u, GetSpans().size());
+
+  // And it goes away with its text.
+  spans = GetSpans();
+  EXPECT_EQ((std::vector<std::string>{"B", "C"}),
+            Edit({spans[2].beginOffset,
+                  spans[2].endOffset - spans[2].beginOffset, ""}));
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "C"}), GetDeclNames());
+  EXPECT_EQ(ThreeFuns, reparser->GetText());
+}
+
+TEST_F(IncrementalReparserTest, OverwrittenBufferReparsesItsDecls) {
+  Parse(ThreeFuns);
+
+  // The first edit puts B in the first buffer, and the next ones go to the
+  // others in turn.
+  EXPECT_EQ(std::vector<std::string>{"B"}, Replace("return 2;", "return 4;"));
+  Decl *editedB = GetDecls()[1];
+  EXPECT_EQ(std::vector<std::string>{"C"}, Replace("return 3;", "return 5;"));
+  EXPECT_EQ(std::vector<std::string>{"C"}, Replace("return 5;", "return 6;"));
+  EXPECT_EQ(std::vector<std::string>{"C"}, Replace("return 6;", "return 7;"));
+  Decl *editedC = GetDecls()[2];
+  EXPECT_EQ(editedB, GetDecls()[1]);
+
+  // The fifth edit is back in the first buffer, so B is parsed again from
+  // its new text along with A.
+  EXPECT_EQ((std::vector<std::string>{"A", "B"}),
+            Replace("return 1;", "return 8;"));
+  std::vector<Decl *> after = GetDecls();
+  ASSERT_EQ(3u, after.size());
+  EXPECT_NE(editedB, after[1]);
+  EXPECT_EQ(editedC, after[2]);
+  EXPECT_EQ((std::vector<std::string>{"A", "B", "C"}), GetDeclNames());
+  GetSpans();
+}
+
+TEST_F(IncrementalReparserTest, ReportsTheDiagnosticsOfTheDocument) {
+  std::string document = ThreeFuns.str();
+  document.replace(document.find("return 2;"), 9, "return Missing;");
+  Parse(document);
+  std::vector<std::string> missing = {
+      "test.stone:5: use of undeclared identifier 'Missing'"};
+  EXPECT_EQ(missing, diagnostics.handled);
+  EXPECT_EQ(1u, compiler.getDiagnostics().getNumErrors());
+
+  // An edit elsewhere reports the error of B once more, and only once.
+  diagnostics.handled.clear();
+  Replace("return 3;", "return 30;");
+  EXPECT_EQ(missing, diagnostics.handled);
+  EXPECT_EQ(1u, compiler.getDiagnostics().getNumErrors());
+
+  // An error in a decl parsed from an edit buffer is reported at its line
+  // in the document, after the errors before it.
+  diagnostics.handled.clear();
+  Replace("return 30;", "return Other;");
+  std::vector<std::string> both = {
+      "test.stone:5: use of undeclared identifier 'Missing'",
+      "test.stone:8: use of undeclared identifier 'Other'"};
+  EXPECT_EQ(both, diagnostics.handled);
+  EXPECT_EQ(2u, compiler.getDiagnostics().getNumErrors());
+
+  // Fixing B drops its error.
+  diagnostics.handled.clear();
+  Replace("return Missing;", "return 2;");
+  EXPECT_EQ(std::vector<std::string>{both[1]}, diagnostics.handled);
+  EXPECT_EQ(1u, compiler.getDiagnostics().getNumErrors());
+}
+
+TEST_F(IncrementalReparserTest, MoveTrailingDeclsAfter) {
+  Parse(std::string(ThreeFuns) + "fun D() -> int {\n  return 4;\n}\n");
+  TranslationUnitDecl *tu = GetTranslationUnit();
+  std::vector<Decl *> decls = GetDecls();
+  ASSERT_EQ(4u, decls.size());
+
+  // The run from a decl to the end of the context moves as a whole.
+  tu->moveTrailingDeclsAfter(decls[2], decls[0]);
+  EXPECT_EQ((std::vector<std::string>{"A", "C", "D", "B"}), GetDeclNames());
+
+  // A run already in place stays.
+  tu->moveTrailingDeclsAfter(decls[3], decls[2]);
+  EXPECT_EQ((std::vector<std::string>{"A", "C", "D", "B"}), GetDeclNames());
+
+  // Without a decl to follow, the run moves to the front.
+  tu->moveTrailingDeclsAfter(decls[1], nullptr);
+  EXPECT_EQ((std::vector<std::string>{"B", "A", "C", "D"}), GetDeclNames());
+  EXPECT_EQ(decls[1], *tu->decls_begin());
+
+  // The last decl is still known, so a new decl goes after it.
+  Decl *empty = EmptyDecl::Create(compiler.getASTContext(), tu,
+                                  SourceLocation());
+  tu->addDecl(empty);
+  EXPECT_EQ(empty, GetDecls().back());
+  EXPECT_EQ(decls[3], GetDecls()[3]);
+}
+
+} // namespace
@@ -0,0 +1,267 @@
+#include "clang/Core/Diagnostics.h"
+#include "clang/Core/SourceManager.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+
+/// CollectingConsumer - Records what the engine hands over, as
+/// "offset level: message", with notes indented after their diagnostic.
+class CollectingConsumer final : public diags::DiagnosticConsumer {
+public:
+  std::vector<std::string> handled;
+
+  void HandleDiagnostic(const diags::Diagnostic &diag,
+                        const diags::DiagnosticEngine &engine) override {
+    auto render = [&](const diags::Diagnostic &rendered,
+                      llvm::StringRef indent) {
+      llvm::SmallString<64> text;
+      diags::DiagnosticEngine::FormatDiagnostic(rendered, text);
+      std::string line;
+      llvm::raw_string_ostream os(line);
+      os << indent
+         << engine.GetSourceManager().GetDecomposedLoc(rendered.loc).second
+         << ' ' << diags::DiagnosticEngine::GetLevelName(rendered.level)
+         << ": " << text;
+      handled.push_back(os.str());
+    };
+    render(diag, "");
+    for (const diags::Diagnostic &note : diag.notes) {
+      render(note, "  ");
+    }
+  }
+};
+
+class DiagnosticEngineTest : public ::testing::Test {
+protected:
+  src::SourceManager sm;
+  src::BufferID bufferID;
+  CollectingConsumer consumer;
+
+  DiagnosticEngineTest() {
+    bufferID = sm.AddBuffer(llvm::MemoryBuffer::getMemBufferCopy(
+        std::string(1000, ' '), "test.stone"));
+  }
+
+  src::SourceLocation GetLoc(uint32_t offset) {
+    return sm.GetLoc(bufferID, offset);
+  }
+};
+
+TEST_F(DiagnosticEngineTest, FormatsArguments) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  engine.Report(GetLoc(1), diags::DiagID::err_expected_after)
+      << "'fun'" << "a name";
+  engine.Report(GetLoc(2), diags::DiagID::err_cannot_open_file)
+      << "a.stone" << "no such file";
+  engine.Report(GetLoc(3), diags::DiagID::warn_unused_decl) << 1u << "f";
+  engine.Report(GetLoc(4), diags::DiagID::warn_unused_decl) << 2 << "T";
+  engine.Report(GetLoc(5),
+                diags::DiagID::warn_unterminated_char_or_string)
+      << true;
+  engine.Flush();
+
+  std::vector<std::string> expected = {
+      "1 error: expected a name after 'fun'",
+      "2 error: cannot open file 'a.stone': no such file",
+      "3 warning: unused fun 'f'",
+      "4 warning: unused type 'T'",
+      "5 warning: missing terminating '\"' character",
+  };
+  EXPECT_EQ(expected, consumer.handled);
+}
+
+TEST_F(DiagnosticEngineTest, CopiesStringArguments) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  {
+    std::string name = "temporary";
+    engine.Report(GetLoc(0), diags::DiagID::err_redefinition) << name;
+    name.assign(name.size(), '?');
+  }
+  engine.Flush();
+  ASSERT_EQ(1u, consumer.handled.size());
+  EXPECT_EQ("0 error: redefinition of 'temporary'", consumer.handled[0]);
+}
+
+TEST_F(DiagnosticEngineTest, FlushesInSourceOrder) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  engine.Report(GetLoc(30), diags::DiagID::err_expected_decl);
+  engine.Report(GetLoc(10), diags::DiagID::err_redefinition) << "x";
+  engine.Report(GetLoc(10), diags::DiagID::note_previous_definition);
+  engine.Report(GetLoc(20), diags::DiagID::err_expected_decl);
+  engine.Flush();
+
+  // The note stays with the diagnostic it was reported after.
+  std::vector<std::string> expected = {
+      "10 error: redefinition of 'x'",
+      "  10 note: previous definition is here",
+      "20 error: expected a declaration",
+      "30 error: expected a declaration",
+  };
+  EXPECT_EQ(expected, consumer.handled);
+  EXPECT_EQ(3u, engine.GetNumErrors());
+}
+
+TEST_F(DiagnosticEngineTest, MergesThreadsInSourceOrder) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  constexpr unsigned NumThreads = 8;
+  constexpr unsigned NumPerThread = 100;
+
+  // Thread t reports at t, t + NumThreads, ..., so the threads interleave
+  // in source order however they are scheduled.
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t != NumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (unsigned i = 0; i != NumPerThread; ++i) {
+        unsigned offset = t + i * NumThreads;
+        engine.Report(GetLoc(offset), diags::DiagID::err_redefinition)
+            << std::to_string(offset);
+        engine.Report(GetLoc(offset),
+                      diags::DiagID::note_previous_definition);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(NumThreads * NumPerThread, engine.GetNumErrors());
+  engine.Flush();
+
+  ASSERT_EQ(2 * NumThreads * NumPerThread, consumer.handled.size());
+  for (unsigned offset = 0; offset != NumThreads * NumPerThread; ++offset) {
+    std::string where = std::to_string(offset);
+    EXPECT_EQ(where + " error: redefinition of '" + where + "'",
+              consumer.handled[2 * offset]);
+    EXPECT_EQ("  " + where + " note: previous definition is here",
+              consumer.handled[2 * offset + 1]);
+  }
+}
+
+TEST_F(DiagnosticEngineTest, WarningLevels) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  engine.SetWarningsAsErrors(true);
+  EXPECT_EQ(diags::DiagLevel::Error,
+            engine.GetLevel(diags::DiagID::warn_empty_character));
+  engine.Report(GetLoc(1), diags::DiagID::warn_empty_character);
+
+  // Ignoring all warnings wins over turning them into errors.
+  engine.SetIgnoreAllWarnings(true);
+  EXPECT_EQ(diags::DiagLevel::Ignored,
+            engine.GetLevel(diags::DiagID::warn_empty_character));
+  engine.Report(GetLoc(2), diags::DiagID::warn_empty_character);
+
+  // Errors are never ignored with the warnings.
+  EXPECT_EQ(diags::DiagLevel::Error,
+            engine.GetLevel(diags::DiagID::err_expected_decl));
+  engine.Flush();
+
+  std::vector<std::string> expected = {
+      "1 error: empty character constant",
+  };
+  EXPECT_EQ(expected, consumer.handled);
+  EXPECT_EQ(1u, engine.GetNumErrors());
+  EXPECT_EQ(0u, engine.GetNumWarnings());
+}
+
+TEST_F(DiagnosticEngineTest, IgnoredDiagnosticTakesItsNotes) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  engine.SetLevel(diags::DiagID::err_redefinition, diags::DiagLevel::Ignored);
+  diags::DiagnosticBuilder ignored =
+      engine.Report(GetLoc(1), diags::DiagID::err_redefinition);
+  EXPECT_FALSE(ignored.IsActive());
+  ignored << "x";
+  engine.Report(GetLoc(1), diags::DiagID::note_previous_definition);
+
+  // The next diagnostic that is reported gets its notes again.
+  engine.Report(GetLoc(2), diags::DiagID::warn_empty_character);
+  engine.Report(GetLoc(2), diags::DiagID::note_previous_definition);
+  engine.Flush();
+
+  std::vector<std::string> expected = {
+      "2 warning: empty character constant",
+      "  2 note: previous definition is here",
+  };
+  EXPECT_EQ(expected, consumer.handled);
+  EXPECT_EQ(0u, engine.GetNumErrors());
+  EXPECT_EQ(1u, engine.GetNumWarnings());
+}
+
+TEST_F(DiagnosticEngineTest, FlushEmptiesTheBuffers) {
+  diags::DiagnosticEngine engine(sm, consumer);
+  engine.Report(GetLoc(1), diags::DiagID::err_expected_decl);
+  engine.Flush();
+  engine.Flush();
+  EXPECT_EQ(1u, consumer.handled.size());
+
+  // Counts are not reset by a flush.
+  engine.Report(GetLoc(2), diags::DiagID::err_expected_decl);
+  engine.Flush();
+  EXPECT_EQ(2u, consumer.handled.size());
+  EXPECT_EQ(2u, engine.GetNumErrors());
+}
+
+TEST_F(DiagnosticEngineTest, EnginesDoNotShareBuffers) {
+  // A second engine on the same thread, likely at the address of the
+  // first, must not report into the first one's freed buffer.
+  for (unsigned i = 0; i != 3; ++i) {
+    CollectingConsumer perEngine;
+    diags::DiagnosticEngine engine(sm, perEngine);
+    engine.Report(GetLoc(i), diags::DiagID::err_expected_decl);
+    engine.Flush();
+    ASSERT_EQ(1u, perEngine.handled.size());
+    EXPECT_EQ(std::to_string(i) + " error: expected a declaration",
+              perEngine.handled[0]);
+  }
+}
+
+TEST_F(DiagnosticEngineTest, ThreadMovesBetweenEngines) {
+  // More engines than the thread's cache holds, reported into in turn:
+  // each must keep the one buffer, so every note stays with its error.
+  constexpr unsigned numEngines = 12;
+  std::vector<CollectingConsumer> consumers(numEngines);
+  std::vector<std::unique_ptr<diags::DiagnosticEngine>> engines;
+  for (CollectingConsumer &perEngine : consumers) {
+    engines.push_back(std::make_unique<diags::DiagnosticEngine>(sm, perEngine));
+  }
+  for (unsigned i = 0; i != numEngines; ++i) {
+    engines[i]->Report(GetLoc(i), diags::DiagID::err_redefinition) << "x";
+  }
+  for (unsigned i = 0; i != numEngines; ++i) {
+    engines[i]->Report(GetLoc(i), diags::DiagID::note_previous_definition);
+  }
+  for (unsigned i = 0; i != numEngines; ++i) {
+    engines[i]->Flush();
+    std::vector<std::string> expected = {
+        std::to_string(i) + " error: redefinition of 'x'",
+        "  " + std::to_string(i) + " note: previous definition is here",
+    };
+    EXPECT_EQ(expected, consumers[i].handled);
+  }
+}
+
+TEST_F(DiagnosticEngineTest, TextDiagnosticPrinter) {
+  std::string printed;
+  llvm::raw_string_ostream os(printed);
+  diags::TextDiagnosticPrinter printer(os);
+  diags::DiagnosticEngine engine(sm, printer);
+  engine.Report(GetLoc(4), diags::DiagID::err_redefinition) << "x";
+  engine.Report(GetLoc(1), diags::DiagID::note_previous_definition);
+  engine.Report(src::SourceLocation(), diags::DiagID::err_no_input_files);
+  engine.Flush();
+  EXPECT_EQ("error: no input files\n"
+            "test.stone:1:5: error: redefinition of 'x'\n"
+            "test.stone:1:2: note: previous definition is here\n",
+            os.str());
+}
+
+} // namespace
@@ -0,0 +1,151 @@
+#include "clang/Core/SourceManager.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace clang;
+
+namespace {
+
+class SourceManagerTest : public ::testing::Test {
+protected:
+  src::SourceManager sm;
+
+  src::BufferID AddBuffer(llvm::StringRef text, llvm::StringRef name) {
+    return sm.AddBuffer(llvm::MemoryBuffer::getMemBufferCopy(text, name));
+  }
+
+  std::pair<unsigned, unsigned> GetLineAndColumn(src::BufferID bufferID,
+                                                 uint32_t offset) {
+    return sm.GetLineAndColumn(sm.GetLoc(bufferID, offset));
+  }
+};
+
+TEST_F(SourceManagerTest, BuffersGetDisjointRanges) {
+  src::BufferID first = AddBuffer("abc", "first.stone");
+  src::BufferID second = AddBuffer("", "second.stone");
+  src::BufferID third = AddBuffer("xyz\n", "third.stone");
+  EXPECT_EQ(1u, first);
+  EXPECT_EQ(2u, second);
+  EXPECT_EQ(3u, third);
+  EXPECT_EQ(3u, sm.GetNumBuffers());
+
+  // Every buffer owns its end position, so even an empty one has a
+  // location, and no two buffers share one.
+  EXPECT_LT(sm.GetLocForBufferEnd(first), sm.GetLocForBufferStart(second));
+  EXPECT_EQ(sm.GetLocForBufferStart(second), sm.GetLocForBufferEnd(second));
+  EXPECT_LT(sm.GetLocForBufferEnd(second), sm.GetLocForBufferStart(third));
+
+  for (src::BufferID bufferID : {first, second, third}) {
+    EXPECT_EQ(bufferID, sm.FindBufferID(sm.GetLocForBufferStart(bufferID)));
+    EXPECT_EQ(bufferID, sm.FindBufferID(sm.GetLocForBufferEnd(bufferID)));
+  }
+}
+
+TEST_F(SourceManagerTest, InvalidLocation) {
+  AddBuffer("abc", "a.stone");
+  src::SourceLocation invalid;
+  EXPECT_TRUE(invalid.IsInvalid());
+  EXPECT_EQ(0u, sm.FindBufferID(invalid));
+  EXPECT_EQ(nullptr, sm.GetCharacterData(invalid));
+  EXPECT_EQ(0u, sm.GetLineNumber(invalid));
+  EXPECT_EQ(std::make_pair(0u, 0u), sm.GetLineAndColumn(invalid));
+  EXPECT_TRUE(sm.GetLineText(invalid).empty());
+
+  // Past the last buffer.
+  src::SourceLocation pastEnd = sm.GetLocForBufferEnd(1).GetLocWithOffset(1);
+  EXPECT_EQ(0u, sm.FindBufferID(pastEnd));
+}
+
+TEST_F(SourceManagerTest, DecomposedLocRoundTrips) {
+  AddBuffer("first buffer", "a.stone");
+  src::BufferID bufferID = AddBuffer("second buffer", "b.stone");
+  for (uint32_t offset = 0; offset <= 13; ++offset) {
+    src::SourceLocation loc = sm.GetLoc(bufferID, offset);
+    EXPECT_EQ(std::make_pair(bufferID, offset), sm.GetDecomposedLoc(loc));
+    EXPECT_EQ(loc, src::SourceLocation::GetFromRawEncoding(
+                       loc.GetRawEncoding()));
+  }
+  EXPECT_EQ('s', *sm.GetCharacterData(sm.GetLoc(bufferID, 0)));
+  EXPECT_EQ('b', *sm.GetCharacterData(sm.GetLoc(bufferID, 7)));
+  EXPECT_EQ("b.stone", sm.GetBufferName(bufferID));
+  EXPECT_EQ("second buffer", sm.GetBufferData(bufferID));
+}
+
+TEST_F(SourceManagerTest, LineBreaks) {
+  // "\n", "\r\n" and a lone "\r" each end a line.
+  src::BufferID bufferID = AddBuffer("a\nbc\r\nd\re", "breaks.stone");
+  EXPECT_EQ(std::make_pair(1u, 1u), GetLineAndColumn(bufferID, 0));
+  EXPECT_EQ(std::make_pair(1u, 2u), GetLineAndColumn(bufferID, 1));
+  EXPECT_EQ(std::make_pair(2u, 1u), GetLineAndColumn(bufferID, 2));
+  EXPECT_EQ(std::make_pair(2u, 3u), GetLineAndColumn(bufferID, 4));
+  EXPECT_EQ(std::make_pair(2u, 4u), GetLineAndColumn(bufferID, 5));
+  EXPECT_EQ(std::make_pair(3u, 1u), GetLineAndColumn(bufferID, 6));
+  EXPECT_EQ(std::make_pair(4u, 1u), GetLineAndColumn(bufferID, 8));
+  // The end of the buffer is on the last line.
+  EXPECT_EQ(std::make_pair(4u, 2u), GetLineAndColumn(bufferID, 9));
+
+  EXPECT_EQ("a", sm.GetLineText(sm.GetLoc(bufferID, 0)));
+  EXPECT_EQ("bc", sm.GetLineText(sm.GetLoc(bufferID, 3)));
+  EXPECT_EQ("d", sm.GetLineText(sm.GetLoc(bufferID, 6)));
+  EXPECT_EQ("e", sm.GetLineText(sm.GetLoc(bufferID, 8)));
+}
+
+TEST_F(SourceManagerTest, LineTableOfLongBuffer) {
+  // Long enough that most of it is scanned 16 bytes at a time, with line
+  // breaks of every kind at every position in a chunk, some of them
+  // split across two chunks.
+  std::string text;
+  std::vector<uint32_t> lineStarts = {0};
+  static const char *const lineBreaks[] = {"\n", "\r\n", "\r"};
+  for (unsigned i = 0; i != 200; ++i) {
+    text.append(1 + i % 23, 'x');
+    text += lineBreaks[i % 3];
+    lineStarts.push_back(text.size());
+  }
+  text += "last";
+  src::BufferID bufferID = AddBuffer(text, "long.stone");
+
+  for (unsigned line = 0; line != lineStarts.size(); ++line) {
+    EXPECT_EQ(std::make_pair(line + 1, 1u),
+              GetLineAndColumn(bufferID, lineStarts[line]))
+        << "line " << line + 1;
+  }
+  EXPECT_EQ("last", sm.GetLineText(sm.GetLocForBufferEnd(bufferID)));
+}
+
+TEST_F(SourceManagerTest, QueriesInAnyOrder) {
+  std::string text;
+  for (unsigned i = 0; i != 100; ++i) {
+    text += "line\n";
+  }
+  src::BufferID bufferID = AddBuffer(text, "order.stone");
+
+  // Forward, backward and far jumps all get the same answers, whatever the
+  // last query left in the cache.
+  for (uint32_t line : {0u, 1u, 2u, 50u, 49u, 3u, 99u, 0u, 10u, 18u}) {
+    EXPECT_EQ(std::make_pair(line + 1, 3u),
+              GetLineAndColumn(bufferID, line * 5 + 2));
+  }
+
+  // A query in another buffer does not confuse the next one in this.
+  src::BufferID other = AddBuffer("x\ny\nz\n", "other.stone");
+  EXPECT_EQ(std::make_pair(3u, 1u), GetLineAndColumn(other, 4));
+  EXPECT_EQ(std::make_pair(11u, 1u), GetLineAndColumn(bufferID, 50));
+}
+
+TEST_F(SourceManagerTest, PrintLoc) {
+  src::BufferID bufferID = AddBuffer("fun f() {\n  return;\n}\n", "p.stone");
+  std::string printed;
+  llvm::raw_string_ostream os(printed);
+  sm.PrintLoc(sm.GetLoc(bufferID, 12), os);
+  os << ' ';
+  sm.PrintLoc(src::SourceLocation(), os);
+  EXPECT_EQ("p.stone:2:3 <invalid loc>", os.str());
+}
+
+} // namespace
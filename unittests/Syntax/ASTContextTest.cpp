@@ -0,0 +1,82 @@
+#include "clang/Syntax/ASTContext.h"
+#include "clang/Basic/LangOptions.h"
+
+#include "gtest/gtest.h"
+
+using namespace clang;
+
+namespace {
+
+class ASTContextTest : public ::testing::Test {
+protected:
+  LangOptions langOpts;
+  syn::ASTContext astContext{langOpts};
+};
+
+TEST_F(ASTContextTest, PermanentTypesAreUniqued) {
+  syn::QualType intType = astContext.GetIntType();
+  syn::QualType pointerType = astContext.GetPointerType(intType);
+  EXPECT_EQ(pointerType, astContext.GetPointerType(intType));
+  EXPECT_FALSE(pointerType.GetTypePtr()->IsTemporary());
+  EXPECT_EQ(syn::AllocationArena::Permanent,
+            pointerType.GetTypePtr()->GetArena());
+}
+
+TEST_F(ASTContextTest, TypeVariablesLiveInTheTemporaryArena) {
+  size_t numPermanentTypes = astContext.GetNumTypes();
+  syn::QualType intType = astContext.GetIntType();
+  {
+    syn::TemporaryArenaRAII arena(astContext);
+    syn::QualType first = astContext.CreateTypeVariable();
+    syn::QualType second = astContext.CreateTypeVariable();
+    EXPECT_NE(first, second);
+    EXPECT_TRUE(first.GetTypePtr()->IsTemporary());
+    EXPECT_EQ(0u, llvm::cast<syn::TypeVariableType>(first.GetTypePtr())
+                      ->GetID());
+    EXPECT_EQ(1u, llvm::cast<syn::TypeVariableType>(second.GetTypePtr())
+                      ->GetID());
+
+    // A type built from a type variable is temporary, and uniqued in the
+    // arena; one built from permanent types only is still permanent.
+    syn::QualType pointerType = astContext.GetPointerType(first);
+    EXPECT_TRUE(pointerType.GetTypePtr()->IsTemporary());
+    EXPECT_EQ(pointerType, astContext.GetPointerType(first));
+    syn::QualType funType = astContext.GetFunType(intType, {intType, first});
+    EXPECT_TRUE(funType.GetTypePtr()->IsTemporary());
+    EXPECT_EQ(funType, astContext.GetFunType(intType, {intType, first}));
+    EXPECT_FALSE(
+        astContext.GetFunType(intType, {intType}).GetTypePtr()->IsTemporary());
+    EXPECT_TRUE(astContext.GetAutoType(second).GetTypePtr()->IsTemporary());
+
+    EXPECT_GT(astContext.GetArenaStats(syn::AllocationArena::Temporary)
+                  .numAllocations,
+              0u);
+  }
+  // Only the permanent function type outlives the arena.
+  EXPECT_EQ(numPermanentTypes + 1, astContext.GetNumTypes());
+  EXPECT_GT(
+      astContext.GetArenaStats(syn::AllocationArena::Temporary).bytesReleased,
+      0u);
+}
+
+TEST_F(ASTContextTest, NestedArenasSeeOuterTypes) {
+  syn::TemporaryArenaRAII outer(astContext);
+  syn::QualType typeVariable = astContext.CreateTypeVariable();
+  syn::QualType pointerType = astContext.GetPointerType(typeVariable);
+  size_t numOuterTypes = astContext.GetNumTypes();
+  {
+    syn::TemporaryArenaRAII inner(astContext);
+    // The pointer made in the outer arena is found, not made again.
+    EXPECT_EQ(pointerType, astContext.GetPointerType(typeVariable));
+    EXPECT_EQ(numOuterTypes, astContext.GetNumTypes());
+
+    syn::QualType referenceType =
+        astContext.GetLValueReferenceType(typeVariable);
+    EXPECT_TRUE(referenceType.GetTypePtr()->IsTemporary());
+    EXPECT_EQ(numOuterTypes + 1, astContext.GetNumTypes());
+  }
+  EXPECT_EQ(numOuterTypes, astContext.GetNumTypes());
+  EXPECT_EQ(pointerType, astContext.GetPointerType(typeVariable));
+}
+
+} // namespace
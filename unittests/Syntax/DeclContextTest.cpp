@@ -0,0 +1,181 @@
+#include "clang/Syntax/DeclContext.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Syntax/ASTContext.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace clang;
+
+namespace {
+
+/// A space, the simplest context that is also a decl.
+class TestSpaceDecl final : public syn::NamedDecl, public syn::DeclContext {
+public:
+  TestSpaceDecl(const syn::ASTContext &astContext, DeclarationName name)
+      : syn::NamedDecl(syn::DeclKind::Space, nullptr, SourceLocation(), name),
+        syn::DeclContext(syn::DeclKind::Space, astContext) {}
+};
+
+/// A member that is nothing but its name.
+class TestLabelDecl final : public syn::NamedDecl {
+public:
+  TestLabelDecl(syn::DeclContext *dc, DeclarationName name)
+      : syn::NamedDecl(syn::DeclKind::Label, dc, SourceLocation(), name) {}
+};
+
+class DeclContextTest : public ::testing::Test {
+protected:
+  LangOptions langOpts;
+  syn::ASTContext astContext;
+  TestSpaceDecl *space;
+
+  DeclContextTest()
+      : astContext(langOpts),
+        space(new (astContext)
+                  TestSpaceDecl(astContext, GetName("space"))) {}
+
+  DeclarationName GetName(const llvm::Twine &name) {
+    return astContext.GetIdentifier(name.str());
+  }
+
+  syn::NamedDecl *AddMember(const llvm::Twine &name) {
+    auto *member = new (astContext) TestLabelDecl(space, GetName(name));
+    space->AddDecl(member);
+    return member;
+  }
+
+  std::vector<syn::NamedDecl *> Lookup(const llvm::Twine &name) {
+    llvm::SmallVector<syn::NamedDecl *, 4> results;
+    space->Lookup(GetName(name), results);
+    return std::vector<syn::NamedDecl *>(results.begin(), results.end());
+  }
+};
+
+TEST_F(DeclContextTest, EmptyContext) {
+  EXPECT_TRUE(space->IsEmpty());
+  EXPECT_EQ(0u, space->GetNumDecls());
+  EXPECT_EQ(nullptr, space->GetFirstDecl());
+  EXPECT_EQ(nullptr, space->GetLastDecl());
+  EXPECT_TRUE(space->GetDecls().empty());
+  EXPECT_TRUE(Lookup("a").empty());
+  EXPECT_FALSE(space->HasLookupTable());
+}
+
+TEST_F(DeclContextTest, MembersStayInDeclarationOrder) {
+  std::vector<syn::Decl *> members;
+  for (unsigned i = 0; i != 20; ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+  }
+  EXPECT_FALSE(space->IsEmpty());
+  EXPECT_EQ(20u, space->GetNumDecls());
+  EXPECT_EQ(members.front(), space->GetFirstDecl());
+  EXPECT_EQ(members.back(), space->GetLastDecl());
+  EXPECT_EQ(nullptr, space->GetLastDecl()->GetNextDeclInContext());
+
+  std::vector<syn::Decl *> walked(space->GetDecls().begin(),
+                                  space->GetDecls().end());
+  EXPECT_EQ(members, walked);
+  for (syn::Decl *member : members) {
+    EXPECT_EQ(space, member->GetDeclContext());
+  }
+}
+
+TEST_F(DeclContextTest, SmallContextIsSearchedLinearly) {
+  std::vector<syn::NamedDecl *> members;
+  for (unsigned i = 0; i != syn::DeclContext::LookupTableThreshold; ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+  }
+  for (unsigned i = 0; i != members.size(); ++i) {
+    EXPECT_EQ(std::vector<syn::NamedDecl *>{members[i]},
+              Lookup("m" + llvm::Twine(i)));
+  }
+  EXPECT_TRUE(Lookup("missing").empty());
+  EXPECT_FALSE(space->HasLookupTable());
+}
+
+TEST_F(DeclContextTest, FirstLookupBuildsTheTable) {
+  std::vector<syn::NamedDecl *> members;
+  for (unsigned i = 0; i != syn::DeclContext::LookupTableThreshold + 1;
+       ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+  }
+  // Adding members does not build the table; only a lookup does.
+  EXPECT_FALSE(space->HasLookupTable());
+  EXPECT_TRUE(Lookup("missing").empty());
+  EXPECT_TRUE(space->HasLookupTable());
+
+  for (unsigned i = 0; i != members.size(); ++i) {
+    EXPECT_EQ(std::vector<syn::NamedDecl *>{members[i]},
+              Lookup("m" + llvm::Twine(i)));
+  }
+}
+
+TEST_F(DeclContextTest, AddDeclKeepsTheTableCurrent) {
+  std::vector<syn::NamedDecl *> members;
+  for (unsigned i = 0; i != syn::DeclContext::LookupTableThreshold + 1;
+       ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+  }
+  Lookup("m0");
+  ASSERT_TRUE(space->HasLookupTable());
+
+  // Enough members to outgrow the first table several times over.
+  for (unsigned i = members.size(); i != 200; ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+    EXPECT_EQ(std::vector<syn::NamedDecl *>{members.back()},
+              Lookup("m" + llvm::Twine(i)));
+  }
+  for (unsigned i = 0; i != members.size(); ++i) {
+    EXPECT_EQ(std::vector<syn::NamedDecl *>{members[i]},
+              Lookup("m" + llvm::Twine(i)));
+  }
+  EXPECT_TRUE(Lookup("missing").empty());
+  EXPECT_EQ(200u, space->GetNumDecls());
+}
+
+TEST_F(DeclContextTest, OverloadsComeBackInDeclarationOrder) {
+  std::vector<syn::NamedDecl *> overloads;
+  for (unsigned i = 0; i != 30; ++i) {
+    // Interleave other names, so that the overloads are not adjacent on
+    // the member list or along their probe sequence.
+    if (i % 3 == 0) {
+      overloads.push_back(AddMember("f"));
+    }
+    AddMember("g" + llvm::Twine(i));
+    if (i == 3) {
+      EXPECT_EQ(overloads, Lookup("f"));
+      EXPECT_FALSE(space->HasLookupTable());
+    }
+    if (i == syn::DeclContext::LookupTableThreshold) {
+      EXPECT_EQ(overloads, Lookup("f"));
+      EXPECT_TRUE(space->HasLookupTable());
+    }
+  }
+  EXPECT_EQ(10u, overloads.size());
+  EXPECT_EQ(overloads, Lookup("f"));
+}
+
+TEST_F(DeclContextTest, UnnamedMembersAreNotLookedUp) {
+  syn::NamedDecl *unnamed =
+      new (astContext) TestLabelDecl(space, DeclarationName());
+  space->AddDecl(unnamed);
+  std::vector<syn::NamedDecl *> members;
+  for (unsigned i = 0; i != 2 * syn::DeclContext::LookupTableThreshold;
+       ++i) {
+    members.push_back(AddMember("m" + llvm::Twine(i)));
+  }
+  EXPECT_EQ(unnamed, space->GetFirstDecl());
+  EXPECT_EQ(members.size() + 1, space->GetNumDecls());
+  for (unsigned i = 0; i != members.size(); ++i) {
+    EXPECT_EQ(std::vector<syn::NamedDecl *>{members[i]},
+              Lookup("m" + llvm::Twine(i)));
+  }
+  EXPECT_TRUE(space->HasLookupTable());
+}
+
+} // namespace
@@ -0,0 +1,279 @@
+#include "clang/Syntax/ModuleInterface.h"
+#include "clang/Syntax/Decl.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace clang;
+using namespace llvm::support;
+
+namespace {
+
+/// Where the header of an interface keeps each field.
+enum : unsigned {
+  VersionOffset = 4,
+  RecordsOffsetOffset = 12,
+  TableOffsetOffset = 16,
+  NameLengthOffset = 20,
+};
+
+class ModuleInterfaceTest : public ::testing::Test {
+protected:
+  static std::string Write(const syn::ModuleInterfaceWriter &writer) {
+    std::string data;
+    llvm::raw_string_ostream os(data);
+    writer.Emit(os);
+    os.flush();
+    return data;
+  }
+
+  /// An interface of module "math" with an overloaded name.
+  static std::string WriteMath() {
+    syn::ModuleInterfaceWriter writer("math");
+    writer.AddDecl(syn::DeclKind::Fun, "Add", "int,int");
+    writer.AddDecl(syn::DeclKind::Struct, "Point", "");
+    writer.AddDecl(syn::DeclKind::Fun, "Add", "float,float");
+    writer.AddDecl(syn::DeclKind::Fun, "Sub", "int,int");
+    return Write(writer);
+  }
+
+  static llvm::Expected<std::unique_ptr<syn::ModuleInterfaceReader>>
+  Read(llvm::StringRef data) {
+    return syn::ModuleInterfaceReader::Create(
+        llvm::MemoryBuffer::getMemBufferCopy(data, "math.stni"));
+  }
+
+  /// The error that opening \p data gives, or "" if it opens.
+  static std::string GetReadError(llvm::StringRef data) {
+    auto reader = Read(data);
+    if (reader) {
+      return "";
+    }
+    return llvm::toString(reader.takeError());
+  }
+
+  static std::vector<syn::ModuleInterfaceDecl>
+  Lookup(const syn::ModuleInterfaceReader &reader, llvm::StringRef name) {
+    llvm::SmallVector<syn::ModuleInterfaceDecl, 2> results;
+    llvm::Error error = reader.Lookup(name, results);
+    EXPECT_FALSE(bool(error)) << llvm::toString(std::move(error));
+    return std::vector<syn::ModuleInterfaceDecl>(results.begin(),
+                                                 results.end());
+  }
+
+  static uint32_t ReadWord(const std::string &data, unsigned offset) {
+    return endian::read32le(&data[offset]);
+  }
+  static void WriteWord(std::string &data, unsigned offset, uint32_t value) {
+    endian::write32le(&data[offset], value);
+  }
+};
+
+TEST_F(ModuleInterfaceTest, RoundTrip) {
+  auto reader = Read(WriteMath());
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+  EXPECT_EQ("math", (*reader)->GetModuleName());
+  EXPECT_EQ(4u, (*reader)->GetNumDecls());
+
+  std::vector<syn::ModuleInterfaceDecl> point = Lookup(**reader, "Point");
+  ASSERT_EQ(1u, point.size());
+  EXPECT_EQ(syn::DeclKind::Struct, point[0].kind);
+  EXPECT_EQ("Point", point[0].name);
+  EXPECT_EQ("", point[0].payload);
+
+  std::vector<syn::ModuleInterfaceDecl> sub = Lookup(**reader, "Sub");
+  ASSERT_EQ(1u, sub.size());
+  EXPECT_EQ(syn::DeclKind::Fun, sub[0].kind);
+  EXPECT_EQ("int,int", sub[0].payload);
+
+  EXPECT_TRUE(Lookup(**reader, "Mul").empty());
+  EXPECT_TRUE(Lookup(**reader, "").empty());
+}
+
+TEST_F(ModuleInterfaceTest, OverloadsComeBackInOrder) {
+  auto reader = Read(WriteMath());
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+  std::vector<syn::ModuleInterfaceDecl> add = Lookup(**reader, "Add");
+  ASSERT_EQ(2u, add.size());
+  EXPECT_EQ("Add", add[0].name);
+  EXPECT_EQ("int,int", add[0].payload);
+  EXPECT_EQ("Add", add[1].name);
+  EXPECT_EQ("float,float", add[1].payload);
+}
+
+TEST_F(ModuleInterfaceTest, EmptyModule) {
+  syn::ModuleInterfaceWriter writer("");
+  auto reader = Read(Write(writer));
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+  EXPECT_EQ("", (*reader)->GetModuleName());
+  EXPECT_EQ(0u, (*reader)->GetNumDecls());
+  EXPECT_TRUE(Lookup(**reader, "Add").empty());
+}
+
+TEST_F(ModuleInterfaceTest, ManyDecls) {
+  syn::ModuleInterfaceWriter writer("many");
+  for (unsigned i = 0; i != 1000; ++i) {
+    writer.AddDecl(syn::DeclKind::Fun, ("f" + llvm::Twine(i)).str(),
+                   std::string(i % 7, 'p'));
+  }
+  EXPECT_EQ(1000u, writer.GetNumDecls());
+  auto reader = Read(Write(writer));
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+  for (unsigned i = 0; i != 1000; ++i) {
+    std::string name = ("f" + llvm::Twine(i)).str();
+    std::vector<syn::ModuleInterfaceDecl> decls = Lookup(**reader, name);
+    ASSERT_EQ(1u, decls.size()) << name;
+    EXPECT_EQ(name, decls[0].name);
+    EXPECT_EQ(std::string(i % 7, 'p'), decls[0].payload);
+  }
+}
+
+TEST_F(ModuleInterfaceTest, BadMagic) {
+  std::string data = WriteMath();
+  EXPECT_NE(std::string::npos,
+            GetReadError(data.substr(0, 3)).find("bad magic"));
+  data[0] = 'X';
+  EXPECT_NE(std::string::npos, GetReadError(data).find("bad magic"));
+}
+
+TEST_F(ModuleInterfaceTest, UnsupportedVersion) {
+  std::string data = WriteMath();
+  WriteWord(data, VersionOffset, syn::module_interface::Version + 1);
+  EXPECT_NE(std::string::npos,
+            GetReadError(data).find("unsupported version"));
+}
+
+TEST_F(ModuleInterfaceTest, BadOffsets) {
+  const std::string data = WriteMath();
+  uint32_t tableOffset = ReadWord(data, TableOffsetOffset);
+
+  // Records after the table.
+  std::string corrupt = data;
+  WriteWord(corrupt, RecordsOffsetOffset, tableOffset + 4);
+  EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad offsets"));
+
+  // Records over the module name.
+  corrupt = data;
+  WriteWord(corrupt, RecordsOffsetOffset, NameLengthOffset);
+  EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad offsets"));
+
+  // A table past the end, including one where the offset plus the table
+  // header wraps.
+  for (uint32_t badTableOffset :
+       {uint32_t(data.size()), UINT32_MAX - 3, tableOffset + 2}) {
+    corrupt = data;
+    WriteWord(corrupt, TableOffsetOffset, badTableOffset);
+    EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad offsets"))
+        << badTableOffset;
+  }
+
+  // The file cut short inside the table.
+  EXPECT_NE(std::string::npos,
+            GetReadError(data.substr(0, tableOffset + 4)).find("bad offsets"));
+}
+
+TEST_F(ModuleInterfaceTest, BadModuleName) {
+  std::string data = WriteMath();
+  uint32_t recordsOffset = ReadWord(data, RecordsOffsetOffset);
+  WriteWord(data, NameLengthOffset, recordsOffset);
+  EXPECT_NE(std::string::npos, GetReadError(data).find("bad module name"));
+  WriteWord(data, NameLengthOffset, UINT32_MAX);
+  EXPECT_NE(std::string::npos, GetReadError(data).find("bad module name"));
+}
+
+TEST_F(ModuleInterfaceTest, BadNameTable) {
+  const std::string data = WriteMath();
+  uint32_t tableOffset = ReadWord(data, TableOffsetOffset);
+  for (uint32_t numBuckets : {0u, 3u, 1u << 30}) {
+    std::string corrupt = data;
+    WriteWord(corrupt, tableOffset, numBuckets);
+    EXPECT_NE(std::string::npos,
+              GetReadError(corrupt).find("bad name table"))
+        << numBuckets;
+  }
+}
+
+TEST_F(ModuleInterfaceTest, BadNameTableChain) {
+  const std::string data = WriteMath();
+  uint32_t recordsOffset = ReadWord(data, RecordsOffsetOffset);
+  uint32_t tableOffset = ReadWord(data, TableOffsetOffset);
+  uint32_t numBuckets = ReadWord(data, tableOffset);
+  unsigned bucketsOffset = tableOffset + 2 * sizeof(uint32_t);
+  unsigned firstBucket = 0;
+  while (ReadWord(data, bucketsOffset + firstBucket * 4) == 0) {
+    ASSERT_LT(++firstBucket, numBuckets);
+  }
+  unsigned bucketOffset = bucketsOffset + firstBucket * 4;
+  uint32_t chainOffset = ReadWord(data, bucketOffset);
+
+  // A bucket pointing into the header, into the table, or past the end.
+  for (uint32_t badChainOffset :
+       {uint32_t(VersionOffset), recordsOffset - 1, tableOffset,
+        uint32_t(data.size()), UINT32_MAX}) {
+    std::string corrupt = data;
+    WriteWord(corrupt, bucketOffset, badChainOffset);
+    EXPECT_NE(std::string::npos,
+              GetReadError(corrupt).find("bad name table"))
+        << badChainOffset;
+  }
+
+  // A chain that claims more items than it holds.
+  std::string corrupt = data;
+  endian::write16le(&corrupt[chainOffset], UINT16_MAX);
+  EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad name table"));
+
+  // An item whose key runs into the table. The item's lengths follow the
+  // chain's count and the item's hash.
+  corrupt = data;
+  endian::write16le(&corrupt[chainOffset + 2 + 4], UINT16_MAX);
+  EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad name table"));
+
+  // Data that is not a whole number of record offsets.
+  corrupt = data;
+  unsigned dataLengthOffset = chainOffset + 2 + 4 + 2;
+  endian::write16le(&corrupt[dataLengthOffset],
+                    endian::read16le(&corrupt[dataLengthOffset]) - 1);
+  EXPECT_NE(std::string::npos, GetReadError(corrupt).find("bad name table"));
+}
+
+TEST_F(ModuleInterfaceTest, TruncatedRecord) {
+  // The first record is "Add": its kind, then the length of its name.
+  std::string data = WriteMath();
+  uint32_t recordsOffset = ReadWord(data, RecordsOffsetOffset);
+  WriteWord(data, recordsOffset + 1, UINT32_MAX);
+  auto reader = Read(data);
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+
+  // Only a lookup that reaches the record sees it.
+  EXPECT_EQ(1u, Lookup(**reader, "Sub").size());
+  llvm::SmallVector<syn::ModuleInterfaceDecl, 2> results;
+  llvm::Error error = (*reader)->Lookup("Add", results);
+  ASSERT_TRUE(bool(error));
+  EXPECT_NE(std::string::npos,
+            llvm::toString(std::move(error)).find("truncated record"));
+}
+
+TEST_F(ModuleInterfaceTest, RecordOffsetOutOfRange) {
+  // Moving the start of the records past the first one leaves the table
+  // pointing outside them.
+  std::string data = WriteMath();
+  uint32_t recordsOffset = ReadWord(data, RecordsOffsetOffset);
+  WriteWord(data, RecordsOffsetOffset, recordsOffset + 1);
+  auto reader = Read(data);
+  ASSERT_TRUE(bool(reader)) << llvm::toString(reader.takeError());
+
+  llvm::SmallVector<syn::ModuleInterfaceDecl, 2> results;
+  llvm::Error error = (*reader)->Lookup("Add", results);
+  ASSERT_TRUE(bool(error));
+  EXPECT_NE(std::string::npos, llvm::toString(std::move(error))
+                                   .find("record offset out of range"));
+}
+
+} // namespace